@@ -0,0 +1,80 @@
+/*
+ * bench.h
+ *
+ * Helpers shared by the benchmarks run by `make bench`.  Every benchmark
+ * prints one tab separated table to stdout: a header line naming the columns,
+ * then one row per measurement.  Columns are only ever added at the end, so
+ * scripts comparing releases can rely on them.
+ *
+ * Copyright 2026 Gentoo Foundation
+ * Licensed under the GPL-2
+ */
+
+#include "headers.h"
+
+#define _msg(std, fmt, args...) fprintf(std, "%s: " fmt "\n", program_invocation_short_name, ##args)
+#define err(fmt, args...) ({ _msg(stderr, fmt, ##args); exit(1); })
+#define errp(fmt, args...) ({ _msg(stderr, fmt ": %s", ##args, strerror(errno)); exit(1); })
+
+/* Unless sbutil.h already gave us these. */
+#ifndef xmalloc
+#define xmalloc(size) ({ void *ret = malloc(size); if (!ret) errp("malloc(%zu)", (size_t)(size)); ret; })
+#define xzalloc(size) ({ void *ret = xmalloc(size); memset(ret, 0, size); ret; })
+#endif
+
+static inline uint64_t bench_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Whether we're running under the sandbox, for the "mode" column. */
+static inline const char *bench_mode(void)
+{
+	const char *active = getenv("SANDBOX_ACTIVE");
+	return active && !strcmp(active, "armedandready") ? "sandbox" : "bare";
+}
+
+/* How many paths SANDBOX_WRITE has (0 outside of the sandbox). */
+static inline size_t bench_write_entries(void)
+{
+	const char *p = getenv("SANDBOX_WRITE");
+	size_t n = 0;
+
+	if (strcmp(bench_mode(), "sandbox") || !p)
+		return 0;
+	while (*p) {
+		p += strspn(p, ":");
+		if (!*p)
+			break;
+		++n;
+		p += strcspn(p, ":");
+	}
+	return n;
+}
+
+static int bench_u64_cmp(const void *a, const void *b)
+{
+	uint64_t ua = *(const uint64_t *)a, ub = *(const uint64_t *)b;
+	return ua < ub ? -1 : ua > ub;
+}
+
+/* The |pct| percentile of |n| samples (which get sorted). */
+static inline uint64_t bench_percentile(uint64_t *samples, size_t n, unsigned pct)
+{
+	if (!n)
+		return 0;
+	qsort(samples, n, sizeof(*samples), bench_u64_cmp);
+	return samples[(n - 1) * pct / 100];
+}
+
+static inline size_t bench_size_arg(const char *arg)
+{
+	char *end;
+	unsigned long long ret = strtoull(arg, &end, 0);
+
+	if (*end || !ret)
+		err("invalid number: %s", arg);
+	return ret;
+}
@@ -0,0 +1,47 @@
+# Helpers shared by the bench/*-bench.sh scripts `make bench` runs.
+#
+# Settings (from the environment):
+#  BENCH_ITERS           How many calls to time (per thread); the default
+#                        depends on the benchmark.
+#  BENCH_THREADS         The most threads to run at once (default: all cpus).
+#  BENCH_WRITE_ENTRIES   How many paths the big SANDBOX_WRITE has (1000).
+
+: "${abs_top_builddir:?run me via \`make bench\`}"
+: "${abs_top_srcdir:=${abs_top_builddir}}"
+
+bench_bin="${abs_top_builddir}/bench"
+
+# All our files go in here, and are cleaned up when we're done.
+bench_tmp=$(mktemp -d "${TMPDIR:-/tmp}/sandbox-bench.XXXXXX") || exit 1
+trap 'rm -rf "${bench_tmp}"' EXIT
+trap 'exit 1' HUP INT TERM
+
+# 1, 2, 4, ... up to BENCH_THREADS.
+bench_threads() {
+	local max=${BENCH_THREADS:-$(getconf _NPROCESSORS_ONLN 2>/dev/null || echo 1)}
+	local t=1
+	while [ ${t} -lt ${max} ] ; do
+		echo ${t}
+		t=$(( t * 2 ))
+	done
+	echo ${max}
+}
+
+# A SANDBOX_WRITE of BENCH_WRITE_ENTRIES paths that don't match, with $1 last
+# so every check has to go through all of them.
+bench_big_write() {
+	local i=0 n=${BENCH_WRITE_ENTRIES:-1000} list=
+	while [ ${i} -lt ${n} ] ; do
+		list="${list}/nonexistent/sandbox-bench/${i}:"
+		i=$(( i + 1 ))
+	done
+	echo "${list}$1"
+}
+
+# Run a command under the sandbox we just built, with $1 as SANDBOX_WRITE.
+bench_sandbox() {
+	local write=$1
+	shift
+	env SANDBOX_WRITE="${write}" SANDBOX_VERBOSE=0 \
+		"${abs_top_builddir}/src/sandbox.sh" "$@"
+}
@@ -0,0 +1,49 @@
+#!/bin/sh
+# run lots of short lived programs with & without the sandbox, with different
+# environment & SANDBOX_WRITE sizes, and split up where the sandbox's time went
+# per exec: our constructor, the exec wrappers, and inspecting the programs
+# (only the first exec of each program does that thanks to the exec cache)
+. "${0%/*}/bench.sh"
+
+cd "${bench_tmp}" || exit 1
+execs=${BENCH_ITERS:-2000}
+big_write=$(bench_big_write "${bench_tmp}")
+big_entries=$(( ${BENCH_WRITE_ENTRIES:-1000} + 1 ))
+
+# Pull a number out of the --stats JSON.
+stats_num() {
+	sed -n "s/.*\"$1\":{[^}]*\"$2\":\([0-9]*\).*/\1/p" stats.json
+}
+
+printf 'bench\tmode\tprogram\tenv_vars\twrite_added\texecs\tns_per_exec\toverhead_ns\tinit_ns\twrapper_ns\tinspect_ns\n'
+for prog in true true_static sh-chain ; do
+	case ${prog} in
+	true)        set -- /bin/true ;;
+	true_static) set -- "${abs_top_builddir}/tests/sb_true_static" ;;
+	sh-chain)    set -- /bin/sh -c 'sh -c "sh -c /bin/true"' ;;
+	esac
+
+	for vars in 0 1000 ; do
+		bare=$("${bench_bin}/exec-storm" -n ${execs} -e ${vars} "$@") || exit 1
+		printf 'exec\tbare\t%s\t%s\t0\t%s\t%s\t0\t0\t0\t0\n' \
+			"${prog}" ${vars} ${execs} ${bare}
+
+		for write in small big ; do
+			if [ ${write} = small ] ; then
+				w=${bench_tmp} entries=1
+			else
+				w=${big_write} entries=${big_entries}
+			fi
+			rm -f stats.json
+			ns=$(SANDBOX_STATS="${PWD}/stats.json" bench_sandbox "${w}" \
+				"${bench_bin}/exec-storm" -n ${execs} -e ${vars} "$@") || exit 1
+			# The rest is per exec too (execs of the same program only get
+			# inspected once, so it's spread out over all of them).
+			printf 'exec\tsandbox\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\n' \
+				"${prog}" ${vars} ${entries} ${execs} ${ns} $(( ns - bare )) \
+				$(( $(stats_num init ns) / execs )) \
+				$(( $(stats_num exec wrapper_ns) / execs )) \
+				$(( $(stats_num exec inspect_ns) / execs ))
+		done
+	done
+done
@@ -0,0 +1,69 @@
+/*
+ * exec-storm.c
+ *
+ * Run a program over & over (like configure scripts do), one at a time, and
+ * print how long it took on average (in ns).  The environment can be padded
+ * out first, as everything that execs has to copy it (and libsandbox has to
+ * go through it for its own vars).
+ *
+ * Copyright 2026 Gentoo Foundation
+ * Licensed under the GPL-2
+ */
+
+#include "bench.h"
+
+static void usage(int status)
+{
+	fprintf(status ? stderr : stdout,
+		"Usage: exec-storm [-n execs] [-e vars] <program> [args...]\n"
+		"\n"
+		"  -n  How many times to run the program (1000)\n"
+		"  -e  Add this many (64 byte) vars to the environment first\n");
+	exit(status);
+}
+
+int main(int argc, char *argv[])
+{
+	size_t i, n = 1000, vars = 0;
+	char name[32], val[48];
+	uint64_t start;
+	int o, status;
+	pid_t pid;
+
+	while ((o = getopt(argc, argv, "+e:hn:")) != -1) {
+		switch (o) {
+		case 'e': vars = strtoul(optarg, NULL, 0); break;
+		case 'h': usage(0);
+		case 'n': n = bench_size_arg(optarg); break;
+		default:  usage(1);
+		}
+	}
+	if (optind == argc)
+		usage(1);
+	argv += optind;
+
+	memset(val, 'x', sizeof(val) - 1);
+	val[sizeof(val) - 1] = '\0';
+	for (i = 0; i < vars; ++i) {
+		snprintf(name, sizeof(name), "BENCH_PAD_%06zu", i);
+		setenv(name, val, 1);
+	}
+
+	start = bench_now();
+	for (i = 0; i < n; ++i) {
+		pid = fork();
+		if (pid == 0) {
+			execv(argv[0], argv);
+			_exit(127);
+		}
+		if (pid == -1)
+			errp("fork");
+		if (waitpid(pid, &status, 0) == -1)
+			errp("waitpid");
+		if (!WIFEXITED(status) || WEXITSTATUS(status))
+			err("%s failed: %#x", argv[0], status);
+	}
+	printf("%" PRIu64 "\n", (bench_now() - start) / n);
+
+	return 0;
+}
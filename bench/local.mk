@@ -0,0 +1,58 @@
+# Benchmarks aren't run by `make check`, but they're built by it so they don't
+# rot.  Run them with `make bench`; see bench/bench.sh for the knobs.
+
+BENCH_PROGS = \
+	%D%/exec-storm \
+	%D%/paths \
+	%D%/replay \
+	%D%/trace-workload \
+	%D%/trace-workload_static \
+	%D%/wrappers
+
+BENCH_RUNNERS = \
+	%D%/exec-bench.sh \
+	%D%/paths-bench.sh \
+	%D%/replay-bench.sh \
+	%D%/trace-bench.sh \
+	%D%/wrappers-bench.sh
+
+check_PROGRAMS += $(BENCH_PROGS)
+
+EXTRA_DIST += \
+	$(BENCH_RUNNERS) \
+	%D%/bench.h \
+	%D%/bench.sh
+
+%C%_wrappers_LDFLAGS = $(AM_LDFLAGS) -pthread
+
+# The resolvers & the decision engine are built straight from libsandbox's
+# sources, with what else they need from it stubbed out.
+BENCH_LIBSANDBOX_CPPFLAGS = \
+	$(AM_CPPFLAGS) \
+	-Ilibsandbox \
+	-I$(top_srcdir)/libsandbox \
+	-I$(top_srcdir)/libsbutil \
+	-I$(top_srcdir)/libsbutil/include
+%C%_paths_CPPFLAGS = $(BENCH_LIBSANDBOX_CPPFLAGS)
+%C%_paths_SOURCES = \
+	%D%/paths.c \
+	%D%/stubs.c \
+	libsandbox/canonicalize.c \
+	libsandbox/resolve.c
+%C%_paths_LDADD = libsbutil/libsbutil.la
+%C%_replay_CPPFLAGS = $(BENCH_LIBSANDBOX_CPPFLAGS)
+%C%_replay_SOURCES = \
+	%D%/replay.c \
+	%D%/stubs.c \
+	libsandbox/canonicalize.c \
+	libsandbox/policy.c \
+	libsandbox/resolve.c
+%C%_replay_LDADD = libsbutil/libsbutil.la
+
+bench: all $(BENCH_PROGS) tests/sb_true_static
+	@for b in $(BENCH_RUNNERS) ; do \
+		abs_top_builddir='$(abs_top_builddir)' abs_top_srcdir='$(abs_top_srcdir)' \
+			$(SHELL) '$(abs_top_srcdir)'/$$b || exit 1 ; \
+	done
+
+.PHONY: bench
@@ -0,0 +1,18 @@
+#!/bin/sh
+# time the path resolvers on their own over a random tree, then check the ones
+# with a reference resolver against it over a few different trees (rerun one
+# with `paths -f -v -s <seed>` to see where they disagree)
+. "${0%/*}/bench.sh"
+
+cd "${bench_tmp}" || exit 1
+iters=${BENCH_ITERS:-100000}
+
+"${bench_bin}/paths" -n ${iters} || exit 1
+
+header=
+for seed in 1 2 3 4 5 ; do
+	rm -rf tree
+	# Disagreeing shows up in the table; anything else is a failure.
+	"${bench_bin}/paths" -f ${header} -p 10000 -s ${seed} || [ $? -eq 1 ] || exit 1
+	header=-q
+done
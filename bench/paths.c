@@ -0,0 +1,535 @@
+/*
+ * paths.c
+ *
+ * Time the path resolvers every check goes through on their own, and check
+ * that they still agree with the ones they're meant to match.  They're built
+ * straight from libsandbox/resolve.c & canonicalize.c (and libsbutil for
+ * canonicalize_filename_mode) with the tracer bits stubbed out in stubs.c.
+ * Both modes work through the same randomly generated tree: nested dirs &
+ * files, symlinks (absolute, relative, chains of them, dangling ones, loops,
+ * and ones to `.` & `..`), dirs we can't read or search, and a chain of long
+ * dirs that goes past PATH_MAX & SB_PATH_MAX.  The paths we resolve are random
+ * walks over all of that, mixed in with `.`, `..`, `//` & missing components.
+ * The same seed gives the same tree & paths.
+ *
+ * To check an optimized resolver, add it to resolvers[] with .ref set to the
+ * one it's replacing, and run `paths -f`.  A result is the return value, the
+ * resolved path when it worked, and errno: failing the same way counts as much
+ * as succeeding the same way, and if the ref leaves errno alone when it works
+ * (libsandbox's do), so must the new one.
+ *
+ * Copyright 2026 Gentoo Foundation
+ * Licensed under the GPL-2
+ */
+
+#include "bench.h"
+#include "gnulib/canonicalize.h"
+
+char *erealpath(const char *, char *);
+int canonicalize(const char *, char *);
+char *resolve_path(const char *, int);
+
+/* Longer than any path we resolve, or any they resolve to. */
+#define PATH_BUF (SB_PATH_MAX * 2)
+
+/* Set before every call, so we can tell whether it was left alone. */
+#define ERRNO_CANARY 12345
+
+/* Each fills in |out| (PATH_BUF bytes) & returns 0, or returns -1 w/errno. */
+static int res_realpath(const char *path, char *out)
+{
+	return realpath(path, out) ? 0 : -1;
+}
+
+static int res_erealpath(const char *path, char *out)
+{
+	return erealpath(path, out) ? 0 : -1;
+}
+
+static int res_canonicalize(const char *path, char *out)
+{
+	return canonicalize(path, out);
+}
+
+static int copy_out(char *ret, char *out)
+{
+	if (!ret)
+		return -1;
+	snprintf(out, PATH_BUF, "%s", ret);
+	free(ret);
+	return 0;
+}
+
+static int res_resolve_path(const char *path, char *out)
+{
+	return copy_out(resolve_path(path, 1), out);
+}
+
+static int res_resolve_path_nofollow(const char *path, char *out)
+{
+	return copy_out(resolve_path(path, 0), out);
+}
+
+static int res_can_existing(const char *path, char *out)
+{
+	return copy_out(canonicalize_filename_mode(path, CAN_EXISTING), out);
+}
+
+static int res_can_all_but_last(const char *path, char *out)
+{
+	return copy_out(canonicalize_filename_mode(path, CAN_ALL_BUT_LAST), out);
+}
+
+static const struct resolver {
+	const char *name;
+	int (*resolve)(const char *path, char *out);
+	/* The resolver this one has to agree with for -f. */
+	const char *ref;
+	/* Whether errno is left alone when it works (libc & gnulib don't). */
+	bool keeps_errno;
+} resolvers[] = {
+	{ "realpath",              res_realpath,              NULL,       false },
+	{ "erealpath",             res_erealpath,             NULL,       false },
+	{ "canonicalize",          res_canonicalize,          NULL,       true },
+	{ "resolve_path",          res_resolve_path,          NULL,       true },
+	{ "resolve_path_nofollow", res_resolve_path_nofollow, NULL,       true },
+	{ "can_existing",          res_can_existing,          "realpath", false },
+	{ "can_all_but_last",      res_can_all_but_last,      NULL,       false },
+	{ }
+};
+
+static const struct resolver *resolver_find(const char *name)
+{
+	const struct resolver *r;
+
+	for (r = resolvers; r->name; ++r)
+		if (!strcmp(r->name, name))
+			return r;
+	return NULL;
+}
+
+/* xorshift64*: all we need is something fast that's the same everywhere. */
+static uint64_t rnd_state;
+
+static size_t rnd(size_t n)
+{
+	rnd_state ^= rnd_state >> 12;
+	rnd_state ^= rnd_state << 25;
+	rnd_state ^= rnd_state >> 27;
+	return (rnd_state * 0x2545f4914f6cdd1dULL >> 32) % n;
+}
+
+/* Everything in the tree, relative to its top (which is our cwd). */
+#define TREE_DIRS   48
+#define TREE_FILES  48
+#define TREE_LINKS  96
+#define TREE_MAX    (1 + TREE_DIRS + TREE_FILES + TREE_LINKS * 2 + 64)
+
+static struct {
+	char *ents[TREE_MAX];
+	size_t nents;
+	/* The dirs are also in ents, first. */
+	char *dirs[TREE_DIRS + 1];
+	size_t ndirs;
+	/* Where the tree is, for absolute paths. */
+	char top[PATH_MAX];
+	/* Dirs we took perms away from, to put them back when we're done. */
+	char *locked[3];
+	size_t nlocked;
+} tree;
+
+static char *tree_add(const char *fmt, ...)
+{
+	va_list args;
+	char *path;
+
+	if (tree.nents == TREE_MAX)
+		err("too many entries in the tree");
+	va_start(args, fmt);
+	if (vasprintf(&path, fmt, args) == -1)
+		errp("vasprintf");
+	va_end(args);
+	tree.ents[tree.nents++] = path;
+	return path;
+}
+
+/* How many `..` it takes to get from |dir| back to the top. */
+static size_t tree_depth(const char *dir)
+{
+	size_t depth = 0, len;
+
+	while (*dir) {
+		len = strcspn(dir, "/");
+		if (len != 1 || dir[0] != '.')
+			++depth;
+		dir += len;
+		dir += *dir == '/';
+	}
+	return depth;
+}
+
+static char *tree_up(size_t depth)
+{
+	static char buf[PATH_MAX];
+	size_t i;
+
+	buf[0] = '\0';
+	for (i = 0; i < depth; ++i)
+		strcat(buf, "../");
+	return buf;
+}
+
+static void tree_link(const char *target, const char *link)
+{
+	if (symlink(target, link))
+		errp("symlink(%s, %s)", target, link);
+}
+
+/* A chain of dirs with long names, adding a few spots along it (around PATH_MAX
+ * & SB_PATH_MAX) to the tree.  The full paths are too long for the kernel, so
+ * go down it a dir at a time.
+ */
+static void tree_long(void)
+{
+	char name[201], *path = NULL;
+	size_t len = 0, next_mark = PATH_MAX - 512;
+	int fd, dirfd;
+
+	memset(name, 'l', sizeof(name) - 1);
+	name[sizeof(name) - 1] = '\0';
+
+	if (mkdir("long", 0755))
+		errp("mkdir(long)");
+	dirfd = open("long", O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+	if (dirfd == -1)
+		errp("open(long)");
+	path = strdup("long");
+	len = strlen(path);
+
+	while (len < SB_PATH_MAX + 512) {
+		if (mkdirat(dirfd, name, 0755))
+			errp("mkdirat(%s)", name);
+		fd = openat(dirfd, name, O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+		if (fd == -1)
+			errp("openat(%s)", name);
+		close(dirfd);
+		dirfd = fd;
+
+		path = realloc(path, len + 1 + sizeof(name));
+		if (!path)
+			errp("realloc");
+		len += sprintf(path + len, "/%s", name);
+
+		if (len >= next_mark) {
+			/* A link back up to the top of the chain too, so
+			 * resolving through it can shrink the path again.
+			 */
+			if (symlinkat(tree_up(tree_depth(path) - 1), dirfd, "up"))
+				errp("symlinkat(up)");
+			tree_add("%s", path);
+			tree_add("%s/up", path);
+			next_mark += PATH_MAX / 2;
+		}
+	}
+	close(dirfd);
+	free(path);
+}
+
+static int tree_deeper(const void *a, const void *b)
+{
+	size_t da = tree_depth(*(char * const *)a), db = tree_depth(*(char * const *)b);
+	return da > db ? -1 : da < db;
+}
+
+static void tree_build(const char *top)
+{
+	size_t i;
+
+	if (mkdir(top, 0755))
+		errp("mkdir(%s)", top);
+	if (chdir(top))
+		errp("chdir(%s)", top);
+	if (!getcwd(tree.top, sizeof(tree.top)))
+		errp("getcwd");
+
+	tree.dirs[tree.ndirs++] = tree_add(".");
+	for (i = 0; i < TREE_DIRS; ++i) {
+		const char *parent = tree.dirs[rnd(tree.ndirs)];
+		char *dir = tree_add("%s/d%zu", parent, i);
+
+		if (mkdir(dir, 0755))
+			errp("mkdir(%s)", dir);
+		tree.dirs[tree.ndirs++] = dir;
+	}
+
+	for (i = 0; i < TREE_FILES; ++i) {
+		char *file = tree_add("%s/f%zu", tree.dirs[rnd(tree.ndirs)], i);
+		int fd = open(file, O_WRONLY|O_CREAT|O_CLOEXEC, 0644);
+
+		if (fd == -1)
+			errp("open(%s)", file);
+		close(fd);
+	}
+
+	for (i = 0; i < TREE_LINKS; ++i) {
+		const char *dir = tree.dirs[rnd(tree.ndirs)];
+		/* Anything made so far, including other links (chains). */
+		const char *ent = tree.ents[rnd(tree.nents)];
+		char *link = tree_add("%s/l%zu", dir, i);
+		char target[PATH_MAX * 3];
+
+		switch (rnd(8)) {
+		case 0:
+			snprintf(target, sizeof(target), "%s/%s", tree.top, ent);
+			break;
+		case 1:
+		case 2:
+			snprintf(target, sizeof(target), "%s%s", tree_up(tree_depth(dir)), ent);
+			break;
+		case 3:
+			snprintf(target, sizeof(target), "missing/l%zu", i);
+			break;
+		case 4:
+			/* A loop with a buddy next to it. */
+			snprintf(target, sizeof(target), "l%zu.loop", i);
+			tree_link(strrchr(link, '/') + 1, tree_add("%s.loop", link));
+			break;
+		case 5:
+			snprintf(target, sizeof(target), "%s", rnd(2) ? "." : "..");
+			break;
+		case 6:
+			snprintf(target, sizeof(target), "%s", tree_up(rnd(4) + 1));
+			break;
+		case 7:
+			snprintf(target, sizeof(target), "%s/missing", tree.top);
+			break;
+		}
+		tree_link(target, link);
+	}
+
+	tree_long();
+
+	/* Not readable, not searchable, and neither.  This doesn't do a thing
+	 * when we're root, of course.  Lock the deepest first, as we might not
+	 * be able to get to them afterwards.
+	 */
+	for (i = 0; i < ARRAY_SIZE(tree.locked); ++i)
+		tree.locked[i] = tree.dirs[1 + rnd(tree.ndirs - 1)];
+	qsort(tree.locked, ARRAY_SIZE(tree.locked), sizeof(*tree.locked), tree_deeper);
+	for (i = 0; i < ARRAY_SIZE(tree.locked); ++i) {
+		static const mode_t modes[] = { 0311, 0644, 0 };
+
+		if (chmod(tree.locked[i], modes[i]))
+			errp("chmod(%s)", tree.locked[i]);
+		tree.nlocked = i + 1;
+	}
+}
+
+/* Put the perms back so the tree can be cleaned up. */
+static void tree_unlock(void)
+{
+	size_t i;
+
+	for (i = tree.nlocked; i-- > 0; )
+		chmod(tree.locked[i], 0755);
+	tree.nlocked = 0;
+}
+
+/* A random path through the tree, sometimes absolute, and sometimes not. */
+static void gen_path(char *buf, size_t size)
+{
+	size_t n, len = 0;
+	const char *comp;
+
+	buf[0] = '\0';
+	if (!rnd(64))
+		return;
+
+	if (rnd(2))
+		len = snprintf(buf, size, "%s/", tree.top);
+
+	for (n = rnd(4) + 1; n > 0; --n) {
+		switch (rnd(10)) {
+		default: comp = tree.ents[rnd(tree.nents)]; break;
+		case 6:  comp = "."; break;
+		case 7:  comp = ".."; break;
+		case 8:  comp = ""; break;
+		case 9:  comp = "missing"; break;
+		}
+		if (len + strlen(comp) + 2 >= size)
+			break;
+		len += sprintf(buf + len, "%s%s", comp, n > 1 ? "/" : "");
+	}
+	if (!rnd(8) && len + 2 < size)
+		strcat(buf, "/");
+}
+
+static char **gen_paths(size_t npaths)
+{
+	char **paths = xmalloc(sizeof(*paths) * npaths), buf[PATH_BUF];
+	size_t i;
+
+	for (i = 0; i < npaths; ++i) {
+		gen_path(buf, SB_PATH_MAX + PATH_MAX);
+		paths[i] = strdup(buf);
+		if (!paths[i])
+			errp("strdup");
+	}
+	return paths;
+}
+
+static void bench(const struct resolver *r, char **paths, size_t npaths, size_t iters, uint64_t seed)
+{
+	uint64_t *ns = xmalloc(sizeof(*ns) * iters), start, wall, total = 0;
+	char out[PATH_BUF];
+	size_t i;
+
+	wall = bench_now();
+	for (i = 0; i < iters; ++i) {
+		start = bench_now();
+		r->resolve(paths[i % npaths], out);
+		ns[i] = bench_now() - start;
+		total += ns[i];
+	}
+	wall = bench_now() - wall;
+
+	printf("paths\t%s\t%" PRIu64 "\t%zu\t%zu\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%.0f\n",
+		r->name, seed, npaths, iters, total / iters,
+		bench_percentile(ns, iters, 50), bench_percentile(ns, iters, 99),
+		iters * 1e9 / wall);
+
+	free(ns);
+}
+
+struct result {
+	int ret, err;
+	char path[PATH_BUF];
+};
+
+static void result_get(const struct resolver *r, const char *path, struct result *res)
+{
+	res->path[0] = '\0';
+	errno = ERRNO_CANARY;
+	res->ret = r->resolve(path, res->path);
+	res->err = errno;
+	if (res->ret)
+		res->path[0] = '\0';
+}
+
+static bool result_same(const struct result *got, const struct result *want, bool keeps_errno)
+{
+	if (got->ret != want->ret || strcmp(got->path, want->path))
+		return false;
+	if (!want->ret && !keeps_errno)
+		return true;
+	return got->err == want->err;
+}
+
+static const char *result_errno(const struct result *res)
+{
+	return res->err == ERRNO_CANARY ? "unchanged" : strerror(res->err);
+}
+
+/* Returns how many paths |r| & its ref disagreed on. */
+static size_t fuzz(const struct resolver *r, char **paths, size_t npaths, uint64_t seed, bool verbose)
+{
+	static struct result got, want;
+	const struct resolver *ref = resolver_find(r->ref);
+	size_t i, bad = 0;
+
+	if (!ref)
+		err("%s: unknown ref: %s", r->name, r->ref);
+
+	for (i = 0; i < npaths; ++i) {
+		result_get(r, paths[i], &got);
+		result_get(ref, paths[i], &want);
+		if (result_same(&got, &want, ref->keeps_errno))
+			continue;
+
+		/* The first few should be enough to go on. */
+		if (verbose && bad < 10)
+			_msg(stderr, "%s != %s: \"%s\":\n"
+				"  got  %i \"%s\" (%s)\n"
+				"  want %i \"%s\" (%s)",
+				r->name, ref->name, paths[i],
+				got.ret, got.path, result_errno(&got),
+				want.ret, want.path, result_errno(&want));
+		++bad;
+	}
+
+	printf("paths-fuzz\t%s\t%s\t%" PRIu64 "\t%zu\t%zu\n",
+		r->name, ref->name, seed, npaths, bad);
+	return bad;
+}
+
+static void usage(int status)
+{
+	const struct resolver *r;
+
+	fprintf(status ? stderr : stdout,
+		"Usage: paths [-f [-v]] [-q] [-n iters] [-p paths] [-s seed] [resolver...]\n"
+		"\n"
+		"Builds its tree in ./tree, so run it somewhere empty.\n"
+		"With -f, check the resolvers against their ref rather than time them\n"
+		"(and exit 1 if they disagree); -v shows the first paths they disagree on.\n"
+		"\n"
+		"Resolvers (all by default):");
+	for (r = resolvers; r->name; ++r)
+		fprintf(status ? stderr : stdout, " %s", r->name);
+	fprintf(status ? stderr : stdout, "\n");
+	exit(status);
+}
+
+int main(int argc, char *argv[])
+{
+	const struct resolver *r, *only[ARRAY_SIZE(resolvers)];
+	size_t i, nonly = 0, iters = 100000, npaths = 1000, bad = 0;
+	uint64_t seed = 1;
+	bool header = true, check = false, verbose = false;
+	char **paths;
+	int o;
+
+	while ((o = getopt(argc, argv, "fhn:p:qs:v")) != -1) {
+		switch (o) {
+		case 'f': check = true; break;
+		case 'h': usage(0);
+		case 'n': iters = bench_size_arg(optarg); break;
+		case 'p': npaths = bench_size_arg(optarg); break;
+		case 'q': header = false; break;
+		case 's': seed = bench_size_arg(optarg); break;
+		case 'v': verbose = true; break;
+		default:  usage(1);
+		}
+	}
+	for (; optind < argc; ++optind) {
+		r = resolver_find(argv[optind]);
+		if (!r)
+			err("unknown resolver: %s", argv[optind]);
+		only[nonly++] = r;
+	}
+	if (!nonly)
+		for (r = resolvers; r->name; ++r)
+			only[nonly++] = r;
+
+	rnd_state = seed;
+	tree_build("tree");
+	paths = gen_paths(npaths);
+
+	if (header) {
+		if (check)
+			printf("bench\tresolver\tref\tseed\tpaths\tmismatches\n");
+		else
+			printf("bench\tresolver\tseed\tpaths\tcalls\tns_avg\tns_p50\tns_p99\tcalls_per_sec\n");
+	}
+
+	for (i = 0; i < nonly; ++i) {
+		r = only[i];
+		if (!check)
+			bench(r, paths, npaths, iters, seed);
+		else if (r->ref)
+			bad += fuzz(r, paths, npaths, seed, verbose);
+	}
+
+	tree_unlock();
+	return bad ? 1 : 0;
+}
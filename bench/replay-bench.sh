@@ -0,0 +1,36 @@
+#!/bin/sh
+# capture the accesses of a small build-like workload with SANDBOX_TRACE, then
+# replay them through the decision engine: as recorded, resolving the paths
+# again, and against a SANDBOX_WRITE as long as a real build's
+. "${0%/*}/bench.sh"
+
+cd "${bench_tmp}" || exit 1
+iters=${BENCH_ITERS:-100000}
+log="${bench_tmp}/trace.log"
+
+# Read some headers, write, rename & remove objects, probe for writability,
+# and poke at a predicted path, a bit like a configure & compile would.
+workload='
+	mkdir -p obj
+	for h in /usr/include/*.h ; do
+		cat "${h}" > obj/h.o
+		mv obj/h.o obj/h.a
+		test -w /usr/include
+		{ true > /usr/sandbox-replay-predict ; } 2>/dev/null
+	done
+	rm -rf obj
+'
+export SANDBOX_PREDICT="/usr/sandbox-replay-predict"
+SANDBOX_TRACE=1 SANDBOX_DEBUG_LOG="${log}" \
+	bench_sandbox "${bench_tmp}" sh -c "${workload}" || exit 1
+
+# The engine has to see the policy the workload ran under, so replay under the
+# sandbox too; diffs are reported, not fatal (and the big list is a superset).
+replay() {
+	local write=$1
+	shift
+	bench_sandbox "${write}" "${bench_bin}/replay" -n ${iters} "$@" "${log}" || [ $? -eq 1 ] || exit 1
+}
+replay "${bench_tmp}"
+replay "${bench_tmp}" -q -r
+replay "$(bench_big_write):${bench_tmp}" -q
@@ -0,0 +1,255 @@
+/*
+ * replay.c
+ *
+ * Run the accesses recorded in debug logs back through the decision engine
+ * (libsandbox/policy.c, built straight from its sources), timing every
+ * decision, and check that it still comes to the verdicts it came to when they
+ * were recorded.  Any SANDBOX_DEBUG_LOG will do, but for a whole build it's
+ * far cheaper to capture with SANDBOX_TRACE, which ends up in the same log.
+ *
+ * As in libsandbox, the policy is whatever SANDBOX_{DENY,READ,WRITE,PREDICT}
+ * say in our env, so run us under the sandbox with the settings the log was
+ * recorded with (or export that build's SANDBOX_* vars by hand).
+ *
+ * By default the recorded paths are checked as is, which is exact: they're all
+ * the engine looks at once the flags of the call (which the log lacks) have
+ * picked which path to check.  With -r, they're resolved again from the
+ * recorded absolute path, like the checks do, so the resolvers get timed too,
+ * but that only agrees with the log as long as the fs still looks the same.
+ *
+ * Copyright 2026 Gentoo Foundation
+ * Licensed under the GPL-2
+ */
+
+#include "headers.h"
+#include "sbutil.h"
+#include "libsandbox.h"
+#include "sb_nr.h"
+#include "bench.h"
+
+struct record {
+	int sb_nr;
+	const char *func, *apath, *rpath;
+	bool access;
+};
+
+static struct record *records;
+static size_t nrecords, skipped;
+
+/* The funcs the wrappers log as that aren't in symbols.h.in. */
+static const struct {
+	const char *func;
+	int sb_nr;
+} pseudo_funcs[] = {
+	{ "access_rd", SB_NR_ACCESS_RD },
+	{ "access_wr", SB_NR_ACCESS_WR },
+	{ "open_rd",   SB_NR_OPEN_RD },
+	{ "open_wr",   SB_NR_OPEN_WR },
+	{ "fopen_rd",  SB_NR_OPEN_RD },
+	{ "fopen_wr",  SB_NR_OPEN_WR },
+};
+
+/* Funcs the C library lacks only differ in their sb_nr, not in their attrs,
+ * so their index in sb_nr_attrs[] is as good.
+ */
+static int func_nr(const char *func)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(pseudo_funcs); ++i)
+		if (!strcmp(pseudo_funcs[i].func, func))
+			return pseudo_funcs[i].sb_nr;
+	for (i = 1; i <= SB_NR_MAX; ++i)
+		if (sb_nr_attrs[i].name && !strcmp(sb_nr_attrs[i].name, func))
+			return i;
+	return 0;
+}
+
+static void load_log(const char *file)
+{
+	static size_t alloced;
+	struct sb_log_entry e;
+	struct record *rec;
+	char *line = NULL;
+	size_t len = 0;
+	FILE *fp;
+	int sb_nr;
+
+	fp = fopen(file, "re");
+	if (!fp)
+		errp("fopen(%s)", file);
+
+	while (getline(&line, &len, fp) != -1) {
+		/* The records point into the line, so keep it. */
+		char *copy = xstrdup(line);
+
+		if (!sb_log_parse_record(copy, &e) || !e.func || !e.status ||
+		    !e.apath || !e.apath[0] || !e.rpath || !e.rpath[0] ||
+		    !(sb_nr = func_nr(e.func))) {
+			free(copy);
+			++skipped;
+			continue;
+		}
+
+		if (nrecords == alloced) {
+			alloced = alloced ? alloced * 2 : 4096;
+			records = xrealloc(records, sizeof(*records) * alloced);
+		}
+		rec = &records[nrecords++];
+		rec->sb_nr = sb_nr;
+		rec->func = e.func;
+		rec->apath = e.apath;
+		rec->rpath = e.rpath;
+		rec->access = !strcmp(e.status, "allow");
+	}
+
+	free(line);
+	fclose(fp);
+}
+
+static void load_policy(sbcontext_t *ctx)
+{
+	static const char * const names[MAX_DYN_PREFIXES] = {
+		ENV_SANDBOX_DENY,
+		ENV_SANDBOX_READ,
+		ENV_SANDBOX_WRITE,
+		ENV_SANDBOX_PREDICT,
+	};
+	const char *val;
+	size_t i;
+
+	memset(ctx, 0, sizeof(*ctx));
+	for (i = 0; i < ARRAY_SIZE(names); ++i) {
+		val = getenv(names[i]);
+		if (val)
+			init_env_entries(&ctx->prefixes[i], &ctx->num_prefixes[i], names[i], val, 0);
+	}
+}
+
+static size_t policy_entries(const sbcontext_t *ctx)
+{
+	size_t i, n = 0;
+
+	for (i = 0; i < MAX_DYN_PREFIXES; ++i)
+		n += ctx->num_prefixes[i];
+	return n;
+}
+
+/* Whether the access would be let through (same as the log's "allow"). */
+static bool decide(sbcontext_t *ctx, const struct record *rec, bool resolve)
+{
+	char *apath = NULL, *rpath = NULL;
+	int flags, result;
+
+	/* The log doesn't have the flags of the call.  The only one the engine
+	 * cares about is AT_SYMLINK_NOFOLLOW, and only when the paths differ,
+	 * which they never do for the calls that have it set.
+	 */
+	flags = strcmp(rec->apath, rec->rpath) ? 0 : AT_SYMLINK_NOFOLLOW;
+
+	if (resolve) {
+		apath = resolve_path(rec->apath, 0);
+		if (symlink_func(sb_nr_attrs_get(rec->sb_nr), flags))
+			rpath = apath ? xstrdup(apath) : NULL;
+		else
+			rpath = resolve_path(rec->apath, 1);
+	}
+
+	/* When the fs has moved on too far to resolve them, use the log's. */
+	ctx->show_access_violation = true;
+	result = check_access(ctx, rec->sb_nr, rec->func, flags,
+		apath && rpath ? apath : rec->apath,
+		apath && rpath ? rpath : rec->rpath);
+
+	free(apath);
+	free(rpath);
+
+	return result || !ctx->show_access_violation;
+}
+
+static size_t replay(sbcontext_t *ctx, bool resolve, size_t passes, bool verbose, uint64_t *ns)
+{
+	const struct record *rec;
+	size_t pass, i, n = 0, diffs = 0;
+	uint64_t start;
+	bool access;
+
+	for (pass = 0; pass < passes; ++pass) {
+		for (i = 0; i < nrecords; ++i) {
+			rec = &records[i];
+			start = bench_now();
+			access = decide(ctx, rec, resolve);
+			ns[n++] = bench_now() - start;
+
+			if (pass || access == rec->access)
+				continue;
+			if (verbose && diffs < 10)
+				_msg(stderr, "%s(%s) [%s]: recorded %s, replayed %s",
+					rec->func, rec->apath, rec->rpath,
+					rec->access ? "allow" : "deny", access ? "allow" : "deny");
+			++diffs;
+		}
+	}
+
+	return diffs;
+}
+
+static void usage(int status)
+{
+	fprintf(status ? stderr : stdout,
+		"Usage: replay [-qrv] [-n decisions] <debug log...>\n"
+		"\n"
+		"Replay the recorded accesses against the SANDBOX_* policy in the env, at\n"
+		"least |decisions| times all told (100000 by default), and report any\n"
+		"verdicts that differ from the recorded ones (-v shows the first 10).\n"
+		"With -r, resolve the paths again rather than using the recorded ones.\n");
+	exit(status);
+}
+
+int main(int argc, char *argv[])
+{
+	sbcontext_t ctx;
+	size_t iters = 100000, passes, n, j, diffs;
+	bool header = true, resolve = false, verbose = false;
+	uint64_t *ns, start, wall, total = 0;
+	int i, o;
+
+	while ((o = getopt(argc, argv, "hn:qrv")) != -1) {
+		switch (o) {
+		case 'h': usage(0);
+		case 'n': iters = bench_size_arg(optarg); break;
+		case 'q': header = false; break;
+		case 'r': resolve = true; break;
+		case 'v': verbose = true; break;
+		default:  usage(1);
+		}
+	}
+	if (optind == argc)
+		usage(1);
+
+	for (i = optind; i < argc; ++i)
+		load_log(argv[i]);
+	if (!nrecords)
+		err("no accesses to replay");
+	load_policy(&ctx);
+
+	passes = (iters + nrecords - 1) / nrecords;
+	ns = xmalloc(sizeof(*ns) * nrecords * passes);
+
+	start = bench_now();
+	diffs = replay(&ctx, resolve, passes, verbose, ns);
+	wall = bench_now() - start;
+
+	n = nrecords * passes;
+	for (j = 0; j < n; ++j)
+		total += ns[j];
+
+	if (header)
+		printf("bench\tmode\trecords\tskipped\tpolicy_entries\tdecisions\tns_avg\tns_p50\tns_p99\tdecisions_per_sec\tdiffs\n");
+	printf("replay\t%s\t%zu\t%zu\t%zu\t%zu\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%.0f\t%zu\n",
+		resolve ? "resolve" : "recorded", nrecords, skipped, policy_entries(&ctx), n,
+		total / n, bench_percentile(ns, n, 50), bench_percentile(ns, n, 99),
+		n * 1e9 / wall, diffs);
+
+	return diffs ? 1 : 0;
+}
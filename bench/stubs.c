@@ -0,0 +1,42 @@
+/*
+ * stubs.c
+ *
+ * The bits of libsandbox its path resolvers & decision engine need, for the
+ * benchmarks that build those straight from libsandbox's sources.  They never
+ * trace anything, and they have to see the fs as it is, so go around any
+ * libsandbox we might be running under.
+ *
+ * Copyright 2026 Gentoo Foundation
+ * Licensed under the GPL-2
+ */
+
+#include "headers.h"
+#include "sbutil.h"
+#include "libsandbox.h"
+#include "wrappers.h"
+
+pid_t trace_pid;
+bool sandbox_on = true;
+char sb_exec_cache_path[SB_PATH_MAX];
+
+ssize_t trace_readlink_cwd(char *buf, size_t bufsiz)
+{
+	abort();
+}
+
+char *sb_unwrapped_getcwd(char *buf, size_t size)
+{
+	return syscall(SYS_getcwd, buf, size) == -1 ? NULL : buf;
+}
+
+int sb_unwrapped_access(const char *path, int mode)
+{
+	return syscall(SYS_faccessat, AT_FDCWD, path, mode, 0);
+}
+
+/* And what libsbutil needs in turn. */
+int (*sbio_open)(const char *, int, mode_t) = (void *)open;
+FILE *(*sbio_popen)(const char *, const char *) = popen;
+bool (*sbio_collect)(const struct iovec *, int);
+const char sbio_fallback_path[] = "/dev/stderr";
+const char *sbio_message_path = sbio_fallback_path;
@@ -0,0 +1,50 @@
+#!/bin/sh
+# time static workloads natively & under the tracer (SANDBOX_METHOD=any), and
+# count how often the tracers had to stop & how many of them it took
+. "${0%/*}/bench.sh"
+
+if ! grep -q trace_loop "${abs_top_builddir}"/libsandbox/.libs/libsandbox.so ; then
+	echo "trace-bench: no trace support; skipping" >&2
+	exit 0
+fi
+
+cd "${bench_tmp}" || exit 1
+static="${bench_bin}/trace-workload_static"
+dynamic="${bench_bin}/trace-workload"
+iters=${BENCH_ITERS:-100000}
+
+# The slower workloads run 1/$1 as often, but the workload needs at least 1.
+iters_div() {
+	echo $(( iters / $1 > 0 ? iters / $1 : 1 ))
+}
+
+# Pull a number out of the --stats JSON.
+stats_num() {
+	sed -n "s/.*\"$1\":\([0-9]*\).*/\1/p" stats.json
+}
+
+printf 'bench\tmode\tworkload\tn\twall_ns\tprocesses\ttracers\ttrace_stops\tstops_per_sec\n'
+for w in \
+	"syscalls ${iters}" \
+	"files $(iters_div 20)" \
+	"forks 6" \
+	"exec $(iters_div 2000) ${static} ${static}" \
+	"exec $(iters_div 2000) ${static} ${dynamic}" \
+; do
+	set -- ${w}
+	name=$1
+	[ $# -gt 2 ] && [ "$4" != "$3" ] && name="${name}-mixed"
+
+	out=$("${static}" "$@") || exit 1
+	printf 'trace\tbare\t%s\t%s\t%s\t0\t0\t0\n' "${name}" "$2" "${out}"
+
+	# The sandbox runs the command itself, so have a shell with libsandbox
+	# in it exec the static program for us.
+	rm -f stats.json
+	out=$(SANDBOX_METHOD=any SANDBOX_STATS="${PWD}/stats.json" \
+		bench_sandbox "${bench_tmp}" sh -c 'exec "$@"' sh "${static}" "$@") || exit 1
+	wall=${out%%	*}
+	stops=$(stats_num trace_stops)
+	printf 'trace\tsandbox\t%s\t%s\t%s\t%s\t%s\t%s\n' "${name}" "$2" "${out}" \
+		"$(stats_num tracers)" "${stops}" "$(( stops * 1000000000 / wall ))"
+done
@@ -0,0 +1,141 @@
+/*
+ * trace-workload.c
+ *
+ * Workloads that keep the tracer busy when built static (see trace-bench.sh).
+ * The workload runs in a child, and once it's done, we print how long it took
+ * (in ns) & how many processes it used (counting us).
+ *
+ * Copyright 2026 Gentoo Foundation
+ * Licensed under the GPL-2
+ */
+
+#include "bench.h"
+
+static void wait_child(pid_t pid)
+{
+	int status;
+
+	if (pid == -1)
+		errp("fork");
+	if (waitpid(pid, &status, 0) == -1)
+		errp("waitpid");
+	if (!WIFEXITED(status) || WEXITSTATUS(status))
+		err("child %i failed: %#x", pid, status);
+}
+
+/* Cheap syscalls that don't touch any paths. */
+static void do_syscalls(size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; ++i)
+		syscall(SYS_getppid);
+}
+
+static void do_files(size_t n)
+{
+	char path[32];
+	size_t i;
+	int fd;
+
+	for (i = 0; i < n; ++i) {
+		snprintf(path, sizeof(path), "file%zu", i);
+		fd = open(path, O_WRONLY|O_CREAT|O_EXCL|O_CLOEXEC, 0644);
+		if (fd == -1)
+			errp("open(%s)", path);
+		close(fd);
+		if (unlink(path))
+			errp("unlink(%s)", path);
+	}
+}
+
+/* Every process forks a child at every level. */
+static void do_forks(size_t depth)
+{
+	pid_t pid;
+
+	if (!depth)
+		return;
+	pid = fork();
+	if (pid == 0) {
+		do_forks(depth - 1);
+		_exit(0);
+	}
+	do_forks(depth - 1);
+	wait_child(pid);
+}
+
+/* Exec |next| with |n| - 1 execs left, and swap the programs around. */
+static void do_exec(size_t n, const char *prog, const char *next)
+{
+	char left[32];
+
+	if (!n)
+		return;
+	snprintf(left, sizeof(left), "%zu", n - 1);
+	execl(next, next, "exec-step", left, next, prog, NULL);
+	errp("execl(%s)", next);
+}
+
+static void usage(int status)
+{
+	fprintf(status ? stderr : stdout,
+		"Usage: trace-workload <workload> <n> [args]\n"
+		"\n"
+		"Workloads:\n"
+		"  syscalls <n>      n getppid() calls\n"
+		"  files <n>         create & unlink n files in the current dir\n"
+		"  forks <n>         a tree of forks n levels deep (2^n processes)\n"
+		"  exec <n> <a> <b>  a chain of n execs, switching between programs a & b\n");
+	exit(status);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *workload;
+	uint64_t start;
+	size_t n, procs = 2;
+	pid_t pid;
+
+	if (argc < 3)
+		usage(argc == 2 && !strcmp(argv[1], "-h") ? 0 : 1);
+	workload = argv[1];
+
+	/* Only ever used by the exec chain. */
+	if (!strcmp(workload, "exec-step")) {
+		if (argc != 5)
+			usage(1);
+		do_exec(strtoul(argv[2], NULL, 0), argv[3], argv[4]);
+		return 0;
+	}
+
+	n = bench_size_arg(argv[2]);
+	if (!strcmp(workload, "exec")) {
+		if (argc != 5)
+			usage(1);
+	} else if (argc != 3)
+		usage(1);
+	if (!strcmp(workload, "forks"))
+		procs = 1 + ((size_t)1 << n);
+	else if (strcmp(workload, "syscalls") && strcmp(workload, "files") &&
+	         strcmp(workload, "exec"))
+		usage(1);
+
+	start = bench_now();
+	pid = fork();
+	if (pid == 0) {
+		if (!strcmp(workload, "syscalls"))
+			do_syscalls(n);
+		else if (!strcmp(workload, "files"))
+			do_files(n);
+		else if (!strcmp(workload, "forks"))
+			do_forks(n);
+		else
+			do_exec(n, argv[3], argv[4]);
+		_exit(0);
+	}
+	wait_child(pid);
+	printf("%" PRIu64 "\t%zu\n", bench_now() - start, procs);
+
+	return 0;
+}
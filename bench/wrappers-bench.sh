@@ -0,0 +1,15 @@
+#!/bin/sh
+# time the wrapped funcs with & without the sandbox at 1..N threads, with a
+# small & a big SANDBOX_WRITE
+. "${0%/*}/bench.sh"
+
+cd "${bench_tmp}" || exit 1
+set -- -n "${BENCH_ITERS:-10000}" ${BENCH_TRUE:+-x "${BENCH_TRUE}"}
+
+q=
+for t in $(bench_threads) ; do
+	"${bench_bin}/wrappers" ${q} -t ${t} "$@" || exit 1
+	q=-q
+	bench_sandbox "${bench_tmp}" "${bench_bin}/wrappers" -q -t ${t} "$@" || exit 1
+	bench_sandbox "$(bench_big_write "${bench_tmp}")" "${bench_bin}/wrappers" -q -t ${t} "$@" || exit 1
+done
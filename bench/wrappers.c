@@ -0,0 +1,313 @@
+/*
+ * wrappers.c
+ *
+ * Time the wrapped funcs, one family at a time, from 1 or more threads at once
+ * (they all share sb_lock() in libsandbox).  Each thread works in a dir of its
+ * own under the current dir, and every call is timed on its own so things we
+ * have to set up between calls (e.g. a file to unlink) don't count.  The
+ * ops_per_sec column goes by the wall time, so that setup does count there.
+ *
+ * Copyright 2026 Gentoo Foundation
+ * Licensed under the GPL-2
+ */
+
+#include "bench.h"
+
+#include <pthread.h>
+
+struct thread {
+	pthread_t tid;
+	const struct family *family;
+	char dir[64], file[80], file2[80];
+	int dirfd, fd;
+	size_t iters;
+	uint64_t *ns;
+	/* When the thread started & finished its run */
+	uint64_t start, end;
+};
+
+struct family {
+	const char *name;
+	/* Called before each |op|, and not timed. */
+	void (*prep)(struct thread *, size_t);
+	void (*op)(struct thread *, size_t);
+	/* Execs are much slower, so only run them 1/|div| as often. */
+	size_t div;
+};
+
+static const char *true_path = "/bin/true";
+static pthread_barrier_t barrier;
+
+#define check(expr) do { if ((expr) == -1) errp("%s", #expr); } while (0)
+
+static void op_open_rd(struct thread *t, size_t i)
+{
+	int fd = open(t->file, O_RDONLY|O_CLOEXEC);
+	check(fd);
+	close(fd);
+}
+
+static void op_open_wr(struct thread *t, size_t i)
+{
+	int fd = open(t->file, O_WRONLY|O_CREAT|O_CLOEXEC, 0644);
+	check(fd);
+	close(fd);
+}
+
+static void op_openat(struct thread *t, size_t i)
+{
+	int fd = openat(t->dirfd, "file", O_WRONLY|O_CREAT|O_CLOEXEC, 0644);
+	check(fd);
+	close(fd);
+}
+
+static void op_access(struct thread *t, size_t i)
+{
+	check(access(t->file, W_OK));
+}
+
+static void op_mkdir(struct thread *t, size_t i)
+{
+	check(mkdir(t->file2, 0755));
+	check(rmdir(t->file2));
+}
+
+/* Make the file to unlink behind libsandbox's back. */
+static void prep_unlink(struct thread *t, size_t i)
+{
+	int fd = syscall(SYS_openat, AT_FDCWD, t->file2, O_WRONLY|O_CREAT|O_CLOEXEC, 0644);
+	check(fd);
+	close(fd);
+}
+
+static void op_unlink(struct thread *t, size_t i)
+{
+	check(unlink(t->file2));
+}
+
+/* Move the file back & forth. */
+static void op_rename(struct thread *t, size_t i)
+{
+	if (i & 1)
+		check(rename(t->file2, t->file));
+	else
+		check(rename(t->file, t->file2));
+}
+
+static void op_chmod(struct thread *t, size_t i)
+{
+	check(chmod(t->file, i & 1 ? 0644 : 0600));
+}
+
+static void op_fchmod(struct thread *t, size_t i)
+{
+	check(fchmod(t->fd, i & 1 ? 0644 : 0600));
+}
+
+static void op_utimensat(struct thread *t, size_t i)
+{
+	check(utimensat(t->dirfd, "file", NULL, 0));
+}
+
+static void wait_child(pid_t pid)
+{
+	int status;
+
+	check(pid);
+	if (waitpid(pid, &status, 0) == -1)
+		errp("waitpid");
+	if (!WIFEXITED(status) || WEXITSTATUS(status))
+		err("%s failed: %#x", true_path, status);
+}
+
+static void op_execv(struct thread *t, size_t i)
+{
+	char *argv[] = { (char *)true_path, NULL };
+	pid_t pid = fork();
+
+	if (pid == 0) {
+		execv(true_path, argv);
+		_exit(127);
+	}
+	wait_child(pid);
+}
+
+static void op_execvp(struct thread *t, size_t i)
+{
+	const char *name = strrchr(true_path, '/') + 1;
+	char *argv[] = { (char *)name, NULL };
+	pid_t pid = fork();
+
+	if (pid == 0) {
+		execvp(name, argv);
+		_exit(127);
+	}
+	wait_child(pid);
+}
+
+static void op_posix_spawn(struct thread *t, size_t i)
+{
+	char *argv[] = { (char *)true_path, NULL };
+	pid_t pid;
+	int ret;
+
+	ret = posix_spawn(&pid, true_path, NULL, NULL, argv, environ);
+	if (ret) {
+		errno = ret;
+		errp("posix_spawn");
+	}
+	wait_child(pid);
+}
+
+static const struct family families[] = {
+	{ "open_rd",     NULL,        op_open_rd,     1 },
+	{ "open_wr",     NULL,        op_open_wr,     1 },
+	{ "openat",      NULL,        op_openat,      1 },
+	{ "access",      NULL,        op_access,      1 },
+	{ "mkdir+rmdir", NULL,        op_mkdir,       1 },
+	{ "unlink",      prep_unlink, op_unlink,      1 },
+	{ "rename",      NULL,        op_rename,      1 },
+	{ "chmod",       NULL,        op_chmod,       1 },
+	{ "fchmod",      NULL,        op_fchmod,      1 },
+	{ "utimensat",   NULL,        op_utimensat,   1 },
+	{ "execv",       NULL,        op_execv,       100 },
+	{ "execvp",      NULL,        op_execvp,      100 },
+	{ "posix_spawn", NULL,        op_posix_spawn, 100 },
+	{ }
+};
+
+static void *thread_main(void *arg)
+{
+	struct thread *t = arg;
+	const struct family *f = t->family;
+	uint64_t start;
+	size_t i;
+
+	pthread_barrier_wait(&barrier);
+	t->start = bench_now();
+	for (i = 0; i < t->iters; ++i) {
+		if (f->prep)
+			f->prep(t, i);
+		start = bench_now();
+		f->op(t, i);
+		t->ns[i] = bench_now() - start;
+	}
+	t->end = bench_now();
+
+	return NULL;
+}
+
+static void run(const struct family *f, size_t nthreads, size_t iters)
+{
+	struct thread *threads = xzalloc(sizeof(*threads) * nthreads);
+	uint64_t *ns, start = UINT64_MAX, end = 0, total = 0;
+	size_t i, n, nops;
+	int ret;
+
+	iters = MAX(iters / f->div, 10);
+	nops = iters * nthreads;
+	ns = xmalloc(sizeof(*ns) * nops);
+
+	pthread_barrier_init(&barrier, NULL, nthreads + 1);
+	for (i = 0; i < nthreads; ++i) {
+		struct thread *t = &threads[i];
+
+		t->family = f;
+		t->iters = iters;
+		t->ns = &ns[i * iters];
+		snprintf(t->dir, sizeof(t->dir), "thread%zu", i);
+		snprintf(t->file, sizeof(t->file), "%s/file", t->dir);
+		snprintf(t->file2, sizeof(t->file2), "%s/file2", t->dir);
+		if (mkdir(t->dir, 0755) && errno != EEXIST)
+			errp("mkdir(%s)", t->dir);
+		t->fd = open(t->file, O_RDWR|O_CREAT|O_CLOEXEC, 0644);
+		check(t->fd);
+		t->dirfd = open(t->dir, O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+		check(t->dirfd);
+
+		ret = pthread_create(&t->tid, NULL, thread_main, t);
+		if (ret) {
+			errno = ret;
+			errp("pthread_create");
+		}
+	}
+
+	pthread_barrier_wait(&barrier);
+
+	/* Time from when the first one starts until the last one is done. */
+	for (i = 0; i < nthreads; ++i) {
+		struct thread *t = &threads[i];
+
+		pthread_join(t->tid, NULL);
+		start = MIN(start, t->start);
+		end = MAX(end, t->end);
+		close(t->fd);
+		close(t->dirfd);
+		unlink(t->file2);
+	}
+	pthread_barrier_destroy(&barrier);
+
+	for (n = 0; n < nops; ++n)
+		total += ns[n];
+	printf("wrappers\t%s\t%s\t%zu\t%zu\t%zu\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%.0f\n",
+		bench_mode(), f->name, nthreads, bench_write_entries(), nops,
+		total / nops, bench_percentile(ns, nops, 50), bench_percentile(ns, nops, 99),
+		nops * 1e9 / (end - start));
+
+	free(ns);
+	free(threads);
+}
+
+static void usage(int status)
+{
+	const struct family *f;
+
+	fprintf(status ? stderr : stdout,
+		"Usage: wrappers [-q] [-n iters] [-t threads] [-x true] [family...]\n"
+		"\n"
+		"Families (all by default):");
+	for (f = families; f->name; ++f)
+		fprintf(status ? stderr : stdout, " %s", f->name);
+	fprintf(status ? stderr : stdout, "\n");
+	exit(status);
+}
+
+int main(int argc, char *argv[])
+{
+	const struct family *f;
+	size_t iters = 10000, nthreads = 1;
+	bool header = true;
+	int i, o;
+
+	while ((o = getopt(argc, argv, "hn:qt:x:")) != -1) {
+		switch (o) {
+		case 'h': usage(0);
+		case 'n': iters = bench_size_arg(optarg); break;
+		case 'q': header = false; break;
+		case 't': nthreads = bench_size_arg(optarg); break;
+		case 'x': true_path = optarg; break;
+		default:  usage(1);
+		}
+	}
+	if (!strchr(true_path, '/'))
+		err("-x needs a path: %s", true_path);
+
+	if (header)
+		printf("bench\tmode\tfamily\tthreads\twrite_entries\tops\tns_avg\tns_p50\tns_p99\tops_per_sec\n");
+
+	if (optind == argc) {
+		for (f = families; f->name; ++f)
+			run(f, nthreads, iters);
+	} else {
+		for (i = optind; i < argc; ++i) {
+			for (f = families; f->name; ++f)
+				if (!strcmp(f->name, argv[i]))
+					break;
+			if (!f->name)
+				err("unknown family: %s", argv[i]);
+			run(f, nthreads, iters);
+		}
+	}
+
+	return 0;
+}
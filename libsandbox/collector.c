@@ -0,0 +1,137 @@
+/* collector.c - hand messages & log records to the sandbox program
+ *
+ * Rather than every process opening the logs by name for each record, the
+ * sandbox program listens on a datagram socket and writes them out itself.
+ * Each record is a single datagram, so records from different processes never
+ * interleave, and we don't wait around for it to be written out (except for
+ * violations; see below).  Messages normally go straight to the message path,
+ * but are sent here when we can't open it ourselves (e.g. userpriv builds &
+ * root's stderr).
+ *
+ * If the collector isn't there (anymore), callers write things out directly
+ * like they always have.
+ *
+ * Copyright 2026 Gentoo Foundation
+ * Licensed under the GPL-2
+ */
+
+#include "headers.h"
+#include "sbutil.h"
+#include "libsandbox.h"
+
+static struct sockaddr_un collector_addr;
+
+void sb_collector_init(void)
+{
+	const char *path = getenv(ENV_SANDBOX_COLLECTOR);
+
+	if (path && *path && strlen(path) < sizeof(collector_addr.sun_path)) {
+		collector_addr.sun_family = AF_UNIX;
+		strcpy(collector_addr.sun_path, path);
+		sbio_collect = sb_collect;
+	}
+}
+
+const char *sb_collector_path(void)
+{
+	return sbio_collect ? collector_addr.sun_path : NULL;
+}
+
+/* Send one datagram, passing |pass_fd| along with it unless it's -1. */
+static ssize_t collector_send(const struct iovec *iov, int iovcnt, int pass_fd)
+{
+	union {
+		struct cmsghdr align;
+		char buf[CMSG_SPACE(sizeof(int))];
+	} control;
+	struct msghdr msg = {
+		.msg_name = &collector_addr,
+		.msg_namelen = sizeof(collector_addr),
+		.msg_iov = (struct iovec *)iov,
+		.msg_iovlen = iovcnt,
+	};
+	struct cmsghdr *cmsg;
+	ssize_t ret;
+	int fd;
+
+	if (pass_fd != -1) {
+		msg.msg_control = control.buf;
+		msg.msg_controllen = sizeof(control.buf);
+		cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+		memcpy(CMSG_DATA(cmsg), &pass_fd, sizeof(int));
+	}
+
+	/* Use a new socket every time: the program is free to close or reuse
+	 * any fd we might try to hold on to.
+	 */
+	fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (fd == -1)
+		return -1;
+	do {
+		ret = sendmsg(fd, &msg, MSG_NOSIGNAL);
+	} while (ret == -1 && errno == EINTR);
+	close(fd);
+
+	/* If the collector has gone away, don't keep trying. */
+	if (ret == -1 && (errno == ECONNREFUSED || errno == ENOENT))
+		sbio_collect = NULL;
+
+	return ret;
+}
+
+bool sb_collect(const struct iovec *iov, int iovcnt)
+{
+	ssize_t ret;
+	int ack[2];
+	char c;
+
+	save_errno();
+
+	/* Most things (e.g. the debug records for every check) are simply
+	 * queued up for the collector: once the send works, they're its job.
+	 */
+	if (*(const char *)iov[0].iov_base != SB_COLLECT_LOG) {
+		ret = collector_send(iov, iovcnt, -1);
+		goto done;
+	}
+
+	/* Violations are rare, but callers (& tests) expect them in the log as
+	 * soon as the call that was denied returns.  So pass along one end of
+	 * a pair for the collector to tell us once it has written it out.
+	 */
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, ack)) {
+		ret = -1;
+		goto done;
+	}
+	ret = collector_send(iov, iovcnt, ack[1]);
+	close(ack[1]);
+	if (ret != -1) {
+		/* If the collector goes away or drops the record instead,
+		 * we get EOF and write it out ourselves.
+		 */
+		do {
+			ret = recv(ack[0], &c, 1, 0);
+		} while (ret == -1 && errno == EINTR);
+		if (ret != 1)
+			ret = -1;
+	}
+	close(ack[0]);
+
+ done:
+	restore_errno();
+	return ret != -1;
+}
+
+/* Like sb_collect(), but pass |fd| along too. */
+bool sb_collect_fd(const struct iovec *iov, int iovcnt, int fd)
+{
+	ssize_t ret;
+
+	save_errno();
+	ret = collector_send(iov, iovcnt, fd);
+	restore_errno();
+	return ret != -1;
+}
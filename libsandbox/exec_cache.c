@@ -0,0 +1,101 @@
+/* exec_cache.c - remember how to run the programs we've seen
+ *
+ * Every exec has to work out whether the program can run with us preloaded,
+ * or whether it needs to be traced (see sb_check_exec()).  That means opening
+ * the program & walking its ELF headers, and builds tend to run the same few
+ * programs (sh, gcc, sed, ...) thousands of times.  So the sandbox program
+ * creates a file that all processes in the sandbox map, and records what it
+ * learned about each program there (see sb_exec_cache.h for the layout).
+ *
+ * We only ever read it: nobody in the sandbox gets to say how programs are
+ * run.  When a program isn't in there, we look at it ourselves, then hand the
+ * open program to the sandbox program's collector to look at & add.  Nothing
+ * here is critical -- when in doubt, we treat it as a miss and go look at the
+ * program.
+ *
+ * Copyright 2026 Gentoo Foundation
+ * Licensed under the GPL-2
+ */
+
+#include "headers.h"
+#include "sbutil.h"
+#include "libsandbox.h"
+#include "wrappers.h"
+
+char sb_exec_cache_path[SB_PATH_MAX];
+static const struct sb_exec_cache_entry *exec_cache;
+static bool exec_cache_mapped;
+
+void sb_exec_cache_init(void)
+{
+	const char *path = getenv(ENV_SANDBOX_EXEC_CACHE);
+
+	if (path && strlen(path) < sizeof(sb_exec_cache_path))
+		strcpy(sb_exec_cache_path, path);
+}
+
+static const struct sb_exec_cache_entry *exec_cache_map(void)
+{
+	if (exec_cache_mapped)
+		return exec_cache;
+
+	sb_lock();
+	if (exec_cache_mapped || !sb_exec_cache_path[0])
+		goto done;
+
+	/* It has no header to check; only the sandbox program writes to it. */
+	exec_cache = sb_map_shared_file(sb_exec_cache_path, SB_EXEC_CACHE_SIZE, PROT_READ, 0, 0);
+
+ done:
+	__sync_synchronize();
+	exec_cache_mapped = true;
+	sb_unlock();
+	return exec_cache;
+}
+
+bool sb_exec_cache_get(const struct stat64 *st, struct sb_exec_info *info)
+{
+	const struct sb_exec_cache_entry *cache, *e;
+	struct sb_exec_cache_entry copy;
+	uint32_t seq;
+	size_t i, idx;
+
+	cache = exec_cache_map();
+	if (!cache)
+		return false;
+
+	idx = sb_exec_cache_hash(st);
+	for (i = 0; i < SB_EXEC_CACHE_PROBES; ++i) {
+		e = &cache[(idx + i) % SB_EXEC_CACHE_ENTRIES];
+
+		seq = e->seq;
+		if (seq == 0)
+			return false;
+		if (seq & 1)
+			continue;
+		__sync_synchronize();
+		copy = *e;
+		__sync_synchronize();
+		if (e->seq != seq)
+			continue;
+
+		if (sb_exec_cache_match(&copy, st)) {
+			*info = copy.info;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void sb_exec_cache_put(int fd)
+{
+	char type = SB_COLLECT_EXEC;
+	struct iovec iov = { .iov_base = &type, .iov_len = 1, };
+
+	/* Don't bother the collector when there's nowhere to put it. */
+	if (!exec_cache_map() || !sbio_collect)
+		return;
+
+	sb_collect_fd(&iov, 1, fd);
+}
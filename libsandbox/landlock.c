@@ -0,0 +1,203 @@
+/* landlock.c - have the kernel enforce SANDBOX_WRITE (SANDBOX_METHOD=landlock)
+ *
+ * The first time a process execs something, we turn the write prefixes that
+ * check_access() works from into a Landlock ruleset: writes (creating,
+ * removing, renaming, truncating, ...) are only allowed beneath them, while
+ * reads aren't restricted at all.  The program it runs, and everything that
+ * runs in turn, is then held to that by the kernel, static programs included,
+ * so those don't need tracing anymore.  Dynamic ones still load us, so
+ * predictions & logging work the same as always.
+ *
+ * The ruleset only goes on right before the real exec, once the program has
+ * been looked at and the env set up, but a process whose exec fails anyway
+ * stays restricted (there's no way back).  Rules can only be added for paths
+ * that exist, so write prefixes that don't exist yet can't be created (nor
+ * anything beneath them) until the next sandbox.  Our logs only get created
+ * on the first violation though, so we let those be made in their dir.
+ *
+ * Rulesets can only ever be narrowed, so changes to SANDBOX_WRITE made further
+ * down (e.g. addwrite in a shell we run) can't get past the kernel.  Nor can
+ * denials be expressed, so SANDBOX_DENY & the log dir are still only enforced
+ * by us.  When the kernel can't do it, we quietly fall back to preload+ptrace.
+ *
+ * Copyright 2026 Gentoo Foundation
+ * Licensed under the GPL-2
+ */
+
+#include "headers.h"
+#include "sbutil.h"
+#include "libsandbox.h"
+#include "wrappers.h"
+
+#ifdef HAVE_LINUX_LANDLOCK_H
+# include <linux/landlock.h>
+#endif
+
+/* Our parent already restricted us (via ENV_SANDBOX_LANDLOCKED). */
+bool sb_landlock_inherited;
+
+/* The ruleset only applies to the thread that set it up (& whatever it runs),
+ * so don't let other threads think they're covered too.
+ */
+static __thread bool landlocked attribute_tls_ie;
+/* sb_landlock_prepare() said we would be by the time we exec. */
+static __thread bool pending attribute_tls_ie;
+
+bool sb_landlock_on(void)
+{
+	return sb_landlock_inherited || landlocked || pending;
+}
+
+/* ABI 2 (Linux 5.19+) is the oldest we can use; see below. */
+#if defined(LANDLOCK_ACCESS_FS_REFER) && defined(__NR_landlock_create_ruleset)
+
+/* Allow |access| beneath |path|, or |file_access| on it when it's not a dir. */
+static bool landlock_allow(int ruleset, const char *path, uint64_t access, uint64_t file_access)
+{
+	struct landlock_path_beneath_attr attr;
+	struct stat st;
+	int fd, ret;
+
+	fd = sb_unwrapped_open(path, O_PATH | O_CLOEXEC, 0);
+	if (fd == -1) {
+		/* There's nothing beneath paths that don't exist (yet). */
+		sb_debug_dyn("landlock: skipping %s: %s\n", path, strerror(errno));
+		return true;
+	}
+
+	ret = fstat(fd, &st);
+	if (ret == 0) {
+		attr.parent_fd = fd;
+		attr.allowed_access = S_ISDIR(st.st_mode) ? access : file_access;
+		ret = syscall(__NR_landlock_add_rule, ruleset, LANDLOCK_RULE_PATH_BENEATH, &attr, 0);
+	}
+	close(fd);
+
+	return ret == 0;
+}
+
+/* Let our file |path| be written, or created in its dir if it isn't there. */
+static bool landlock_allow_file(int ruleset, const char *path, uint64_t file_access)
+{
+	char dir[SB_PATH_MAX], *slash;
+
+	if (sb_unwrapped_access(path, F_OK) == 0 || errno != ENOENT ||
+	    strlen(path) >= sizeof(dir) || !strrchr(path, '/'))
+		return landlock_allow(ruleset, path, file_access, file_access);
+
+	strcpy(dir, path);
+	slash = strrchr(dir, '/');
+	slash[slash == dir] = '\0';
+	return landlock_allow(ruleset, dir, file_access | LANDLOCK_ACCESS_FS_MAKE_REG, file_access);
+}
+
+/* ABI 1 denies all renames & links across dirs, which builds can't live
+ * without, so we need 2+ (Linux 5.19+).  Returns the ABI, or 0 if we can't.
+ */
+static int landlock_abi(void)
+{
+	static int abi = -1;
+
+	if (abi == -1) {
+		abi = syscall(__NR_landlock_create_ruleset, NULL, 0, LANDLOCK_CREATE_RULESET_VERSION);
+		if (abi < 2) {
+			sb_debug_dyn("landlock: unavailable (%s), falling back\n",
+				abi == -1 ? strerror(errno) : "ABI too old");
+			abi = 0;
+		}
+	}
+	return abi;
+}
+
+bool sb_landlock_prepare(void)
+{
+	if (!sb_landlock_on() && landlock_abi())
+		pending = true;
+	return sb_landlock_on();
+}
+
+bool sb_landlock_pending(void)
+{
+	return pending;
+}
+
+bool sb_landlock_restrict(char * const prefixes[], int num_prefixes, const char * const files[])
+{
+	struct landlock_ruleset_attr attr = {};
+	uint64_t file_access;
+	int abi, ruleset, i, err;
+	bool ok = true;
+
+	if (!pending)
+		return true;
+	pending = false;
+
+	abi = landlock_abi();
+	if (!abi)
+		return false;
+
+	file_access = LANDLOCK_ACCESS_FS_WRITE_FILE;
+#ifdef LANDLOCK_ACCESS_FS_TRUNCATE
+	if (abi >= 3)
+		file_access |= LANDLOCK_ACCESS_FS_TRUNCATE;
+#endif
+	attr.handled_access_fs = file_access |
+		LANDLOCK_ACCESS_FS_REMOVE_DIR |
+		LANDLOCK_ACCESS_FS_REMOVE_FILE |
+		LANDLOCK_ACCESS_FS_MAKE_CHAR |
+		LANDLOCK_ACCESS_FS_MAKE_DIR |
+		LANDLOCK_ACCESS_FS_MAKE_REG |
+		LANDLOCK_ACCESS_FS_MAKE_SOCK |
+		LANDLOCK_ACCESS_FS_MAKE_FIFO |
+		LANDLOCK_ACCESS_FS_MAKE_BLOCK |
+		LANDLOCK_ACCESS_FS_MAKE_SYM |
+		LANDLOCK_ACCESS_FS_REFER;
+
+	ruleset = syscall(__NR_landlock_create_ruleset, &attr, sizeof(attr), 0);
+	if (ruleset == -1)
+		goto failed;
+
+	for (i = 0; ok && i < num_prefixes; ++i)
+		ok = landlock_allow(ruleset, prefixes[i], attr.handled_access_fs, file_access);
+	/* Our own files (logs, stats, ...) might live elsewhere. */
+	for (i = 0; ok && files[i]; ++i)
+		if (files[i][0])
+			ok = landlock_allow_file(ruleset, files[i], file_access);
+
+	/* The sandbox program sets this already, but the kernel insists. */
+	if (ok)
+		ok = prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) == 0 &&
+			syscall(__NR_landlock_restrict_self, ruleset, 0) == 0;
+	err = errno;
+	close(ruleset);
+	errno = err;
+	if (!ok)
+		goto failed;
+
+	landlocked = true;
+	return true;
+
+ failed:
+	/* The program was let off tracing on our word, so it can't run now. */
+	sb_debug_dyn("landlock: restricting failed: %s\n", strerror(errno));
+	return false;
+}
+
+#else
+
+bool sb_landlock_prepare(void)
+{
+	return sb_landlock_on();
+}
+
+bool sb_landlock_pending(void)
+{
+	return false;
+}
+
+bool sb_landlock_restrict(char * const prefixes[], int num_prefixes, const char * const files[])
+{
+	return true;
+}
+
+#endif
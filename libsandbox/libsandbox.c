@@ -16,50 +16,27 @@
 #include "wrappers.h"
 #include "sb_nr.h"
 
-#define LOG_VERSION			"1.0"
-#define LOG_STRING			"VERSION " LOG_VERSION "\n"
-#define LOG_FMT_FUNC			"FORMAT: F - Function called\n"
-#define LOG_FMT_ACCESS			"FORMAT: S - Access Status\n"
-#define LOG_FMT_PATH			"FORMAT: P - Path as passed to function\n"
-#define LOG_FMT_APATH			"FORMAT: A - Absolute Path (not canonical)\n"
-#define LOG_FMT_RPATH			"FORMAT: R - Canonical Path\n"
-#define LOG_FMT_CMDLINE			"FORMAT: C - Command Line\n"
-
 char sandbox_lib[SB_PATH_MAX];
+char sandbox_exec_helper[SB_PATH_MAX];
+pid_t sb_self_pid;
 
-typedef struct {
-	bool show_access_violation, on, active, testing, verbose, debug;
-	sandbox_method_t method;
-	char *ld_library_path;
-	char **prefixes[5];
-	int num_prefixes[5];
-#define             deny_prefixes     prefixes[0]
-#define         num_deny_prefixes num_prefixes[0]
-#define             read_prefixes     prefixes[1]
-#define         num_read_prefixes num_prefixes[1]
-#define            write_prefixes     prefixes[2]
-#define        num_write_prefixes num_prefixes[2]
-#define          predict_prefixes     prefixes[3]
-#define      num_predict_prefixes num_prefixes[3]
-#define     write_denied_prefixes     prefixes[4]
-#define num_write_denied_prefixes num_prefixes[4]
-#define MAX_DYN_PREFIXES 4 /* the first 4 are dynamic */
-} sbcontext_t;
 static sbcontext_t sbcontext;
 
 static char *cached_env_vars[MAX_DYN_PREFIXES];
 static char log_path[SB_PATH_MAX];
 static char debug_log_path[SB_PATH_MAX];
+/* Past this size, repeats only get counted; see log_seen_get(). */
+#define LOG_MAX_DEFAULT (1024 * 1024)
+static uint64_t log_max = LOG_MAX_DEFAULT;
+static char log_max_env[32];
 static char message_path[SB_PATH_MAX];
 bool sandbox_on = true;
 static bool sb_init = false;
 static bool sb_env_init = false;
 int (*sbio_open)(const char *, int, mode_t) = sb_unwrapped_open;
 FILE *(*sbio_popen)(const char *, const char *) = sb_unwrapped_popen;
+bool (*sbio_collect)(const struct iovec *, int);
 
-static char *resolve_path(const char *, int);
-static int check_prefixes(char **, int, const char *);
-static void clean_env_entries(char ***, int *);
 static void sb_process_env_settings(void);
 
 const char *sbio_message_path;
@@ -71,21 +48,33 @@ const char sbio_fallback_path[] = "/dev/tty";
  * However, we might still need to init the env vars in the syscall wrapper for
  * programs that have their own constructors.  #404013
  */
-__attribute__((constructor))
 void libsb_init(void)
 {
 	if (sb_env_init)
 		/* Ah, we already saw a syscall */
 		return;
 	sb_env_init = true;
+	sb_self_pid = getpid();
 
 	/* Get the path and name to this library */
 	get_sandbox_lib(sandbox_lib);
+	get_sandbox_exec_helper(sandbox_exec_helper);
 
 	get_sandbox_log(log_path, NULL);
 	get_sandbox_debug_log(debug_log_path, NULL);
 	get_sandbox_message_path(message_path);
 	sbio_message_path = message_path;
+	sb_exec_cache_init();
+	sb_collector_init();
+	sb_tracebuf_init();
+	sb_stats_init();
+	sb_timeline_init();
+
+	const char *log_max_str = getenv(ENV_SANDBOX_LOG_MAX);
+	if (log_max_str && strlen(log_max_str) < sizeof(log_max_env)) {
+		strcpy(log_max_env, log_max_str);
+		log_max = strtoull(log_max_env, NULL, 0);
+	}
 
 	memset(&sbcontext, 0x00, sizeof(sbcontext));
 	sbcontext.show_access_violation = true;
@@ -96,6 +85,7 @@ void libsb_init(void)
 	sbcontext.debug = is_env_on(ENV_SANDBOX_DEBUG);
 	sbcontext.testing = is_env_on(ENV_SANDBOX_TESTING);
 	sbcontext.method = get_sandbox_method();
+	sb_landlock_inherited = is_env_on(ENV_SANDBOX_LANDLOCKED);
 	if (sbcontext.testing) {
 		const char *ldpath = getenv("LD_LIBRARY_PATH");
 		if (ldpath)
@@ -103,11 +93,62 @@ void libsb_init(void)
 	}
 }
 
+/* The constructor only wraps libsb_init() so it can be timed for the stats:
+ * when the wrappers call it, they hold sb_lock(), which the stats need.
+ */
+__attribute__((constructor))
+static void libsb_ctor(void)
+{
+	struct timespec ts;
+	uint64_t start;
+
+	if (sb_env_init)
+		return;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	start = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+	libsb_init();
+	sb_stats_time(SB_STATS_TIME_INIT, start);
+}
+
 sandbox_method_t get_sandbox_method(void)
 {
 	return parse_sandbox_method(getenv(ENV_SANDBOX_METHOD));
 }
 
+/* Hand SANDBOX_WRITE over to the kernel for this process & whatever it runs,
+ * if sb_landlock_prepare() said we would.  See landlock.c.
+ */
+bool sb_landlock(void)
+{
+	const char * const files[] = {
+		log_path,
+		debug_log_path,
+		sb_tracebuf_path,
+		sb_stats_path,
+		sb_timeline_path,
+		NULL
+	};
+	bool ret;
+
+	if (!sb_landlock_pending())
+		return true;
+
+	sb_lock();
+
+	if (!sb_init) {
+		libsb_init();
+		sb_init = true;
+	}
+
+	/* Go by the current settings, like the checks do. */
+	sb_process_env_settings();
+	ret = sb_landlock_restrict(sbcontext.write_prefixes, sbcontext.num_write_prefixes, files);
+
+	sb_unlock();
+
+	return ret;
+}
+
 /* resolve_dirfd_path - get the path relative to a dirfd
  *
  * return value:
@@ -125,6 +166,7 @@ int resolve_dirfd_path(int dirfd, const char *path, char *resolved_path,
 	 *	- otherwise: file is relative to dirfd
 	 * Since maintaining fd state based on open's is real messy, we'll
 	 * just rely on the kernel doing it for us with /proc/<pid>/fd/ ...
+	 * (the tracer caches what it reads from there though).
 	 */
 	if (dirfd == AT_FDCWD || (path && path[0] == '/'))
 		return 1;
@@ -132,23 +174,25 @@ int resolve_dirfd_path(int dirfd, const char *path, char *resolved_path,
 	save_errno();
 
 	size_t at_len = resolved_path_len - 1 - 1 - (path ? strlen(path) : 0);
-	if (trace_pid) {
-		sprintf(resolved_path, "/proc/%i/fd/%i", trace_pid, dirfd);
-	} else {
+	ssize_t ret;
+	if (trace_pid)
+		ret = trace_readlink_fd(dirfd, resolved_path, at_len);
+	else {
 		/* If /proc was mounted by a process in a different pid namespace,
 		 * getpid cannot be used to create a valid /proc/<pid> path. Instead
 		 * use sb_get_fd_dir() which works in any case.
 		 */
-		sprintf(resolved_path, "%s/%i", sb_get_fd_dir(), dirfd);
+		char fd_path[64];
+		sprintf(fd_path, "%s/%i", sb_get_fd_dir(), dirfd);
+		ret = readlink(fd_path, resolved_path, at_len);
 	}
-	ssize_t ret = readlink(resolved_path, resolved_path, at_len);
 	if (ret == -1) {
 		/* see comments at end of check_syscall() */
 		if (errno_is_too_long()) {
 			restore_errno();
 			return 2;
 		}
-		sb_debug_dyn("AT_FD LOOKUP fail: %s: %s\n", resolved_path, strerror(errno));
+		sb_debug_dyn("AT_FD LOOKUP fail: fd %i: %s\n", dirfd, strerror(errno));
 		/* If the fd isn't found, some guys (glibc) expect errno */
 		if (errno == ENOENT)
 			errno = EBADF;
@@ -163,447 +207,266 @@ int resolve_dirfd_path(int dirfd, const char *path, char *resolved_path,
 	return 0;
 }
 
-int canonicalize(const char *path, char *resolved_path)
-{
-	int old_errno = errno;
-	char *retval;
-
-	*resolved_path = '\0';
+/*
+ * Internal Functions
+ */
 
-	/* If path == NULL, return or we get a segfault */
-	if (NULL == path) {
-		errno = EINVAL;
-		return -1;
-	}
+void __sb_dump_backtrace(void)
+{
+	const char *cmdline = sb_get_cmdline(trace_pid);
+	sb_printf("%s: ", cmdline);
+	sb_copy_file_to_fd(cmdline, STDERR_FILENO);
+	sb_printf("\n\n");
+}
 
-	/* Do not try to resolve an empty path */
-	if ('\0' == path[0]) {
-		errno = old_errno;
-		return 0;
-	}
+/* The cmdline of the process we're logging for.  It's the same for every
+ * record, so only read it the first time we need it.  The tracer resets it
+ * when the traced process execs.
+ */
+static char *log_cmdline;
+static size_t log_cmdline_len;
+static pid_t log_cmdline_pid;
 
-	/* We can't handle resolving a buffer inline (erealpath),
-	 * so demand separate read and write strings.
-	 */
-	sb_assert(path != resolved_path);
+void sb_log_cmdline_reset(void)
+{
+	free(log_cmdline);
+	log_cmdline = NULL;
+	log_cmdline_len = 0;
+	log_cmdline_pid = 0;
+	sb_tracebuf_cmdline_reset();
+}
 
-	retval = erealpath(path, resolved_path);
+const char *sb_log_get_cmdline(size_t *len)
+{
+	pid_t pid = trace_pid ? : getpid();
+	size_t size, ret;
+	int fd;
 
-	if ((NULL == retval) && (path[0] != '/')) {
-		/* The path could not be canonicalized, append it
-		 * to the current working directory if it was not
-		 * an absolute path
-		 */
+	if (log_cmdline && log_cmdline_pid == pid)
+		goto done;
 
-		if (errno_is_too_long())
-			return -1;
-
-		if (NULL == egetcwd(resolved_path, SB_PATH_MAX - 2))
-			return -1;
-		size_t len = strlen(resolved_path);
-		snprintf(resolved_path + len, SB_PATH_MAX - len, "/%s", path);
-
-		char *copy = xstrdup(resolved_path);
-		char *ret = erealpath(copy, resolved_path);
-		free(copy);
-		if (ret == NULL) {
-			if (errno_is_too_long()) {
-				/* The resolved path is too long for the buffer to hold */
-				return -1;
-			} else {
-				/* Whatever it resolved, is not a valid path */
-				errno = ENOENT;
-				return -1;
-			}
+	sb_log_cmdline_reset();
+	fd = sb_open(sb_get_cmdline(trace_pid), O_RDONLY|O_CLOEXEC, 0);
+	if (fd == -1)
+		return NULL;
+	size = getpagesize();
+	log_cmdline = xmalloc(size);
+	while (1) {
+		ret = sb_read(fd, log_cmdline + log_cmdline_len, size - log_cmdline_len);
+		if (ret == -1) {
+			sb_close(fd);
+			sb_log_cmdline_reset();
+			return NULL;
 		}
-
-	} else if ((NULL == retval) && (path[0] == '/')) {
-		/* Whatever it resolved, is not a valid path */
-		errno = ENOENT;
-		return -1;
+		log_cmdline_len += ret;
+		if (log_cmdline_len < size)
+			break;
+		size *= 2;
+		log_cmdline = xrealloc(log_cmdline, size);
 	}
+	sb_close(fd);
+	log_cmdline_pid = pid;
 
-	errno = old_errno;
-	return 0;
+ done:
+	*len = log_cmdline_len;
+	return log_cmdline;
 }
 
-static char *resolve_path(const char *path, int follow_link)
+/* Once the log is bigger than SANDBOX_LOG_MAX, stop writing out records that
+ * we've already written (same func, canonical path & cmdline) and only count
+ * them.  The count goes out with a copy of the record whenever it doubles, and
+ * when we exit, so the log barely grows no matter how often a program hits the
+ * same denial.  Processes only flush counts they made themselves.  Programs
+ * that leave via _exit() (like most shells) lose whatever they hadn't flushed
+ * yet, so the counts are a lower bound.
+ */
+#define LOG_SEEN_SIZE   64
+static struct log_seen {
+	uint64_t hash;
+	pid_t pid;
+	unsigned long count, flush_at;
+	char *record;	/* The last record we didn't write */
+	size_t len;
+} log_seen[LOG_SEEN_SIZE];
+
+static struct log_seen *log_seen_get(const struct sb_log_record *rec, bool *seen)
 {
-	char *dname, *bname;
-	char *filtered_path;
+	uint64_t hash = 0xcbf29ce484222325ull;
+	const char *fields[] = { rec->func, rec->rpath, };
+	struct log_seen *e;
+	size_t i, j;
 
-	if (NULL == path)
+	/* We share the table with our parent, so leave it be. */
+	if (sb_in_vfork_child())
 		return NULL;
 
-	save_errno();
-
-	filtered_path = xmalloc(SB_PATH_MAX * sizeof(char));
-
-	if (0 == follow_link) {
-		if (-1 == canonicalize(path, filtered_path)) {
-			free(filtered_path);
-			filtered_path = NULL;
+	for (i = 0; i < ARRAY_SIZE(fields); ++i)
+		for (j = 0; j <= strlen(fields[i]); ++j)
+			hash = (hash ^ (unsigned char)fields[i][j]) * 0x100000001b3ull;
+	for (j = 0; j < rec->cmdline_len; ++j)
+		hash = (hash ^ (unsigned char)rec->cmdline[j]) * 0x100000001b3ull;
+	hash = hash ? : 1;
+
+	for (i = 0; i < LOG_SEEN_SIZE; ++i) {
+		e = &log_seen[(hash + i) % LOG_SEEN_SIZE];
+		if (e->hash == hash) {
+			*seen = true;
+			break;
 		}
-	} else {
-		/* Basically we get the realpath which should resolve symlinks,
-		 * etc.  If that fails (might not exist), we try to get the
-		 * realpath of the parent directory, as that should hopefully
-		 * exist.  If all else fails, just go with canonicalize */
-		char *ret;
-		if (trace_pid)
-			ret = erealpath(path, filtered_path);
-		else
-			ret = realpath(path, filtered_path);
-
-		/* Handle broken symlinks.  This can come up for a variety of reasons,
-		 * but we need to make sure that we resolve the path all the way to the
-		 * final target, and not just where the current link happens to start.
-		 * Latest discussion is in #540828.
-		 *
-		 * Maybe we failed because of funky anonymous fd symlinks.
-		 * You can see this by doing something like:
-		 *		$ echo | ls -l /proc/self/fd/
-		 *		.......	0 -> pipe:[9422999]
-		 * So any syntax like this we should allow as there isn't any
-		 * actual file paths for us to check against. #288863
-		 * Don't look for any particular string as these are dynamic
-		 * according to the kernel.  You can see pipe:, socket:, etc...
-		 *
-		 * Maybe we failed because it's a symlink to a path in /proc/ that
-		 * is a symlink to a path that longer exists -- readlink will set
-		 * ENOENT even in that case and the file ends in (deleted).  This
-		 * can come up in cases like:
-		 * /dev/stderr -> fd/2 -> /proc/self/fd/2 -> /removed/file (deleted)
-		 */
-		if (!ret && errno == ENOENT) {
-			ret = canonicalize_filename_mode(path, CAN_ALL_BUT_LAST);
-			if (ret) {
-				free(filtered_path);
-				filtered_path = ret;
-			}
-		}
-
-		if (!ret) {
-			char tmp_str1[SB_PATH_MAX];
-			snprintf(tmp_str1, SB_PATH_MAX, "%s", path);
-
-			dname = dirname(tmp_str1);
-
-			/* If not, then check if we can resolve the
-			 * parent directory */
-			if (trace_pid)
-				ret = erealpath(dname, filtered_path);
-			else
-				ret = realpath(dname, filtered_path);
-			if (!ret) {
-				/* Fall back to canonicalize */
-				if (-1 == canonicalize(path, filtered_path)) {
-					free(filtered_path);
-					filtered_path = NULL;
-				}
-			} else {
-				char tmp_str2[SB_PATH_MAX];
-				/* OK, now add the basename to keep our access
-				 * checking happy (don't want '/usr/lib' if we
-				 * tried to do something with non-existing
-				 * file '/usr/lib/cf*' ...) */
-				snprintf(tmp_str2, SB_PATH_MAX, "%s", path);
-
-				bname = basename(tmp_str2);
-				size_t len = strlen(filtered_path);
-				snprintf(filtered_path + len, SB_PATH_MAX - len, "%s%s",
-					(filtered_path[len - 1] != '/') ? "/" : "",
-					bname);
-			}
+		if (e->hash == 0) {
+			e->hash = hash;
+			*seen = false;
+			break;
 		}
 	}
+	if (i == LOG_SEEN_SIZE)
+		return NULL;
 
-	/* If things failed, don't restore errno.  More info at comment at
-	 * end of check_syscall() function.
-	 */
-	if (filtered_path)
-		restore_errno();
-
-	return filtered_path;
+	/* Counts we inherited are our parent's to write out. */
+	if (e->pid != getpid()) {
+		e->pid = getpid();
+		e->count = 0;
+		e->flush_at = 1;
+		free(e->record);
+		e->record = NULL;
+	}
+	return e;
 }
 
-/*
- * Internal Functions
- */
-
-char *egetcwd(char *buf, size_t size)
+/* Write out the last record we skipped with how many it stands for. */
+static void log_seen_write(int fd, struct log_seen *e)
 {
-	struct stat64 st;
-	char *tmpbuf;
+	char *buf;
+	int len;
 
-	/* We can't let the C lib allocate memory for us since we have our
-	 * own local routines to handle things.
-	 */
-	bool allocated = (buf == NULL);
-	if (allocated) {
-		size = SB_PATH_MAX;
-		buf = xmalloc(size);
-	}
-
-	/* If tracing a child, our cwd may not be the same as the child's */
-	if (trace_pid) {
-		char proc[20];
-		sprintf(proc, "/proc/%i/cwd", trace_pid);
-		ssize_t ret = readlink(proc, buf, size);
-		if (ret == -1) {
-			errno = ESRCH;
-			return NULL;
-		}
-		buf[ret] = '\0';
-		return buf;
-	}
-
-	/* Need to disable sandbox, as on non-linux libc's, opendir() is
-	 * used by some getcwd() implementations and resolves to the sandbox
-	 * opendir() wrapper, causing infinit recursion and finially crashes.
-	 */
-	sandbox_on = false;
-	errno = 0;
-	tmpbuf = sb_unwrapped_getcwd(buf, size);
-	sandbox_on = true;
-
-	/* We basically try to figure out if we can trust what getcwd()
-	 * returned.  If one of the following happens kernel/libc side,
-	 * bad things will happen, but not much we can do about it:
-	 *  - Invalid pointer with errno = 0
-	 *  - Truncated path with errno = 0
-	 *  - Whatever I forgot about
-	 */
-	if ((tmpbuf) && (errno == 0)) {
-		save_errno();
-		if (!lstat64(buf, &st))
-			/* errno is set only on failure */
-			errno = 0;
-
-		if (errno == ENOENT)
-			/* If lstat failed with eerror = ENOENT, then its
-			 * possible that we are running on an older kernel
-			 * which had issues with returning invalid paths if
-			 * they got too long.  Return with errno = ENAMETOOLONG,
-			 * so that canonicalize() and check_syscall() know
-			 * what the issue is.
-			 */
-		  	errno = ENAMETOOLONG;
+	if (!e->count || !e->record || e->len < 2)
+		return;
+	buf = xmalloc(e->len + 32);
+	memcpy(buf, e->record, e->len - 2);
+	len = e->len - 2 + sprintf(buf + e->len - 2, ",\"count\":%lu}\n", e->count);
+	sb_write(fd, buf, len);
+	free(buf);
+	e->count = 0;
+}
 
-		if (errno && errno != EACCES) {
-			/* If getcwd() allocated the buffer, free it. */
-			if (allocated)
-				free(buf);
+__attribute__((destructor))
+static void log_seen_flush(void)
+{
+	size_t i;
+	int fd = -1;
 
-			/* Not sure if we should quit here, but I guess if
-			 * lstat fails, getcwd could have messed up. Not
-			 * sure what to do about errno - use lstat's for
-			 * now.
-			 */
-			return NULL;
+	for (i = 0; i < LOG_SEEN_SIZE; ++i) {
+		struct log_seen *e = &log_seen[i];
+		if (!e->count || e->pid != getpid())
+			continue;
+		if (fd == -1) {
+			fd = sb_open(log_path, O_APPEND | O_WRONLY | O_CLOEXEC | O_NOFOLLOW, 0);
+			if (fd == -1)
+				return;
 		}
-
-		restore_errno();
-	} else if (errno != 0) {
-		/* If getcwd() allocated the buffer, free it. */
-		if (allocated)
-			free(buf);
-
-		/* Make sure we do not return garbage if the current libc or
-		 * kernel's getcwd() is buggy.
-		 */
-		return NULL;
+		log_seen_write(fd, e);
 	}
-
-	return tmpbuf;
-}
-
-void __sb_dump_backtrace(void)
-{
-	const char *cmdline = sb_get_cmdline(trace_pid);
-	sb_printf("%s: ", cmdline);
-	sb_copy_file_to_fd(cmdline, STDERR_FILENO);
-	sb_printf("\n\n");
+	if (fd != -1)
+		sb_close(fd);
 }
 
-#define _SB_WRITE_STR(str) \
-	do { \
-		size_t _len = strlen(str); \
-		if (sb_write(logfd, str, _len) != _len) \
-			goto error; \
-	} while (0)
-static bool write_logfile(const char *logfile, const char *func, const char *path,
+/* Append a record to the log.  We format it up front so that it goes out in
+ * one piece: either to the collector (which writes the log for us), or with a
+ * single O_APPEND write, so that records from processes logging at the same
+ * time can't interleave.  |type| says which log this is for the collector.
+ */
+static bool write_logfile(char type, const char *logfile, const char *func, const char *path,
                           const char *apath, const char *rpath, bool access)
 {
 	struct stat64 log_stat;
-	int stat_ret;
+	struct sb_log_record rec = {
+		.func = func,
+		.path = path,
+		.apath = apath,
+		.rpath = rpath,
+		.access = access,
+		.pid = trace_pid ? : getpid(),
+	};
+	size_t len;
+	char *record;
 	int logfd;
-	bool ret = false;
-
-	stat_ret = lstat64(logfile, &log_stat);
-	/* Do not care about failure */
-	errno = 0;
-	if (stat_ret == 0 && S_ISREG(log_stat.st_mode) == 0)
-		sb_ebort("SECURITY BREACH: '%s' %s\n", logfile,
-			"already exists and is not a regular file!");
+	bool ret;
+
+	SB_PROBE(log, type, logfile, func, apath, access);
+
+	rec.cmdline = sb_log_get_cmdline(&rec.cmdline_len);
+	len = sb_log_format_record(NULL, &rec);
+	record = xmalloc(len);
+	sb_log_format_record(record, &rec);
+
+	if (sbio_collect) {
+		/* The collector uses the func & path to spot repeats. */
+		struct iovec iov[] = {
+			{ .iov_base = &type, .iov_len = 1, },
+			{ .iov_base = (void *)func, .iov_len = strlen(func) + 1, },
+			{ .iov_base = (void *)rpath, .iov_len = strlen(rpath) + 1, },
+			{ .iov_base = record, .iov_len = len, },
+		};
+		/* The debug log takes everything as is. */
+		struct iovec debug_iov[] = {
+			{ .iov_base = &type, .iov_len = 1, },
+			{ .iov_base = record, .iov_len = len, },
+		};
+		if (type == SB_COLLECT_LOG)
+			ret = sbio_collect(iov, ARRAY_SIZE(iov));
+		else
+			ret = sbio_collect(debug_iov, ARRAY_SIZE(debug_iov));
+		if (ret) {
+			free(record);
+			return true;
+		}
+	}
 
 	logfd = sb_open(logfile,
-		O_APPEND | O_WRONLY | O_CREAT | O_CLOEXEC,
+		O_APPEND | O_WRONLY | O_CREAT | O_CLOEXEC | O_NOFOLLOW,
 		S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if (logfd == -1 && errno == ELOOP)
+		sb_ebort("SECURITY BREACH: '%s' %s\n", logfile,
+			"already exists and is not a regular file!");
 	if (logfd == -1) {
 		sb_eerror("ISE:%s: unable to append logfile: %s\n",
 			__func__, logfile);
-		goto error;
+		free(record);
+		return false;
 	}
+	if (fstat64(logfd, &log_stat) == 0) {
+		if (!S_ISREG(log_stat.st_mode))
+			sb_ebort("SECURITY BREACH: '%s' %s\n", logfile,
+				"already exists and is not a regular file!");
+	} else
+		log_stat.st_size = 0;
+	/* Do not care about failure */
+	errno = 0;
 
-	if (0 != stat_ret)
-		_SB_WRITE_STR(
-			LOG_STRING
-			LOG_FMT_FUNC
-			LOG_FMT_ACCESS
-			LOG_FMT_PATH
-			LOG_FMT_APATH
-			LOG_FMT_RPATH
-			LOG_FMT_CMDLINE
-		);
-	/* Already have data in the log, so add a newline to space the
-	 * log entries.
-	 */
-
-	_SB_WRITE_STR("\nF: ");
-	_SB_WRITE_STR(func);
-	_SB_WRITE_STR("\nS: ");
-	if (access)
-		_SB_WRITE_STR("allow");
-	else
-		_SB_WRITE_STR("deny");
-	_SB_WRITE_STR("\nP: ");
-	_SB_WRITE_STR(path);
-	_SB_WRITE_STR("\nA: ");
-	_SB_WRITE_STR(apath);
-	_SB_WRITE_STR("\nR: ");
-	_SB_WRITE_STR(rpath);
-
-	_SB_WRITE_STR("\nC: ");
-	const char *cmdline = sb_get_cmdline(trace_pid);
-	if (sb_copy_file_to_fd(cmdline, logfd)) {
-		_SB_WRITE_STR("unable to read ");
-		_SB_WRITE_STR(cmdline);
+	if (type == SB_COLLECT_LOG && log_max) {
+		bool seen;
+		struct log_seen *e = log_seen_get(&rec, &seen);
+		if (e && seen && (uint64_t)log_stat.st_size >= log_max) {
+			free(e->record);
+			e->record = record;
+			e->len = len;
+			if (++e->count >= e->flush_at) {
+				log_seen_write(logfd, e);
+				e->flush_at *= 2;
+			}
+			sb_close(logfd);
+			return true;
+		}
 	}
-	_SB_WRITE_STR("\n");
 
-	ret = true;
+	ret = (sb_write(logfd, record, len) == len);
+	free(record);
 
- error:
 	sb_close(logfd);
 
 	return ret;
 }
 
-static void clean_env_entries(char ***prefixes_array, int *prefixes_num)
-{
-	if (*prefixes_array == NULL)
-		return;
-
-	size_t i;
-	save_errno();
-
-	for (i = 0; i < *prefixes_num; ++i) {
-		if (NULL != (*prefixes_array)[i]) {
-			free((*prefixes_array)[i]);
-			(*prefixes_array)[i] = NULL;
-		}
-	}
-	if (NULL != *prefixes_array)
-		free(*prefixes_array);
-	*prefixes_array = NULL;
-	*prefixes_num = 0;
-
-	restore_errno();
-}
-
-#define pfx_num		(*prefixes_num)
-#define pfx_array	(*prefixes_array)
-#define pfx_item	((*prefixes_array)[(*prefixes_num)])
-
-static void init_env_entries(char ***prefixes_array, int *prefixes_num, const char *env, const char *prefixes_env, int warn)
-{
-	char *token = NULL;
-	char *rpath = NULL;
-	char *buffer = NULL;
-	char *buffer_ptr = NULL;
-	int prefixes_env_length = strlen(prefixes_env);
-	int num_delimiters = 0;
-	int i = 0;
-	int old_errno = errno;
-
-	if (NULL == prefixes_env) {
-		/* Do not warn if this is in init stage, as we might get
-		 * issues due to LD_PRELOAD already set (bug #91431). */
-		if (sb_init)
-			fprintf(stderr,
-				"libsandbox:  The '%s' env variable is not defined!\n",
-				env);
-		if (pfx_array) {
-			for (i = 0; i < pfx_num; i++)
-				free(pfx_item);
-			free(pfx_array);
-		}
-		pfx_num = 0;
-
-		goto done;
-	}
-
-	for (i = 0; i < prefixes_env_length; i++) {
-		if (':' == prefixes_env[i])
-			num_delimiters++;
-	}
-
-	/* num_delimiters might be 0, and we need 2 entries at least */
-	pfx_array = xmalloc(((num_delimiters * 2) + 2) * sizeof(char *));
-	buffer = xstrdup(prefixes_env);
-	buffer_ptr = buffer;
-
-#ifdef HAVE_STRTOK_R
-	token = strtok_r(buffer_ptr, ":", &buffer_ptr);
-#else
-	token = strtok(buffer_ptr, ":");
-#endif
-
-	while ((NULL != token) && (strlen(token) > 0)) {
-		pfx_item = resolve_path(token, 0);
-		/* We do not care about errno here */
-		errno = 0;
-		if (NULL != pfx_item) {
-			pfx_num++;
-
-			/* Now add the realpath if it exists and
-			 * are not a duplicate */
-			rpath = xmalloc(SB_PATH_MAX * sizeof(char));
-			pfx_item = realpath(*(&(pfx_item) - 1), rpath);
-			if ((NULL != pfx_item) &&
-			    (0 != strcmp(*(&(pfx_item) - 1), pfx_item))) {
-				pfx_num++;
-			} else {
-				free(rpath);
-				pfx_item = NULL;
-			}
-		}
-
-#ifdef HAVE_STRTOK_R
-		token = strtok_r(NULL, ":", &buffer_ptr);
-#else
-		token = strtok(NULL, ":");
-#endif
-	}
-
-	free(buffer);
-
-done:
-	errno = old_errno;
-	return;
-}
-
 static void sb_process_env_settings(void)
 {
 	static const char * const sb_env_names[4] = {
@@ -633,7 +496,7 @@ static void sb_process_env_settings(void)
 
 			if (sb_env) {
 				init_env_entries(&sbcontext.prefixes[i], &sbcontext.num_prefixes[i],
-					sb_env_names[i], sb_env, 1);
+					sb_env_names[i], sb_env, sb_init);
 				cached_env_vars[i] = xstrdup(sb_env);
 			} else
 				cached_env_vars[i] = NULL;
@@ -641,251 +504,6 @@ static void sb_process_env_settings(void)
 	}
 }
 
-static int check_prefixes(char **prefixes, int num_prefixes, const char *path)
-{
-	if (!prefixes)
-		return 0;
-
-	size_t i;
-	for (i = 0; i < num_prefixes; ++i) {
-		if (unlikely(!prefixes[i]))
-			continue;
-
-		size_t prefix_len = strlen(prefixes[i]);
-		/* Start with a regular prefix match for speed */
-		if (strncmp(path, prefixes[i], prefix_len))
-			continue;
-
-		/* Now, if prefix did not end with a slash, we need to make sure
-		 * we are not matching in the middle of a filename. So check
-		 * whether the match is followed by a slash, or NUL.
-		 */
-		if (prefixes[i][prefix_len-1] != '/'
-				&& path[prefix_len] != '/' && path[prefix_len] != '\0')
-			continue;
-
-		return 1;
-	}
-
-	return 0;
-}
-
-/* Is this a func that works on symlinks, and is the file a symlink ? */
-static bool symlink_func(int sb_nr, int flags)
-{
-	/* These funcs always operate on symlinks */
-	if (sb_nr == SB_NR_UNLINK       ||
-	    sb_nr == SB_NR_UNLINKAT     ||
-	    sb_nr == SB_NR_LCHOWN       ||
-	    sb_nr == SB_NR_LREMOVEXATTR ||
-	    sb_nr == SB_NR_LSETXATTR    ||
-	    sb_nr == SB_NR_LUTIMES      ||
-	    sb_nr == SB_NR_REMOVE       ||
-	    sb_nr == SB_NR_RENAME       ||
-	    sb_nr == SB_NR_RENAMEAT     ||
-	    sb_nr == SB_NR_RENAMEAT2    ||
-	    sb_nr == SB_NR_RMDIR        ||
-	    sb_nr == SB_NR_SYMLINK      ||
-	    sb_nr == SB_NR_SYMLINKAT)
-		return true;
-
-	/* These funcs sometimes operate on symlinks */
-	if ((sb_nr == SB_NR_FCHOWNAT ||
-	     sb_nr == SB_NR_FCHMODAT ||
-	     sb_nr == SB_NR_UTIMENSAT) &&
-	    (flags & AT_SYMLINK_NOFOLLOW))
-		return true;
-
-	return false;
-}
-
-static int check_access(sbcontext_t *sbcontext, int sb_nr, const char *func,
-                        int flags, const char *abs_path, const char *resolv_path)
-{
-	int old_errno = errno;
-	int result = 0;
-	int retval;
-	bool sym_func = symlink_func(sb_nr, flags);
-
-	retval = check_prefixes(sbcontext->deny_prefixes,
-		sbcontext->num_deny_prefixes, abs_path);
-	if (1 == retval)
-		/* Fall in a read/write denied path, Deny Access */
-		goto out;
-
-	if (!strncmp(resolv_path, "/memfd:", strlen("/memfd:"))) {
-		/* Allow operations on memfd objects #910561 */
-		result = 1;
-		goto out;
-	}
-
-	if (!sym_func) {
-		retval = check_prefixes(sbcontext->deny_prefixes,
-			sbcontext->num_deny_prefixes, resolv_path);
-		if (1 == retval)
-			/* Fall in a read/write denied path, Deny Access */
-			goto out;
-	}
-
-	if (sbcontext->read_prefixes &&
-	    (sb_nr == SB_NR_ACCESS_RD ||
-	     sb_nr == SB_NR_OPEN_RD   ||
-	     sb_nr == SB_NR_OPENDIR   ||
-	     sb_nr == SB_NR_POPEN     ||
-	     sb_nr == SB_NR_SYSTEM    ||
-	   /*sb_nr == SB_NR_EXECL     ||
-	     sb_nr == SB_NR_EXECLP    ||
-	     sb_nr == SB_NR_EXECLE    ||*/
-	     sb_nr == SB_NR_EXECV     ||
-	     sb_nr == SB_NR_EXECVP    ||
-	     sb_nr == SB_NR_EXECVE    ||
-	     sb_nr == SB_NR_EXECVPE   ||
-	     sb_nr == SB_NR_FEXECVE))
-	{
-		retval = check_prefixes(sbcontext->read_prefixes,
-					sbcontext->num_read_prefixes, resolv_path);
-		if (1 == retval) {
-			/* Fall in a readable path, Grant Access */
-			result = 1;
-			goto out;
-		}
-
-		/* If we are here, and still no joy, and its the access() call,
-		 * do not log it, but just return -1 */
-		if (sb_nr == SB_NR_ACCESS_RD) {
-			sbcontext->show_access_violation = false;
-			goto out;
-		}
-	}
-
-	/* Hardcode denying write to the whole log dir.  While this is a
-	 * parial match and so rejects paths that also start with this
-	 * string, that isn't going to happen in real life so live with
-	 * it.  We can't append a slash to this path either as that would
-	 * allow people to open the dir itself for writing.
-	 */
-	if (!strncmp(resolv_path, SANDBOX_LOG_LOCATION, strlen(SANDBOX_LOG_LOCATION)))
-		goto out;
-
-	if (sb_nr == SB_NR_ACCESS_WR   ||
-	    sb_nr == SB_NR_CHMOD       ||
-	    sb_nr == SB_NR_CHOWN       ||
-	    sb_nr == SB_NR_CREAT       ||
-	    sb_nr == SB_NR_CREAT64     ||
-	    sb_nr == SB_NR_FCHMOD      ||
-	    sb_nr == SB_NR_FCHMODAT    ||
-	    sb_nr == SB_NR_FCHOWN      ||
-	    sb_nr == SB_NR_FCHOWNAT    ||
-	  /*sb_nr == SB_NR_FTRUNCATE   ||
-	    sb_nr == SB_NR_FTRUNCATE64 ||*/
-	    sb_nr == SB_NR_FUTIMESAT   ||
-	    sb_nr == SB_NR_LCHOWN      ||
-	    sb_nr == SB_NR_LINK        ||
-	    sb_nr == SB_NR_LINKAT      ||
-	    sb_nr == SB_NR_LREMOVEXATTR||
-	    sb_nr == SB_NR_LSETXATTR   ||
-	    sb_nr == SB_NR_LUTIMES     ||
-	    sb_nr == SB_NR_MKDIR       ||
-	    sb_nr == SB_NR_MKDIRAT     ||
-	    sb_nr == SB_NR_MKDTEMP     ||
-	    sb_nr == SB_NR_MKFIFO      ||
-	    sb_nr == SB_NR_MKFIFOAT    ||
-	    sb_nr == SB_NR_MKNOD       ||
-	    sb_nr == SB_NR_MKNODAT     ||
-	    sb_nr == SB_NR_MKOSTEMP    ||
-	    sb_nr == SB_NR_MKOSTEMP64  ||
-	    sb_nr == SB_NR_MKOSTEMPS   ||
-	    sb_nr == SB_NR_MKOSTEMPS64 ||
-	    sb_nr == SB_NR_MKSTEMP     ||
-	    sb_nr == SB_NR_MKSTEMP64   ||
-	    sb_nr == SB_NR_MKSTEMPS    ||
-	    sb_nr == SB_NR_MKSTEMPS64  ||
-	    sb_nr == SB_NR_OPEN_WR     ||
-	    sb_nr == SB_NR_REMOVE      ||
-	    sb_nr == SB_NR_REMOVEXATTR ||
-	    sb_nr == SB_NR_RENAME      ||
-	    sb_nr == SB_NR_RENAMEAT    ||
-	    sb_nr == SB_NR_RENAMEAT2   ||
-	    sb_nr == SB_NR_RMDIR       ||
-	    sb_nr == SB_NR_SETXATTR    ||
-	    sb_nr == SB_NR_SYMLINK     ||
-	    sb_nr == SB_NR_SYMLINKAT   ||
-	    sb_nr == SB_NR_TRUNCATE    ||
-	    sb_nr == SB_NR_TRUNCATE64  ||
-	    sb_nr == SB_NR_UNLINK      ||
-	    sb_nr == SB_NR_UNLINKAT    ||
-	    sb_nr == SB_NR_UTIME       ||
-	    sb_nr == SB_NR_UTIMENSAT   ||
-	    sb_nr == SB_NR_UTIMES      ||
-	    sb_nr == SB_NR__XMKNOD     ||
-	    sb_nr == SB_NR___XMKNOD    ||
-	    sb_nr == SB_NR___XMKNODAT)
-	{
-
-		retval = check_prefixes(sbcontext->write_denied_prefixes,
-					sbcontext->num_write_denied_prefixes,
-					resolv_path);
-		if (1 == retval)
-			/* Falls in a write denied path, Deny Access */
-			goto out;
-
-		retval = check_prefixes(sbcontext->write_prefixes,
-					sbcontext->num_write_prefixes, resolv_path);
-		if (1 == retval) {
-			/* Falls in a writable path, Grant Access */
-			result = 1;
-			goto out;
-		}
-
-		/* Hack to allow writing to '/proc/self/fd' #91516.  It needs
-		 * to be here as for each process, the '/proc/self' symlink
-		 * will differ ...
-		 */
-		char proc_self_fd[SB_PATH_MAX];
-		if (realpath(sb_get_fd_dir(), proc_self_fd) &&
-		    !strncmp(resolv_path, proc_self_fd, strlen(proc_self_fd)))
-		{
-			result = 1;
-			goto out;
-		}
-
-		/* If operating on a location those parent dirs do not exist,
-		 * then let it through as the OS itself will trigger a fail.
-		 * This is like fopen("/foo/bar", "w") and /foo/ does not
-		 * exist.  All the functions filtered thus far fall into that
-		 * behavior category, so no need to check the syscall.
-		 */
-		char *dname_buf = xstrdup(resolv_path);
-		int aret = sb_unwrapped_access(dirname(dname_buf), F_OK);
-		free(dname_buf);
-		if (aret) {
-			result = 1;
-			goto out;
-		}
-
-		retval = check_prefixes(sbcontext->predict_prefixes,
-					sbcontext->num_predict_prefixes, resolv_path);
-		if (1 == retval) {
-			/* Is a known access violation, so deny access,
-			 * and do not log it */
-			sbcontext->show_access_violation = false;
-			goto out;
-		}
-
-		/* If we are here, and still no joy, and its the access() call,
-		 * do not log it, but just return -1 */
-		if (sb_nr == SB_NR_ACCESS_WR) {
-			sbcontext->show_access_violation = false;
-			goto out;
-		}
-	}
-
-out:
-	errno = old_errno;
-
-	return result;
-}
-
 /* Return values:
  *  0: failure, caller should abort
  *  1: things worked out fine
@@ -899,8 +517,11 @@ static int check_syscall(sbcontext_t *sbcontext, int sb_nr, const char *func,
 	int old_errno = errno;
 	int result;
 	bool access, debug, verbose, set;
+	uint64_t span_start;
 
+	span_start = sb_timeline_start();
 	absolute_path = resolve_path(file, 0);
+	sb_timeline_span(SB_SPAN_RESOLVE, func, span_start);
 	if (!absolute_path)
 		goto error;
 
@@ -908,10 +529,13 @@ static int check_syscall(sbcontext_t *sbcontext, int sb_nr, const char *func,
 	 * itself does not dereference.  This speeds things up and avoids updating
 	 * the atime implicitly. #415475
 	 */
-	if (symlink_func(sb_nr, flags))
+	if (symlink_func(sb_nr_attrs_get(sb_nr), flags))
 		resolved_path = absolute_path;
-	else
+	else {
+		span_start = sb_timeline_start();
 		resolved_path = resolve_path(file, 1);
+		sb_timeline_span(SB_SPAN_RESOLVE, func, span_start);
+	}
 	if (!absolute_path || !resolved_path)
 		goto error;
 	sb_debug_dyn("absolute_path: %s\n", absolute_path);
@@ -945,13 +569,20 @@ static int check_syscall(sbcontext_t *sbcontext, int sb_nr, const char *func,
 		access = true;
 
 	if (unlikely(!access)) {
-		bool worked = write_logfile(log_path, func, file, absolute_path, resolved_path, access);
+		span_start = sb_timeline_start();
+		bool worked = write_logfile(SB_COLLECT_LOG, log_path, func, file, absolute_path, resolved_path, access);
+		sb_timeline_span(SB_SPAN_LOG, func, span_start);
 		if (!worked && errno)
 			goto error;
 	}
 
+	if (unlikely(sb_tracebuf_path[0]))
+		sb_tracebuf_record(sb_nr, func, file, absolute_path, resolved_path, access);
+
 	if (unlikely(debug)) {
-		bool worked = write_logfile(debug_log_path, func, file, absolute_path, resolved_path, access);
+		span_start = sb_timeline_start();
+		bool worked = write_logfile(SB_COLLECT_DEBUG, debug_log_path, func, file, absolute_path, resolved_path, access);
+		sb_timeline_span(SB_SPAN_LOG, func, span_start);
 		if (!worked && errno)
 			goto error;
 	}
@@ -1034,8 +665,10 @@ bool is_sandbox_on(void)
 
 bool before_syscall(int dirfd, int sb_nr, const char *func, const char *file, int flags)
 {
-	int result;
+	int result, stats_result;
 	char at_file_buf[SB_PATH_MAX];
+	uint64_t stats_start = sb_stats_start();
+	uint64_t span_start = sb_timeline_start();
 
 	/* Some funcs operate on a fd directly and so filename is NULL, but
 	 * the rest should get rejected as "file/directory does not exist".
@@ -1060,8 +693,12 @@ bool before_syscall(int dirfd, int sb_nr, const char *func, const char *file, in
 		case 2: return true;
 	}
 
+	SB_PROBE(check__entry, sb_nr, func, file);
+
 	save_errno();
 
+	sb_vfork_leftovers_free();
+
 	/* Need to protect the global sbcontext structure */
 	sb_lock();
 
@@ -1077,8 +714,19 @@ bool before_syscall(int dirfd, int sb_nr, const char *func, const char *file, in
 
 	result = check_syscall(&sbcontext, sb_nr, func, file, flags);
 
+	if (result)
+		stats_result = SB_STATS_ALLOWED;
+	else if (sbcontext.show_access_violation)
+		stats_result = SB_STATS_DENIED;
+	else
+		stats_result = SB_STATS_PREDICTED;
+
 	sb_unlock();
 
+	SB_PROBE(check__return, sb_nr, func, file, stats_result);
+	sb_stats_check(sb_nr, func, stats_result, stats_start);
+	sb_timeline_span(SB_SPAN_CHECK, func, span_start);
+
 	if (0 == result) {
 		/* FIXME: Should probably audit errno, and enable some other
 		 *        error to be returned (EINVAL for invalid mode for
@@ -1147,12 +795,13 @@ typedef struct {
 } env_pair;
 #define ENV_PAIR(x, n, v) [x] = { .name = n, .len = sizeof(n) - 1, .value = v, }
 
-#define str_list_add_item_env(_string_list, _var, _item, _error) \
-	do { \
-		char *str = xmalloc(strlen(_var) + strlen(_item) + 2); \
-		sprintf(str, "%s=%s", _var, _item); \
-		str_list_add_item(_string_list, str, _error); \
-	} while (0)
+static void sb_strv_add_env(struct sb_strv *v, const char *var, const char *val)
+{
+	char *str = xmalloc(strlen(var) + strlen(val) + 2);
+	sprintf(str, "%s=%s", var, val);
+	sb_strv_add(v, str);
+}
+
 /* We need to make sure we pass along sandbox env vars.  If we don't, programs
  * (like scons) will inadvertently disable us.  While we allow modification
  * (e.g. export SANDBOX_WRITE=""), we disallow clearing (e.g. unset SANDBOX_WRITE).
@@ -1192,10 +841,21 @@ struct sb_envp_ctx sb_new_envp(char **envp, bool insert)
 		ENV_PAIR(12, "LD_LIBRARY_PATH", NULL),
 		ENV_PAIR(13, ENV_SANDBOX_TESTING, NULL),
 		ENV_PAIR(14, ENV_SANDBOX_METHOD, NULL),
+		ENV_PAIR(15, ENV_SANDBOX_EXEC_CACHE,
+		         sb_exec_cache_path[0] ? sb_exec_cache_path : NULL),
+		ENV_PAIR(16, ENV_SANDBOX_COLLECTOR, sb_collector_path()),
+		ENV_PAIR(17, ENV_SANDBOX_TRACEBUF,
+		         sb_tracebuf_path[0] ? sb_tracebuf_path : NULL),
+		ENV_PAIR(18, ENV_SANDBOX_LOG_MAX, log_max_env[0] ? log_max_env : NULL),
+		ENV_PAIR(19, ENV_SANDBOX_STATSBUF,
+		         sb_stats_path[0] ? sb_stats_path : NULL),
+		ENV_PAIR(20, ENV_SANDBOX_TIMELINEBUF,
+		         sb_timeline_path[0] ? sb_timeline_path : NULL),
+		ENV_PAIR(21, ENV_SANDBOX_LANDLOCKED, sb_landlock_on() ? "1" : NULL),
 	};
 	size_t num_vars = ARRAY_SIZE(vars);
 	char *found_vars[num_vars];
-	size_t found_var_cnt;
+	size_t found_var_cnt, envp_cnt;
 
 	/* If sandbox is explicitly disabled, do not propagate the vars
 	 * and just return user's envp */
@@ -1207,7 +867,9 @@ struct sb_envp_ctx sb_new_envp(char **envp, bool insert)
 	memset(found_vars, 0, sizeof(found_vars));
 
 	/* Iterate through user's environment and check against expected. */
+	envp_cnt = 0;
 	str_list_for_each_item(envp, entry, count) {
+		++envp_cnt;
 		for (i = 0; i < num_vars; ++i) {
 			if (found_vars[i])
 				continue;
@@ -1267,7 +929,9 @@ struct sb_envp_ctx sb_new_envp(char **envp, bool insert)
 	if (sbcontext.method != SANDBOX_METHOD_ANY)
 		vars[14].value = str_sandbox_method(sbcontext.method);
 
-	char ** my_env = NULL;
+	/* We know how big it can get, so size it all up front. */
+	struct sb_strv my_env = {};
+	sb_strv_reserve(&my_env, envp_cnt + num_vars + 1);
 	if (!insert) {
 		str_list_for_each_item(envp, entry, count) {
 			for (i = 0; i < num_vars; ++i)
@@ -1276,7 +940,7 @@ struct sb_envp_ctx sb_new_envp(char **envp, bool insert)
 					r.__mod_cnt++;
 					goto skip;
 				}
-			str_list_add_item(my_env, entry, error);
+			sb_strv_add(&my_env, entry);
  skip: ;
 		}
 	} else {
@@ -1284,25 +948,28 @@ struct sb_envp_ctx sb_new_envp(char **envp, bool insert)
 		 * logic below.  Getting out of sync can mean memory corruption. */
 		r.__mod_cnt = 0;
 		if (unlikely(merge_ld_preload)) {
-			str_list_add_item(my_env, ld_preload, error);
+			sb_strv_add(&my_env, ld_preload);
 			r.__mod_cnt++;
 		}
 		for (i = 0; i < num_vars; ++i) {
 			if (found_vars[i] || !vars[i].value)
 				continue;
-			str_list_add_item_env(my_env, vars[i].name, vars[i].value, error);
+			sb_strv_add_env(&my_env, vars[i].name, vars[i].value);
 			r.__mod_cnt++;
 		}
 
-		str_list_for_each_item(envp, entry, count) {
-			if (unlikely(merge_ld_preload && is_env_var(entry, vars[0].name, vars[0].len)))
-				continue;
-			str_list_add_item(my_env, entry, error);
+		if (likely(!merge_ld_preload))
+			sb_strv_add_all(&my_env, envp);
+		else {
+			str_list_for_each_item(envp, entry, count) {
+				if (is_env_var(entry, vars[0].name, vars[0].len))
+					continue;
+				sb_strv_add(&my_env, entry);
+			}
 		}
 	}
 
- error:
-	r.sb_envp = my_env;
+	r.sb_envp = my_env.strs;
 	return r;
 }
 
@@ -1322,3 +989,47 @@ void sb_free_envp(struct sb_envp_ctx * envp_ctx)
 	if (envp != envp_ctx->orig_envp)
 		free(envp);
 }
+
+/* vfork() children share our memory, and once their exec works, nothing is
+ * left to free what the exec wrapper set up for it.  So they note it down here,
+ * in the thread they borrowed from their parent, and the parent frees it the
+ * next time it comes through us.  That keeps it to one child's worth at most.
+ */
+static __thread struct {
+	pid_t pid;
+	struct sb_envp_ctx envp_ctx;
+	void *mem[4];
+} vfork_leftovers attribute_tls_ie;
+
+void sb_vfork_leftovers_set(const struct sb_envp_ctx *envp_ctx, void * const mem[], size_t num)
+{
+	size_t i;
+
+	vfork_leftovers.envp_ctx = *envp_ctx;
+	for (i = 0; i < ARRAY_SIZE(vfork_leftovers.mem); ++i)
+		vfork_leftovers.mem[i] = i < num ? mem[i] : NULL;
+	vfork_leftovers.pid = getpid();
+}
+
+/* The exec failed, so the wrapper frees it all itself. */
+void sb_vfork_leftovers_clear(void)
+{
+	vfork_leftovers.pid = 0;
+}
+
+void sb_vfork_leftovers_free(void)
+{
+	size_t i;
+
+	/* The thread only runs again as us once the child is gone. */
+	if (likely(!vfork_leftovers.pid) || vfork_leftovers.pid == getpid())
+		return;
+	vfork_leftovers.pid = 0;
+
+	/* The child might have swapped its env in for the exec. */
+	if (environ == vfork_leftovers.envp_ctx.sb_envp)
+		environ = vfork_leftovers.envp_ctx.orig_envp;
+	sb_free_envp(&vfork_leftovers.envp_ctx);
+	for (i = 0; i < ARRAY_SIZE(vfork_leftovers.mem); ++i)
+		free(vfork_leftovers.mem[i]);
+}
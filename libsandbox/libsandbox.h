@@ -55,6 +55,40 @@
 #define SB_NR_UNDEF -99999
 #define SB_NR_IS_DEFINED(nr) (nr > SB_NR_UNDEF)
 
+/* Attributes of each SB_NR_* func; generated from symbols.h.in. */
+#define SB_ATTR_READ          0x01
+#define SB_ATTR_WRITE         0x02
+#define SB_ATTR_EXEC          0x04
+#define SB_ATTR_NOFOLLOW      0x08
+#define SB_ATTR_NOFOLLOW_FLAG 0x10
+struct sb_nr_attrs {
+	const char *name;
+	unsigned char flags;
+	/* Arg numbers of the paths the tracer checks (path is 0 when unused).
+	 * The dirfd & flags args are optional (0) too.
+	 */
+	struct sb_trace_path {
+		unsigned char dirfd, path, flags;
+	} trace[2];
+};
+extern const struct sb_nr_attrs sb_nr_attrs[];
+const struct sb_nr_attrs *sb_nr_attrs_get(int sb_nr);
+
+/* How sb_check_exec() runs programs it has seen before; see exec_cache.c. */
+#include "sb_exec_cache.h"
+extern char sb_exec_cache_path[];
+void sb_exec_cache_init(void);
+bool sb_exec_cache_get(const struct stat64 *, struct sb_exec_info *);
+void sb_exec_cache_put(int fd);
+
+/* landlock.c - the kernel enforcing SANDBOX_WRITE */
+extern bool sb_landlock_inherited;
+bool sb_landlock_on(void);
+bool sb_landlock_prepare(void);
+bool sb_landlock_pending(void);
+bool sb_landlock_restrict(char * const prefixes[], int num_prefixes, const char * const files[]);
+bool sb_landlock(void);
+
 bool is_sandbox_on(void);
 bool before_syscall(int, int, const char *, const char *, int);
 bool before_syscall_access(int, int, const char *, const char *, int);
@@ -67,6 +101,13 @@ enum sandbox_method_t get_sandbox_method(void);
 void *get_dlsym(const char *symname, const char *symver);
 
 extern char sandbox_lib[SB_PATH_MAX];
+extern char sandbox_exec_helper[SB_PATH_MAX];
+
+/* We don't wrap vfork(), and its children share our memory until they exec, so
+ * they still see the pid of the parent here.  fork() children update it.
+ */
+extern pid_t sb_self_pid;
+#define sb_in_vfork_child() (sb_self_pid && sb_self_pid != getpid())
 extern bool sandbox_on;
 
 struct sb_envp_ctx {
@@ -82,25 +123,120 @@ struct sb_envp_ctx {
 };
 struct sb_envp_ctx sb_new_envp(char **envp, bool insert);
 void sb_free_envp(struct sb_envp_ctx * envp_ctx);
+void sb_vfork_leftovers_set(const struct sb_envp_ctx *envp_ctx, void * const mem[], size_t num);
+void sb_vfork_leftovers_clear(void);
+void sb_vfork_leftovers_free(void);
+
+void sb_collector_init(void);
+const char *sb_collector_path(void);
+bool sb_collect(const struct iovec *iov, int iovcnt);
+bool sb_collect_fd(const struct iovec *iov, int iovcnt, int fd);
 
 extern pid_t trace_pid;
 
+void sb_log_cmdline_reset(void);
+const char *sb_log_get_cmdline(size_t *len);
+
+/* The shared trace buffer; see tracebuf.c. */
+extern char sb_tracebuf_path[];
+void sb_tracebuf_init(void);
+void sb_tracebuf_cmdline_reset(void);
+void sb_tracebuf_record(int sb_nr, const char *func, const char *path,
+                        const char *apath, const char *rpath, bool access);
+
+/* Counters for `sandbox --stats`; see stats.c. */
+#define SB_STATS_ALLOWED        0
+#define SB_STATS_DENIED         1
+#define SB_STATS_PREDICTED      2
+#define SB_STATS_EXEC_PRELOAD   0
+#define SB_STATS_EXEC_TRACE     1
+#define SB_STATS_EXEC_UNCHECKED 2
+#define SB_STATS_EXEC_OTHER     3
+#define SB_STATS_TIME_INIT      0
+#define SB_STATS_TIME_EXEC      1
+#define SB_STATS_TIME_CLASSIFY  2
+extern char sb_stats_path[];
+void sb_stats_init(void);
+uint64_t sb_stats_start(void);
+void sb_stats_check(int sb_nr, const char *func, int result, uint64_t start);
+void sb_stats_exec(int sb_nr, const char *func, int result, bool cached);
+void sb_stats_trace_stop(void);
+void sb_stats_time(int what, uint64_t start);
+
+/* Spans for SANDBOX_TIMELINE (SB_SPAN_*); see timeline.c. */
+#include "sb_timeline.h"
+extern char sb_timeline_path[];
+void sb_timeline_init(void);
+uint64_t sb_timeline_start(void);
+void sb_timeline_span(int kind, const char *name, uint64_t start);
+
+/* USDT probes (provider "sandbox") for SystemTap, bpftrace & perf.  They're a
+ * single nop until something attaches to them, and left out entirely when the
+ * C library doesn't come with <sys/sdt.h>.
+ *
+ *  check-entry   (sb_nr, func, path)
+ *  check-return  (sb_nr, func, path, verdict)  verdict is an SB_STATS_* result
+ *  resolve-entry (path, follow_link)
+ *  resolve-broken-link (path)                  realpath() hit a dangling link
+ *  resolve-parent (path)                       trying the parent dir instead
+ *  resolve-return (path, follow_link, resolved) resolved might be NULL
+ *  log           (type, logfile, func, apath, access)
+ *  exec          (func, path, decision, cached) decision is SB_STATS_EXEC_*
+ *  trace-start   (tracee pid)
+ *  trace-stop    (tracee pid, waitpid status)
+ *  trace-fork    (tracee pid, new pid, ptrace event)
+ *  trace-attach  (new tracee pid)
+ */
+#ifdef HAVE_SYS_SDT_H
+# include <sys/sdt.h>
+# define SB_PROBE(name, ...) STAP_PROBEV(sandbox, name, __VA_ARGS__)
+#else
+# define SB_PROBE(name, ...) do { } while (0)
+#endif
+
 extern void sb_lock(void);
 extern void sb_unlock(void);
 
 bool trace_possible(const char *filename, char *const argv[], const void *data);
 void trace_main(void);
+ssize_t trace_readlink_cwd(char *buf, size_t bufsiz);
+ssize_t trace_readlink_fd(int fd, char *buf, size_t bufsiz);
 
 /* glibc modified realpath() function */
 char *erealpath(const char *, char *);
 char *egetcwd(char *, size_t);
 int canonicalize(const char *, char *);
+char *resolve_path(const char *, int);
 int resolve_dirfd_path(int, const char *, char *, size_t);
 /* most linux systems use ENAMETOOLONG, but some (ia64) use ERANGE, as do some BSDs */
 #define errno_is_too_long() (errno == ENAMETOOLONG || errno == ERANGE)
 
 #include "sbutil.h"
 
+/* The decision engine; see policy.c. */
+typedef struct {
+	bool show_access_violation, on, active, testing, verbose, debug;
+	sandbox_method_t method;
+	char *ld_library_path;
+	char **prefixes[5];
+	int num_prefixes[5];
+#define             deny_prefixes     prefixes[0]
+#define         num_deny_prefixes num_prefixes[0]
+#define             read_prefixes     prefixes[1]
+#define         num_read_prefixes num_prefixes[1]
+#define            write_prefixes     prefixes[2]
+#define        num_write_prefixes num_prefixes[2]
+#define          predict_prefixes     prefixes[3]
+#define      num_predict_prefixes num_prefixes[3]
+#define     write_denied_prefixes     prefixes[4]
+#define num_write_denied_prefixes num_prefixes[4]
+#define MAX_DYN_PREFIXES 4 /* the first 4 are dynamic */
+} sbcontext_t;
+void init_env_entries(char ***, int *, const char *, const char *, int);
+void clean_env_entries(char ***, int *);
+bool symlink_func(const struct sb_nr_attrs *, int);
+int check_access(sbcontext_t *, int, const char *, int, const char *, const char *);
+
 /* glibc sometimes redefines this crap on us */
 #undef strdup
 /* our helper xstrdup will be calling glibc strdup, so blah */
@@ -25,6 +25,9 @@ libsbutil/.libs/libsbutil.a: libsbutil/libsbutil.la
 %C%_libsandbox_la_SOURCES = \
 	%D%/libsandbox.h \
 	%D%/libsandbox.c \
+	%D%/collector.c \
+	%D%/exec_cache.c \
+	%D%/landlock.c   \
 	%D%/lock.c       \
 	%D%/memory.c     \
 	%D%/pre_check_at.c \
@@ -32,7 +35,12 @@ libsbutil/.libs/libsbutil.a: libsbutil/libsbutil.la
 	%D%/pre_check_openat64.c \
 	%D%/pre_check_openat.c \
 	%D%/pre_check_unlinkat.c \
+	%D%/policy.c     \
+	%D%/resolve.c    \
+	%D%/stats.c      \
+	%D%/timeline.c   \
 	%D%/trace.c      \
+	%D%/tracebuf.c   \
 	%D%/wrappers.h   \
 	%D%/wrappers.c   \
 	%D%/canonicalize.c
@@ -45,6 +53,8 @@ uninstall-hook:
 	rm -f $(DESTDIR)$(libdir)/libsandbox.so
 
 %D%/libsandbox.c: %D%/libsandbox.map %D%/sb_nr.h
+%D%/policy.c: %D%/sb_nr.h %D%/sb_nr_attrs.h
+%D%/stats.c: %D%/sb_nr.h
 %D%/trace.c: %D%/trace_syscalls.h %D%/sb_nr.h $(TRACE_FILES)
 %D%/wrappers.c: %D%/symbols.h
 
@@ -57,6 +67,7 @@ SYMBOLS_WRAPPERS = $(wildcard $(top_srcdir)/%D%/wrapper-funcs/*.[ch])
 GEN_VERSION_MAP_SCRIPT = $(SCRIPT_DIR)/gen_symbol_version_map.awk
 GEN_HEADER_SCRIPT = $(SCRIPT_DIR)/gen_symbol_header.awk
 GEN_TRACE_SCRIPT = $(SCRIPT_DIR)/gen_trace_header.awk
+TRACE_SYMBOLS_FILE = $(top_srcdir)/%D%/trace_syscalls.in
 SB_AWK = LC_ALL=C $(AWK) -v SYMBOLS_FILE="$(SYMBOLS_FILE)" -v srcdir="$(top_srcdir)/%D%" -f
 
 %D%/libsandbox.map: $(SYMBOLS_FILE) $(GEN_VERSION_MAP_SCRIPT)
@@ -67,16 +78,21 @@ SB_AWK = LC_ALL=C $(AWK) -v SYMBOLS_FILE="$(SYMBOLS_FILE)" -v srcdir="$(top_srcd
 	@$(MKDIR_P) %D%
 	$(AM_V_GEN)$(READELF) -sW $(LIBC_PATH) | $(SB_AWK) $(GEN_HEADER_SCRIPT) > $@
 
+%D%/sb_nr_attrs.h: $(SYMBOLS_FILE) $(GEN_HEADER_SCRIPT)
+	@$(MKDIR_P) %D%
+	$(AM_V_GEN)$(SB_AWK) $(GEN_HEADER_SCRIPT) -v MODE=attrs < /dev/null > $@
+
 SB_NR_FILE = %D%/sb_nr.h.in
 %D%/sb_nr.h: %D%/symbols.h $(SB_NR_FILE)
 	@$(MKDIR_P) %D%
 	$(AM_V_GEN)$(EGREP) -h '^\#define SB_' $^ > $@
 
+SB_TRACE_AWK = $(SB_AWK) $(GEN_TRACE_SCRIPT) -v TRACE_SYMBOLS_FILE="$(TRACE_SYMBOLS_FILE)"
 TRACE_MAKE_HEADER = \
-	$(SB_AWK) $(GEN_TRACE_SCRIPT) -v MODE=gen | \
+	$(SB_TRACE_AWK) -v MODE=gen | \
 		$(COMPILE) -E -P -include $(top_srcdir)/headers.h - $$f | \
-		$(SB_AWK) $(GEN_TRACE_SCRIPT) -v syscall_prefix=$$t > $$header
-%D%/trace_syscalls.h: $(SYMBOLS_FILE) $(GEN_TRACE_SCRIPT) $(SB_SCHIZO_HEADERS)
+		$(SB_TRACE_AWK) -v syscall_prefix=$$t > $$header
+%D%/trace_syscalls.h: $(SYMBOLS_FILE) $(TRACE_SYMBOLS_FILE) $(GEN_TRACE_SCRIPT) $(SB_SCHIZO_HEADERS)
 	@$(MKDIR_P) %D%
 if SB_SCHIZO
 	$(AM_V_GEN)touch $@
@@ -84,7 +100,7 @@ else
 	$(AM_V_GEN)t= f= header=$@; $(TRACE_MAKE_HEADER)
 endif
 
-$(SB_SCHIZO_HEADERS): $(SYMBOLS_FILE) $(GEN_TRACE_SCRIPT)
+$(SB_SCHIZO_HEADERS): $(SYMBOLS_FILE) $(TRACE_SYMBOLS_FILE) $(GEN_TRACE_SCRIPT)
 	@$(MKDIR_P) %D%
 	$(AM_V_GEN)for pers in $(SB_SCHIZO_SETTINGS) ; do \
 		t=_$${pers%:*}; \
@@ -96,10 +112,11 @@ $(SB_SCHIZO_HEADERS): $(SYMBOLS_FILE) $(GEN_TRACE_SCRIPT)
 		fi; \
 	done
 
-EXTRA_DIST += $(SYMBOLS_FILE) $(SYMBOLS_WRAPPERS) $(SB_NR_FILE) $(TRACE_FILES)
+EXTRA_DIST += $(SYMBOLS_FILE) $(SYMBOLS_WRAPPERS) $(SB_NR_FILE) $(TRACE_FILES) $(TRACE_SYMBOLS_FILE)
 
 CLEANFILES += \
 	%D%/libsandbox.map \
 	%D%/sb_nr.h \
+	%D%/sb_nr_attrs.h \
 	%D%/symbols.h \
 	%D%/trace_syscalls*.h
@@ -19,22 +19,24 @@
 #define MIN_ALIGN (2 * sizeof(void *))
 
 /* Well screw me sideways, someone decided to override mmap() #290249
- * We probably don't need to include the exact sym version ...
+ * We used to dlsym() the C library's mmap(), but the dynamic linker may call
+ * malloc() itself, and if the program interposes its own allocator, that can
+ * call back into us before we've finished initializing. https://crbug.com/586444
+ * So talk to the kernel directly: that way nothing in here depends on the
+ * program's symbols, its allocator, or its TLS.
  */
-static void *(*_sb_mmap)(void *addr, size_t length, int prot, int flags, int fd, off_t offset);
 static void *sb_mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset)
 {
-	if (!_sb_mmap)
-		_sb_mmap = get_dlsym("mmap", NULL);
-	return _sb_mmap(addr, length, prot, flags, fd, offset);
+#ifdef SYS_mmap2
+	return (void *)syscall(SYS_mmap2, addr, length, prot, flags, fd, offset >> 12);
+#else
+	return (void *)syscall(SYS_mmap, addr, length, prot, flags, fd, offset);
+#endif
 }
 #define mmap sb_mmap
-static int (*_sb_munmap)(void *addr, size_t length);
 static int sb_munmap(void *addr, size_t length)
 {
-	if (!_sb_munmap)
-		_sb_munmap = get_dlsym("munmap", NULL);
-	return _sb_munmap(addr, length);
+	return syscall(SYS_munmap, addr, length);
 }
 #define munmap sb_munmap
 
@@ -114,3 +116,16 @@ char *strdup(const char *s)
 		return ret;
 	return memcpy(ret, s, len + 1);
 }
+
+char *strndup(const char *s, size_t n)
+{
+	size_t len;
+	char *ret;
+
+	len = strnlen(s, n);
+	ret = malloc(len + 1);
+	if (!ret)
+		return ret;
+	ret[len] = '\0';
+	return memcpy(ret, s, len);
+}
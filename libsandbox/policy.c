@@ -0,0 +1,319 @@
+/*
+ * policy.c
+ *
+ * The decision engine: turn the SANDBOX_{DENY,READ,WRITE,PREDICT} lists into
+ * prefixes, and decide whether an access to an already resolved path is let
+ * through.  Nothing here looks at the env or logs anything itself, so the
+ * replay benchmark (bench/replay.c) can run recorded accesses through it.
+ *
+ * Copyright 1999-2008 Gentoo Foundation
+ * Licensed under the GPL-2
+ */
+
+#include "headers.h"
+#include "sbutil.h"
+#include "libsandbox.h"
+#include "wrappers.h"
+#include "sb_nr.h"
+#include "sb_nr_attrs.h"
+
+void clean_env_entries(char ***prefixes_array, int *prefixes_num)
+{
+	if (*prefixes_array == NULL)
+		return;
+
+	size_t i;
+	save_errno();
+
+	for (i = 0; i < *prefixes_num; ++i) {
+		if (NULL != (*prefixes_array)[i]) {
+			free((*prefixes_array)[i]);
+			(*prefixes_array)[i] = NULL;
+		}
+	}
+	if (NULL != *prefixes_array)
+		free(*prefixes_array);
+	*prefixes_array = NULL;
+	*prefixes_num = 0;
+
+	restore_errno();
+}
+
+#define pfx_num		(*prefixes_num)
+#define pfx_array	(*prefixes_array)
+#define pfx_item	((*prefixes_array)[(*prefixes_num)])
+
+void init_env_entries(char ***prefixes_array, int *prefixes_num, const char *env, const char *prefixes_env, int warn)
+{
+	char *token = NULL;
+	char *rpath = NULL;
+	char *buffer = NULL;
+	char *buffer_ptr = NULL;
+	int prefixes_env_length = strlen(prefixes_env);
+	int num_delimiters = 0;
+	int i = 0;
+	int old_errno = errno;
+
+	if (NULL == prefixes_env) {
+		/* Do not warn if this is in init stage, as we might get
+		 * issues due to LD_PRELOAD already set (bug #91431). */
+		if (warn)
+			fprintf(stderr,
+				"libsandbox:  The '%s' env variable is not defined!\n",
+				env);
+		if (pfx_array) {
+			for (i = 0; i < pfx_num; i++)
+				free(pfx_item);
+			free(pfx_array);
+		}
+		pfx_num = 0;
+
+		goto done;
+	}
+
+	for (i = 0; i < prefixes_env_length; i++) {
+		if (':' == prefixes_env[i])
+			num_delimiters++;
+	}
+
+	/* num_delimiters might be 0, and we need 2 entries at least */
+	pfx_array = xmalloc(((num_delimiters * 2) + 2) * sizeof(char *));
+	buffer = xstrdup(prefixes_env);
+	buffer_ptr = buffer;
+
+#ifdef HAVE_STRTOK_R
+	token = strtok_r(buffer_ptr, ":", &buffer_ptr);
+#else
+	token = strtok(buffer_ptr, ":");
+#endif
+
+	while ((NULL != token) && (strlen(token) > 0)) {
+		pfx_item = resolve_path(token, 0);
+		/* We do not care about errno here */
+		errno = 0;
+		if (NULL != pfx_item) {
+			pfx_num++;
+
+			/* Now add the realpath if it exists and
+			 * are not a duplicate */
+			rpath = xmalloc(SB_PATH_MAX * sizeof(char));
+			pfx_item = realpath(*(&(pfx_item) - 1), rpath);
+			if ((NULL != pfx_item) &&
+			    (0 != strcmp(*(&(pfx_item) - 1), pfx_item))) {
+				pfx_num++;
+			} else {
+				free(rpath);
+				pfx_item = NULL;
+			}
+		}
+
+#ifdef HAVE_STRTOK_R
+		token = strtok_r(NULL, ":", &buffer_ptr);
+#else
+		token = strtok(NULL, ":");
+#endif
+	}
+
+	free(buffer);
+
+done:
+	errno = old_errno;
+	return;
+}
+
+static int check_prefixes(char **prefixes, int num_prefixes, const char *path)
+{
+	if (!prefixes)
+		return 0;
+
+	size_t i;
+	for (i = 0; i < num_prefixes; ++i) {
+		if (unlikely(!prefixes[i]))
+			continue;
+
+		size_t prefix_len = strlen(prefixes[i]);
+		/* Start with a regular prefix match for speed */
+		if (strncmp(path, prefixes[i], prefix_len))
+			continue;
+
+		/* Now, if prefix did not end with a slash, we need to make sure
+		 * we are not matching in the middle of a filename. So check
+		 * whether the match is followed by a slash, or NUL.
+		 */
+		if (prefixes[i][prefix_len-1] != '/'
+				&& path[prefix_len] != '/' && path[prefix_len] != '\0')
+			continue;
+
+		return 1;
+	}
+
+	return 0;
+}
+
+const struct sb_nr_attrs *sb_nr_attrs_get(int sb_nr)
+{
+	/* The funcs from sb_nr.h.in that wrappers check as. */
+	static const struct sb_nr_attrs pseudo_attrs[] = {
+		[-SB_NR_ACCESS_RD] = { .flags = SB_ATTR_READ, },
+		[-SB_NR_ACCESS_WR] = { .flags = SB_ATTR_WRITE, },
+		[-SB_NR_OPEN_RD]   = { .flags = SB_ATTR_READ, },
+		[-SB_NR_OPEN_WR]   = { .flags = SB_ATTR_WRITE, },
+	};
+
+	if (sb_nr > 0 && sb_nr <= SB_NR_MAX)
+		return &sb_nr_attrs[sb_nr];
+	/* Funcs the C library lacks can still be seen when tracing. */
+	if (sb_nr < SB_NR_UNDEF && SB_NR_UNDEF - sb_nr <= SB_NR_MAX)
+		return &sb_nr_attrs[SB_NR_UNDEF - sb_nr];
+	if (sb_nr < 0 && -sb_nr < (int)ARRAY_SIZE(pseudo_attrs))
+		return &pseudo_attrs[-sb_nr];
+
+	/* Slot 0 is never used, so it has no attributes. */
+	return &sb_nr_attrs[0];
+}
+
+/* Is this a func that works on symlinks, and is the file a symlink ? */
+bool symlink_func(const struct sb_nr_attrs *attrs, int flags)
+{
+	/* These funcs always operate on symlinks */
+	if (attrs->flags & SB_ATTR_NOFOLLOW)
+		return true;
+
+	/* These funcs sometimes operate on symlinks */
+	if ((attrs->flags & SB_ATTR_NOFOLLOW_FLAG) &&
+	    (flags & AT_SYMLINK_NOFOLLOW))
+		return true;
+
+	return false;
+}
+
+int check_access(sbcontext_t *sbcontext, int sb_nr, const char *func,
+                        int flags, const char *abs_path, const char *resolv_path)
+{
+	int old_errno = errno;
+	int result = 0;
+	int retval;
+	const struct sb_nr_attrs *attrs = sb_nr_attrs_get(sb_nr);
+	bool sym_func = symlink_func(attrs, flags);
+
+	retval = check_prefixes(sbcontext->deny_prefixes,
+		sbcontext->num_deny_prefixes, abs_path);
+	if (1 == retval)
+		/* Fall in a read/write denied path, Deny Access */
+		goto out;
+
+	if (!strncmp(resolv_path, "/memfd:", strlen("/memfd:"))) {
+		/* Allow operations on memfd objects #910561 */
+		result = 1;
+		goto out;
+	}
+
+	if (!sym_func) {
+		retval = check_prefixes(sbcontext->deny_prefixes,
+			sbcontext->num_deny_prefixes, resolv_path);
+		if (1 == retval)
+			/* Fall in a read/write denied path, Deny Access */
+			goto out;
+	}
+
+	if (sbcontext->read_prefixes &&
+	    (attrs->flags & (SB_ATTR_READ | SB_ATTR_EXEC)))
+	{
+		retval = check_prefixes(sbcontext->read_prefixes,
+					sbcontext->num_read_prefixes, resolv_path);
+		if (1 == retval) {
+			/* Fall in a readable path, Grant Access */
+			result = 1;
+			goto out;
+		}
+
+		/* If we are here, and still no joy, and its the access() call,
+		 * do not log it, but just return -1 */
+		if (sb_nr == SB_NR_ACCESS_RD) {
+			sbcontext->show_access_violation = false;
+			goto out;
+		}
+	}
+
+	/* Hardcode denying write to the whole log dir.  While this is a
+	 * parial match and so rejects paths that also start with this
+	 * string, that isn't going to happen in real life so live with
+	 * it.  We can't append a slash to this path either as that would
+	 * allow people to open the dir itself for writing.
+	 */
+	if (!strncmp(resolv_path, SANDBOX_LOG_LOCATION, strlen(SANDBOX_LOG_LOCATION)))
+		goto out;
+	/* Same for the cache dir, as the sandbox program trusts what's in it. */
+	if (!strncmp(resolv_path, SANDBOX_CACHE_LOCATION, strlen(SANDBOX_CACHE_LOCATION)))
+		goto out;
+
+	if (attrs->flags & SB_ATTR_WRITE)
+	{
+
+		retval = check_prefixes(sbcontext->write_denied_prefixes,
+					sbcontext->num_write_denied_prefixes,
+					resolv_path);
+		if (1 == retval)
+			/* Falls in a write denied path, Deny Access */
+			goto out;
+
+		/* Only the sandbox program gets to say how programs are run. */
+		if (sb_exec_cache_path[0] && !strcmp(resolv_path, sb_exec_cache_path))
+			goto out;
+
+		retval = check_prefixes(sbcontext->write_prefixes,
+					sbcontext->num_write_prefixes, resolv_path);
+		if (1 == retval) {
+			/* Falls in a writable path, Grant Access */
+			result = 1;
+			goto out;
+		}
+
+		/* Hack to allow writing to '/proc/self/fd' #91516.  It needs
+		 * to be here as for each process, the '/proc/self' symlink
+		 * will differ ...
+		 */
+		char proc_self_fd[SB_PATH_MAX];
+		if (realpath(sb_get_fd_dir(), proc_self_fd) &&
+		    !strncmp(resolv_path, proc_self_fd, strlen(proc_self_fd)))
+		{
+			result = 1;
+			goto out;
+		}
+
+		/* If operating on a location those parent dirs do not exist,
+		 * then let it through as the OS itself will trigger a fail.
+		 * This is like fopen("/foo/bar", "w") and /foo/ does not
+		 * exist.  All the functions filtered thus far fall into that
+		 * behavior category, so no need to check the syscall.
+		 */
+		char *dname_buf = xstrdup(resolv_path);
+		int aret = sb_unwrapped_access(dirname(dname_buf), F_OK);
+		free(dname_buf);
+		if (aret) {
+			result = 1;
+			goto out;
+		}
+
+		retval = check_prefixes(sbcontext->predict_prefixes,
+					sbcontext->num_predict_prefixes, resolv_path);
+		if (1 == retval) {
+			/* Is a known access violation, so deny access,
+			 * and do not log it */
+			sbcontext->show_access_violation = false;
+			goto out;
+		}
+
+		/* If we are here, and still no joy, and its the access() call,
+		 * do not log it, but just return -1 */
+		if (sb_nr == SB_NR_ACCESS_WR) {
+			sbcontext->show_access_violation = false;
+			goto out;
+		}
+	}
+
+out:
+	errno = old_errno;
+
+	return result;
+}
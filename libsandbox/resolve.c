@@ -0,0 +1,270 @@
+/*
+ * resolve.c
+ *
+ * Turn the paths the wrapped funcs are passed into the absolute ones we check
+ * against the SANDBOX_* lists.  These are kept apart from the rest of
+ * libsandbox so the path benchmark (bench/paths.c) can build them on their own.
+ *
+ * Copyright 1999-2008 Gentoo Foundation
+ * Licensed under the GPL-2
+ */
+
+#include "headers.h"
+#include "sbutil.h"
+#include "libsandbox.h"
+#include "wrappers.h"
+
+char *egetcwd(char *buf, size_t size)
+{
+	struct stat64 st;
+	char *tmpbuf;
+
+	/* We can't let the C lib allocate memory for us since we have our
+	 * own local routines to handle things.
+	 */
+	bool allocated = (buf == NULL);
+	if (allocated) {
+		size = SB_PATH_MAX;
+		buf = xmalloc(size);
+	}
+
+	/* If tracing a child, our cwd may not be the same as the child's */
+	if (trace_pid) {
+		ssize_t ret = trace_readlink_cwd(buf, size);
+		if (ret == -1) {
+			errno = ESRCH;
+			return NULL;
+		}
+		buf[ret] = '\0';
+		return buf;
+	}
+
+	/* Need to disable sandbox, as on non-linux libc's, opendir() is
+	 * used by some getcwd() implementations and resolves to the sandbox
+	 * opendir() wrapper, causing infinit recursion and finially crashes.
+	 */
+	sandbox_on = false;
+	errno = 0;
+	tmpbuf = sb_unwrapped_getcwd(buf, size);
+	sandbox_on = true;
+
+	/* We basically try to figure out if we can trust what getcwd()
+	 * returned.  If one of the following happens kernel/libc side,
+	 * bad things will happen, but not much we can do about it:
+	 *  - Invalid pointer with errno = 0
+	 *  - Truncated path with errno = 0
+	 *  - Whatever I forgot about
+	 */
+	if ((tmpbuf) && (errno == 0)) {
+		save_errno();
+		if (!lstat64(buf, &st))
+			/* errno is set only on failure */
+			errno = 0;
+
+		if (errno == ENOENT)
+			/* If lstat failed with eerror = ENOENT, then its
+			 * possible that we are running on an older kernel
+			 * which had issues with returning invalid paths if
+			 * they got too long.  Return with errno = ENAMETOOLONG,
+			 * so that canonicalize() and check_syscall() know
+			 * what the issue is.
+			 */
+		  	errno = ENAMETOOLONG;
+
+		if (errno && errno != EACCES) {
+			/* If getcwd() allocated the buffer, free it. */
+			if (allocated)
+				free(buf);
+
+			/* Not sure if we should quit here, but I guess if
+			 * lstat fails, getcwd could have messed up. Not
+			 * sure what to do about errno - use lstat's for
+			 * now.
+			 */
+			return NULL;
+		}
+
+		restore_errno();
+	} else if (errno != 0) {
+		/* If getcwd() allocated the buffer, free it. */
+		if (allocated)
+			free(buf);
+
+		/* Make sure we do not return garbage if the current libc or
+		 * kernel's getcwd() is buggy.
+		 */
+		return NULL;
+	}
+
+	return tmpbuf;
+}
+
+int canonicalize(const char *path, char *resolved_path)
+{
+	int old_errno = errno;
+	char *retval;
+
+	*resolved_path = '\0';
+
+	/* If path == NULL, return or we get a segfault */
+	if (NULL == path) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	/* Do not try to resolve an empty path */
+	if ('\0' == path[0]) {
+		errno = old_errno;
+		return 0;
+	}
+
+	/* We can't handle resolving a buffer inline (erealpath),
+	 * so demand separate read and write strings.
+	 */
+	sb_assert(path != resolved_path);
+
+	retval = erealpath(path, resolved_path);
+
+	if ((NULL == retval) && (path[0] != '/')) {
+		/* The path could not be canonicalized, append it
+		 * to the current working directory if it was not
+		 * an absolute path
+		 */
+
+		if (errno_is_too_long())
+			return -1;
+
+		if (NULL == egetcwd(resolved_path, SB_PATH_MAX - 2))
+			return -1;
+		size_t len = strlen(resolved_path);
+		snprintf(resolved_path + len, SB_PATH_MAX - len, "/%s", path);
+
+		char *copy = xstrdup(resolved_path);
+		char *ret = erealpath(copy, resolved_path);
+		free(copy);
+		if (ret == NULL) {
+			if (errno_is_too_long()) {
+				/* The resolved path is too long for the buffer to hold */
+				return -1;
+			} else {
+				/* Whatever it resolved, is not a valid path */
+				errno = ENOENT;
+				return -1;
+			}
+		}
+
+	} else if ((NULL == retval) && (path[0] == '/')) {
+		/* Whatever it resolved, is not a valid path */
+		errno = ENOENT;
+		return -1;
+	}
+
+	errno = old_errno;
+	return 0;
+}
+
+char *resolve_path(const char *path, int follow_link)
+{
+	char *dname, *bname;
+	char *filtered_path;
+
+	if (NULL == path)
+		return NULL;
+
+	save_errno();
+
+	SB_PROBE(resolve__entry, path, follow_link);
+
+	filtered_path = xmalloc(SB_PATH_MAX * sizeof(char));
+
+	if (0 == follow_link) {
+		if (-1 == canonicalize(path, filtered_path)) {
+			free(filtered_path);
+			filtered_path = NULL;
+		}
+	} else {
+		/* Basically we get the realpath which should resolve symlinks,
+		 * etc.  If that fails (might not exist), we try to get the
+		 * realpath of the parent directory, as that should hopefully
+		 * exist.  If all else fails, just go with canonicalize */
+		char *ret;
+		if (trace_pid)
+			ret = erealpath(path, filtered_path);
+		else
+			ret = realpath(path, filtered_path);
+
+		/* Handle broken symlinks.  This can come up for a variety of reasons,
+		 * but we need to make sure that we resolve the path all the way to the
+		 * final target, and not just where the current link happens to start.
+		 * Latest discussion is in #540828.
+		 *
+		 * Maybe we failed because of funky anonymous fd symlinks.
+		 * You can see this by doing something like:
+		 *		$ echo | ls -l /proc/self/fd/
+		 *		.......	0 -> pipe:[9422999]
+		 * So any syntax like this we should allow as there isn't any
+		 * actual file paths for us to check against. #288863
+		 * Don't look for any particular string as these are dynamic
+		 * according to the kernel.  You can see pipe:, socket:, etc...
+		 *
+		 * Maybe we failed because it's a symlink to a path in /proc/ that
+		 * is a symlink to a path that longer exists -- readlink will set
+		 * ENOENT even in that case and the file ends in (deleted).  This
+		 * can come up in cases like:
+		 * /dev/stderr -> fd/2 -> /proc/self/fd/2 -> /removed/file (deleted)
+		 */
+		if (!ret && errno == ENOENT) {
+			SB_PROBE(resolve__broken_link, path);
+			ret = canonicalize_filename_mode(path, CAN_ALL_BUT_LAST);
+			if (ret) {
+				free(filtered_path);
+				filtered_path = ret;
+			}
+		}
+
+		if (!ret) {
+			char tmp_str1[SB_PATH_MAX];
+			snprintf(tmp_str1, SB_PATH_MAX, "%s", path);
+
+			dname = dirname(tmp_str1);
+			SB_PROBE(resolve__parent, path);
+
+			/* If not, then check if we can resolve the
+			 * parent directory */
+			if (trace_pid)
+				ret = erealpath(dname, filtered_path);
+			else
+				ret = realpath(dname, filtered_path);
+			if (!ret) {
+				/* Fall back to canonicalize */
+				if (-1 == canonicalize(path, filtered_path)) {
+					free(filtered_path);
+					filtered_path = NULL;
+				}
+			} else {
+				char tmp_str2[SB_PATH_MAX];
+				/* OK, now add the basename to keep our access
+				 * checking happy (don't want '/usr/lib' if we
+				 * tried to do something with non-existing
+				 * file '/usr/lib/cf*' ...) */
+				snprintf(tmp_str2, SB_PATH_MAX, "%s", path);
+
+				bname = basename(tmp_str2);
+				size_t len = strlen(filtered_path);
+				snprintf(filtered_path + len, SB_PATH_MAX - len, "%s%s",
+					(filtered_path[len - 1] != '/') ? "/" : "",
+					bname);
+			}
+		}
+	}
+
+	/* If things failed, don't restore errno.  More info at comment at
+	 * end of check_syscall() function.
+	 */
+	if (filtered_path)
+		restore_errno();
+
+	SB_PROBE(resolve__return, path, follow_link, filtered_path);
+
+	return filtered_path;
+}
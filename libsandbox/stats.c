@@ -0,0 +1,260 @@
+/* stats.c - count the checks we make for `sandbox --stats`
+ *
+ * When the sandbox program was started with SANDBOX_STATS, it passes down the
+ * path of a stats file (see sb_stats.h).  Each process takes a slot in there
+ * and counts the checks it makes, how they turned out & how long they took, so
+ * keeping track of all this only costs a few memory writes per check.  The
+ * sandbox program adds up all the slots once everything is done.  Like the
+ * trace buffer, none of this is critical: if we can't map it, we don't count.
+ *
+ * Copyright 2026 Gentoo Foundation
+ * Licensed under the GPL-2
+ */
+
+#include "headers.h"
+#include "sbutil.h"
+#include "libsandbox.h"
+#include "wrappers.h"
+#include "sb_nr.h"
+#include "sb_stats.h"
+
+char sb_stats_path[SB_PATH_MAX];
+static struct sb_stats *stats;
+static bool stats_mapped;
+
+/* The slot of the process that last used it; see stats_slot_get(). */
+static struct sb_stats_slot *stats_slot;
+static pid_t stats_pid;
+
+void sb_stats_init(void)
+{
+	const char *path = getenv(ENV_SANDBOX_STATSBUF);
+
+	if (path && strlen(path) < sizeof(sb_stats_path))
+		strcpy(sb_stats_path, path);
+}
+
+/* Our callers must not hold sb_lock(). */
+static struct sb_stats *stats_map(void)
+{
+	if (stats_mapped)
+		return stats;
+
+	sb_lock();
+	if (stats_mapped)
+		goto done;
+
+	stats = sb_map_shared_file(sb_stats_path, sizeof(*stats), PROT_READ|PROT_WRITE,
+	                           SB_STATS_MAGIC, SB_STATS_VERSION);
+
+ done:
+	__sync_synchronize();
+	stats_mapped = true;
+	sb_unlock();
+	return stats;
+}
+
+static struct sb_stats_slot *stats_slot_get(void)
+{
+	struct sb_stats *st;
+	uint32_t idx;
+	pid_t pid;
+
+	st = stats_map();
+	if (!st)
+		return NULL;
+
+	/* We share memory (and so the slot) with our parent until we exec. */
+	if (sb_in_vfork_child())
+		return __atomic_load_n(&stats_slot, __ATOMIC_ACQUIRE);
+
+	/* Forked children get a slot of their own. */
+	pid = getpid();
+	if (__atomic_load_n(&stats_pid, __ATOMIC_ACQUIRE) == pid)
+		return stats_slot;
+
+	sb_lock();
+	if (stats_pid != pid) {
+		idx = __atomic_fetch_add(&st->slots_used, 1, __ATOMIC_RELAXED);
+		if (idx >= SB_STATS_SLOTS)
+			idx = SB_STATS_SLOTS - 1;
+		__atomic_store_n(&st->slots[idx].pid, pid, __ATOMIC_RELAXED);
+		stats_slot = &st->slots[idx];
+		__atomic_store_n(&stats_pid, pid, __ATOMIC_RELEASE);
+	}
+	sb_unlock();
+
+	return stats_slot;
+}
+
+#define stats_inc(field) __atomic_fetch_add(&(field), 1, __ATOMIC_RELAXED)
+
+/* Claim the unused entry |f| for |func|.  Threads, and once the slots run out
+ * whole processes, race on this, so only the one that wins gets to write the
+ * name, and nobody looks at it before it's done.
+ */
+static bool stats_func_claim(struct sb_stats_func *f, const char *func)
+{
+	uint32_t state = SB_STATS_FUNC_FREE;
+
+	if (!__atomic_compare_exchange_n(&f->state, &state, SB_STATS_FUNC_NAMING,
+	                                 false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		return false;
+	snprintf(f->name, sizeof(f->name), "%s", func);
+	__atomic_store_n(&f->state, SB_STATS_FUNC_NAMED, __ATOMIC_RELEASE);
+	return true;
+}
+
+/* Find the counters for |func| in the slot.  We start looking where |sb_nr|
+ * normally goes (the pseudo funcs, then the wrapped funcs, then the ones only
+ * the tracer checks), but some funcs share an SB_NR (e.g. open_rd & fopen_rd),
+ * so the name is what counts.  Entry 0 is for whatever doesn't fit.
+ */
+static struct sb_stats_func *stats_func_get(struct sb_stats_slot *slot, int sb_nr, const char *func)
+{
+	struct sb_stats_func *f;
+	uint32_t state;
+	size_t i, idx;
+
+	if (sb_nr < SB_NR_UNDEF)
+		sb_nr = SB_NR_UNDEF - sb_nr;
+
+	if (sb_nr <= SB_NR_ACCESS_RD && sb_nr >= SB_NR_OPEN_WR)
+		idx = -sb_nr;
+	else if (sb_nr > 0 && sb_nr <= SB_NR_MAX)
+		idx = -SB_NR_OPEN_WR + sb_nr;
+	else if (sb_nr >= SB_NR_CHDIR)
+		idx = -SB_NR_OPEN_WR + SB_NR_MAX + 1 + sb_nr - SB_NR_CHDIR;
+	else
+		idx = 1;
+
+	for (i = 0; i < SB_STATS_FUNCS - 1; ++i) {
+		f = &slot->funcs[1 + (idx - 1 + i) % (SB_STATS_FUNCS - 1)];
+		state = __atomic_load_n(&f->state, __ATOMIC_ACQUIRE);
+		if (likely(state == SB_STATS_FUNC_NAMED) &&
+		    !strncmp(f->name, func, sizeof(f->name) - 1))
+			return f;
+		/* If someone beat us to it (maybe for the same func), keep
+		 * looking: the sandbox program merges the funcs by name.
+		 */
+		if (state == SB_STATS_FUNC_FREE && stats_func_claim(f, func))
+			return f;
+	}
+
+	f = &slot->funcs[0];
+	if (unlikely(__atomic_load_n(&f->state, __ATOMIC_RELAXED) == SB_STATS_FUNC_FREE))
+		stats_func_claim(f, "(other)");
+	return f;
+}
+
+uint64_t sb_stats_start(void)
+{
+	struct timespec ts;
+
+	if (likely(!sb_stats_path[0]))
+		return 0;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void sb_stats_check(int sb_nr, const char *func, int result, uint64_t start)
+{
+	struct sb_stats_slot *slot;
+	struct sb_stats_func *f;
+	struct timespec ts;
+	uint64_t ns;
+	int bucket;
+
+	if (likely(!start))
+		return;
+
+	slot = stats_slot_get();
+	if (!slot)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	ns = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec - start;
+	if (ns >> SB_STATS_BUCKET_MIN_SHIFT) {
+		bucket = 63 - __builtin_clzll(ns) - SB_STATS_BUCKET_MIN_SHIFT + 1;
+		if (bucket >= SB_STATS_BUCKETS)
+			bucket = SB_STATS_BUCKETS - 1;
+	} else
+		bucket = 0;
+
+	f = stats_func_get(slot, sb_nr, func);
+	stats_inc(f->calls);
+	switch (result) {
+	case SB_STATS_ALLOWED:   stats_inc(f->allowed);   break;
+	case SB_STATS_DENIED:    stats_inc(f->denied);    break;
+	case SB_STATS_PREDICTED: stats_inc(f->predicted); break;
+	}
+	__atomic_fetch_add(&f->ns, ns, __ATOMIC_RELAXED);
+	stats_inc(f->latency[bucket]);
+}
+
+void sb_stats_exec(int sb_nr, const char *func, int result, bool cached)
+{
+	struct sb_stats_slot *slot;
+
+	if (likely(!sb_stats_path[0]))
+		return;
+
+	slot = stats_slot_get();
+	if (!slot)
+		return;
+
+	if (cached)
+		stats_inc(stats_func_get(slot, sb_nr, func)->cache_hits);
+	else
+		stats_inc(slot->exec_classify);
+
+	switch (result) {
+	case SB_STATS_EXEC_PRELOAD:   stats_inc(slot->exec_preload);   break;
+	case SB_STATS_EXEC_TRACE:     stats_inc(slot->exec_trace);     break;
+	case SB_STATS_EXEC_UNCHECKED: stats_inc(slot->exec_unchecked); break;
+	case SB_STATS_EXEC_OTHER:     stats_inc(slot->exec_other);     break;
+	}
+}
+
+/* Count time spent outside of the checks; see SB_STATS_TIME_*. */
+void sb_stats_time(int what, uint64_t start)
+{
+	struct sb_stats_slot *slot;
+	struct timespec ts;
+	uint64_t ns;
+
+	if (likely(!start) || !sb_stats_path[0])
+		return;
+
+	slot = stats_slot_get();
+	if (!slot)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	ns = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec - start;
+	switch (what) {
+	case SB_STATS_TIME_INIT:
+		stats_inc(slot->inits);
+		__atomic_fetch_add(&slot->init_ns, ns, __ATOMIC_RELAXED);
+		break;
+	case SB_STATS_TIME_EXEC:
+		stats_inc(slot->exec_wrapped);
+		__atomic_fetch_add(&slot->exec_wrapper_ns, ns, __ATOMIC_RELAXED);
+		break;
+	case SB_STATS_TIME_CLASSIFY:
+		__atomic_fetch_add(&slot->classify_ns, ns, __ATOMIC_RELAXED);
+		break;
+	}
+}
+
+void sb_stats_trace_stop(void)
+{
+	struct sb_stats_slot *slot;
+
+	if (likely(!sb_stats_path[0]))
+		return;
+
+	slot = stats_slot_get();
+	if (slot)
+		stats_inc(slot->trace_stops);
+}
@@ -0,0 +1,157 @@
+/* timeline.c - record how long the parts of each check take for SANDBOX_TIMELINE
+ *
+ * When the sandbox program was started with SANDBOX_TIMELINE, it passes down
+ * the path of a timeline buffer (see sb_timeline.h) that we map & append spans
+ * to: the whole check, resolving its paths, logging, inspecting programs we're
+ * about to exec, and how long tracers wait for their tracees.  Each process
+ * appends to chunks of its own, and nothing here takes a lock, as some of the
+ * spans are recorded while holding sb_lock() and some aren't.  Like the trace
+ * buffer, none of this is critical: if anything goes wrong, the span is lost.
+ *
+ * Copyright 2026 Gentoo Foundation
+ * Licensed under the GPL-2
+ */
+
+#include "headers.h"
+#include "sbutil.h"
+#include "libsandbox.h"
+#include "wrappers.h"
+#include "sb_timeline.h"
+
+char sb_timeline_path[SB_PATH_MAX];
+static struct sb_timeline *timeline;
+static bool timeline_mapped;
+
+/* The chunk the process that last recorded a span is appending to. */
+static struct sb_timeline_chunk *timeline_chunk;
+static pid_t timeline_pid;
+
+/* gettid() is a syscall, so remember it (and whose thread it was). */
+static __thread pid_t timeline_tid_pid attribute_tls_ie;
+static __thread pid_t timeline_tid attribute_tls_ie;
+
+void sb_timeline_init(void)
+{
+	const char *path = getenv(ENV_SANDBOX_TIMELINEBUF);
+
+	if (path && strlen(path) < sizeof(sb_timeline_path))
+		strcpy(sb_timeline_path, path);
+}
+
+static struct sb_timeline *timeline_map(void)
+{
+	struct sb_timeline *expected = NULL, *map;
+
+	if (__atomic_load_n(&timeline_mapped, __ATOMIC_ACQUIRE))
+		return timeline;
+
+	map = sb_map_shared_file(sb_timeline_path, sizeof(*map), PROT_READ|PROT_WRITE,
+	                         SB_TIMELINE_MAGIC, SB_TIMELINE_VERSION);
+	/* Threads might race us here; only one mapping wins. */
+	if (map && !__atomic_compare_exchange_n(&timeline, &expected, map, false,
+	                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+		munmap(map, sizeof(*map));
+
+	__atomic_store_n(&timeline_mapped, true, __ATOMIC_RELEASE);
+	return __atomic_load_n(&timeline, __ATOMIC_ACQUIRE);
+}
+
+/* Hand out the next span in this process's chunk, grabbing a new one as the
+ * old one fills up.  vfork children share their parent's memory (and it's
+ * suspended meanwhile), so they append to its chunk as long as there's room.
+ */
+static struct sb_timeline_span *timeline_span_get(struct sb_timeline *tl, pid_t pid, bool vforked)
+{
+	struct sb_timeline_chunk *chunk, *next;
+	uint32_t idx;
+
+	if (vforked) {
+		chunk = __atomic_load_n(&timeline_chunk, __ATOMIC_ACQUIRE);
+		if (chunk) {
+			idx = __atomic_fetch_add(&chunk->used, 1, __ATOMIC_RELAXED);
+			if (idx < SB_TIMELINE_CHUNK_SPANS)
+				return &chunk->spans[idx];
+		}
+		/* Taking a chunk of our own would take it from our parent. */
+		__atomic_fetch_add(&tl->dropped, 1, __ATOMIC_RELAXED);
+		return NULL;
+	}
+
+	while (1) {
+		chunk = __atomic_load_n(&timeline_chunk, __ATOMIC_ACQUIRE);
+		if (chunk && __atomic_load_n(&timeline_pid, __ATOMIC_ACQUIRE) == pid) {
+			idx = __atomic_fetch_add(&chunk->used, 1, __ATOMIC_RELAXED);
+			if (idx < SB_TIMELINE_CHUNK_SPANS)
+				return &chunk->spans[idx];
+		}
+
+		idx = __atomic_fetch_add(&tl->chunks_used, 1, __ATOMIC_RELAXED);
+		if (idx >= SB_TIMELINE_CHUNKS) {
+			__atomic_fetch_add(&tl->dropped, 1, __ATOMIC_RELAXED);
+			return NULL;
+		}
+		next = &tl->chunks[idx];
+		next->pid = pid;
+		snprintf(next->comm, sizeof(next->comm), "%s", program_invocation_short_name);
+
+		/* If another thread beat us to it, our chunk goes to waste, but
+		 * that's rare enough to not worry about.
+		 */
+		if (__atomic_compare_exchange_n(&timeline_chunk, &chunk, next, false,
+		                                __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+			__atomic_store_n(&timeline_pid, pid, __ATOMIC_RELEASE);
+	}
+}
+
+uint64_t sb_timeline_start(void)
+{
+	struct timespec ts;
+
+	if (likely(!sb_timeline_path[0]))
+		return 0;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void sb_timeline_span(int kind, const char *name, uint64_t start)
+{
+	struct sb_timeline *tl;
+	struct sb_timeline_span *span;
+	struct timespec ts;
+	uint64_t dur;
+	pid_t pid, tid;
+	bool vforked;
+
+	if (likely(!start))
+		return;
+
+	tl = timeline_map();
+	if (!tl)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	dur = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec - start;
+
+	pid = getpid();
+	vforked = sb_in_vfork_child();
+	span = timeline_span_get(tl, pid, vforked);
+	if (!span)
+		return;
+
+	/* The TLS is our parent's too when vforked, so leave it be. */
+	if (vforked)
+		tid = syscall(SYS_gettid);
+	else {
+		if (timeline_tid_pid != pid) {
+			timeline_tid = syscall(SYS_gettid);
+			timeline_tid_pid = pid;
+		}
+		tid = timeline_tid;
+	}
+	span->dur = dur > UINT32_MAX ? UINT32_MAX : dur;
+	span->tid = tid;
+	span->kind = kind;
+	snprintf(span->name, sizeof(span->name), "%s", name);
+	/* The span only counts once it has a start. */
+	__atomic_store_n(&span->start, start, __ATOMIC_RELEASE);
+}
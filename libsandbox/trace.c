@@ -9,6 +9,10 @@
 #include "wrappers.h"
 #include "sb_nr.h"
 
+#ifdef HAVE_LINUX_KCMP_H
+# include <linux/kcmp.h>
+#endif
+
 static long do_peekdata(long offset);
 /* Note on _do_ptrace argument types:
    glibc defines ptrace as:
@@ -36,6 +40,104 @@ static long _do_ptrace(sb_ptrace_req_t request, const char *srequest, void *addr
 
 pid_t trace_pid;
 
+/* The tracer's view of the tracee's cwd & fds.
+ *
+ * Checks running in the tracer have to resolve relative paths & dirfds via
+ * /proc/<pid>/{cwd,fd/N}.  Rather than do that for every syscall, we remember
+ * what we last read, and drop entries when the tracee changes them (see
+ * trace_state_update()).  A NULL path means we do not know it, so the next
+ * lookup goes back to /proc.
+ *
+ * Anyone can rename the dirs out from under those paths though, so we also
+ * note what each one pointed to, and only use it while it still does.
+ *
+ * Once the tracee starts sharing its cwd or fd table with another process
+ * (e.g. threads), we can no longer see all the changes, so stop caching.
+ */
+struct trace_state_entry {
+	char *path;
+	dev_t dev;
+	ino_t ino;
+};
+static bool trace_state_shared;
+static struct trace_state_entry trace_cwd;
+static struct trace_state_entry *trace_fds;
+static size_t trace_fds_len;
+
+/* Don't let a bogus fd make us allocate the world. */
+#define TRACE_FDS_MAX 0x10000
+
+static struct trace_state_entry *trace_state_fd(int fd, bool alloc)
+{
+	if (fd < 0 || fd >= TRACE_FDS_MAX)
+		return NULL;
+
+	if ((size_t)fd >= trace_fds_len) {
+		if (!alloc)
+			return NULL;
+		size_t len = trace_fds_len ? : 64;
+		while (len <= (size_t)fd)
+			len *= 2;
+		trace_fds = xrealloc(trace_fds, len * sizeof(*trace_fds));
+		memset(trace_fds + trace_fds_len, 0, (len - trace_fds_len) * sizeof(*trace_fds));
+		trace_fds_len = len;
+	}
+
+	return &trace_fds[fd];
+}
+
+static void trace_state_drop(struct trace_state_entry *entry)
+{
+	if (entry) {
+		free(entry->path);
+		entry->path = NULL;
+	}
+}
+
+/* Same semantics as readlink(), but serve from |cache| when possible. */
+static ssize_t trace_readlink(struct trace_state_entry *cache, const char *link, char *buf, size_t bufsiz)
+{
+	struct stat64 st;
+	ssize_t ret;
+
+	if (cache && cache->path) {
+		if (stat64(cache->path, &st) == 0 &&
+		    st.st_dev == cache->dev && st.st_ino == cache->ino) {
+			size_t len = strlen(cache->path);
+			if (len > bufsiz)
+				len = bufsiz;
+			memcpy(buf, cache->path, len);
+			return len;
+		}
+		trace_state_drop(cache);
+	}
+
+	ret = readlink(link, buf, bufsiz);
+	/* Only remember complete results. */
+	if (cache && ret != -1 && (size_t)ret < bufsiz && !trace_state_shared &&
+	    stat64(link, &st) == 0) {
+		cache->path = xstrndup(buf, ret);
+		cache->dev = st.st_dev;
+		cache->ino = st.st_ino;
+	}
+
+	return ret;
+}
+
+ssize_t trace_readlink_cwd(char *buf, size_t bufsiz)
+{
+	char proc[sizeof("/proc//cwd") + 11];
+	sprintf(proc, "/proc/%i/cwd", trace_pid);
+	return trace_readlink(&trace_cwd, proc, buf, bufsiz);
+}
+
+ssize_t trace_readlink_fd(int fd, char *buf, size_t bufsiz)
+{
+	char proc[sizeof("/proc//fd/") + 22];
+	sprintf(proc, "/proc/%i/fd/%i", trace_pid, fd);
+	return trace_readlink(trace_state_fd(fd, !trace_state_shared), proc, buf, bufsiz);
+}
+
 #ifndef SB_NO_TRACE
 
 #ifndef HAVE_TRACE_REGS
@@ -232,50 +334,28 @@ static const char *strsig(int sig)
 	}
 }
 
-static const struct syscall_entry *lookup_syscall_in_tbl(const struct syscall_entry *tbl, int nr)
+static const struct syscall_entry *lookup_syscall_in_tbl(const struct syscall_table *tbl, int nr)
 {
-	while (tbl->name)
-		if (tbl->nr == nr)
-			return tbl;
-		else
-			++tbl;
+	/* Unsigned so numbers below the base wrap around & fail too. */
+	size_t idx = (size_t)nr - tbl->base;
+	if (idx < tbl->count && tbl->entries[idx].name)
+		return &tbl->entries[idx];
 	return NULL;
 }
 
 struct syscall_state {
-	void *regs;
+	struct trace_stop *stop;
 	int nr;
 	const char *func;
 	bool (*pre_check)(const char *func, const char *pathname, int dirfd);
 };
 
-/* Check syscall that only takes a path as its |ibase| argument. */
-static bool _trace_check_syscall_C(struct syscall_state *state, int ibase)
-{
-	char *path = do_peekstr(trace_arg(state->regs, ibase));
-	__sb_debug("(\"%s\")", path);
-	bool pre_ret, ret;
-	if (state->pre_check)
-		pre_ret = state->pre_check(state->func, path, AT_FDCWD);
-	else
-		pre_ret = true;
-	if (pre_ret)
-		ret = _SB_SAFE(state->nr, state->func, path);
-	else
-		ret = true;
-	free(path);
-	return ret;
-}
-/* Check syscall that only takes a path as its first argument. */
-static bool trace_check_syscall_C(struct syscall_state *state)
-{
-	return _trace_check_syscall_C(state, 1);
-}
-
-static bool __trace_check_syscall_DCF(struct syscall_state *state, int ibase, int flags)
+/* Check one path of a syscall as described by its |tp| layout. */
+static bool trace_check_path(struct syscall_state *state, const struct sb_trace_path *tp)
 {
-	int dirfd = trace_arg(state->regs, ibase);
-	char *path = do_peekstr(trace_arg(state->regs, ibase + 1));
+	int dirfd = tp->dirfd ? (int)trace_stop_arg(state->stop, tp->dirfd) : AT_FDCWD;
+	char *path = do_peekstr(trace_stop_arg(state->stop, tp->path));
+	int flags = tp->flags ? (int)trace_stop_arg(state->stop, tp->flags) : 0;
 	__sb_debug("(%i, \"%s\", %x)", dirfd, path, flags);
 	bool pre_ret, ret;
 	if (state->pre_check)
@@ -289,32 +369,11 @@ static bool __trace_check_syscall_DCF(struct syscall_state *state, int ibase, in
 	free(path);
 	return ret;
 }
-/* Check syscall that takes a dirfd & path starting at |ibase| argument, and flags at |fbase|. */
-static bool _trace_check_syscall_DCF(struct syscall_state *state, int ibase, int fbase)
-{
-	int flags = trace_arg(state->regs, fbase);
-	return __trace_check_syscall_DCF(state, ibase, flags);
-}
-/* Check syscall that takes a dirfd, path, and flags as its first 3 arguments. */
-static bool trace_check_syscall_DCF(struct syscall_state *state)
-{
-	return _trace_check_syscall_DCF(state, 1, 3);
-}
-
-/* Check syscall that takes a dirfd & path starting at |ibase| argument. */
-static bool _trace_check_syscall_DC(struct syscall_state *state, int ibase)
-{
-	return __trace_check_syscall_DCF(state, ibase, 0);
-}
-/* Check syscall that takes a dirfd & path as its first 2 arguments (but no flags). */
-static bool trace_check_syscall_DC(struct syscall_state *state)
-{
-	return _trace_check_syscall_DC(state, 1);
-}
 
-static bool trace_check_syscall(const struct syscall_entry *se, void *regs)
+static bool trace_check_syscall(const struct syscall_entry *se, struct trace_stop *stop)
 {
 	struct syscall_state state;
+	const struct sb_nr_attrs *attrs;
 	bool ret = true;
 	int nr;
 	const char *name;
@@ -327,82 +386,56 @@ static bool trace_check_syscall(const struct syscall_entry *se, void *regs)
 	 *  - _*x*mknod*
 	 *  - 64bit versions of most funcs
 	 *  - system / popen / most exec funcs
-	 *
-	 * Can't use switch() statement here as we auto define missing
-	 * SYS_xxx to SB_NR_UNDEF in the build system
 	 */
 	if (!se)
 		goto done;
 
-	state.regs = regs;
+	state.stop = stop;
 	state.nr = nr = se->sys;
 	state.func = name = se->name;
-	if (!SB_NR_IS_DEFINED(se->nr))  goto done;
-	else if (nr == SB_NR_MKDIR)     state.pre_check = sb_mkdirat_pre_check;
+	if (nr == SB_NR_MKDIR)          state.pre_check = sb_mkdirat_pre_check;
 	else if (nr == SB_NR_MKDIRAT)   state.pre_check = sb_mkdirat_pre_check;
 	else if (nr == SB_NR_UNLINK)    state.pre_check = sb_unlinkat_pre_check;
 	else if (nr == SB_NR_UNLINKAT)  state.pre_check = sb_unlinkat_pre_check;
 	else                            state.pre_check = NULL;
 
-	/* Hmm, add these functions to the syscall table and avoid this if() ? */
-	     if (nr == SB_NR_CHMOD)     return  trace_check_syscall_C  (&state);
-	else if (nr == SB_NR_CHOWN)     return  trace_check_syscall_C  (&state);
-	else if (nr == SB_NR_CREAT)     return  trace_check_syscall_C  (&state);
-	/* NB: Linux syscall does not have a flags argument. */
-	else if (nr == SB_NR_FCHMODAT)  return  trace_check_syscall_DC (&state);
-	else if (nr == SB_NR_FCHOWNAT)  return _trace_check_syscall_DCF(&state, 1, 5);
-	else if (nr == SB_NR_FUTIMESAT) return  trace_check_syscall_DC (&state);
-	else if (nr == SB_NR_LCHOWN)    return  trace_check_syscall_C  (&state);
-	else if (nr == SB_NR_LINK)      return _trace_check_syscall_C  (&state, 2);
-	else if (nr == SB_NR_LINKAT)    return _trace_check_syscall_DCF(&state, 3, 5);
-	else if (nr == SB_NR_MKDIR)     return  trace_check_syscall_C  (&state);
-	else if (nr == SB_NR_MKDIRAT)   return  trace_check_syscall_DC (&state);
-	else if (nr == SB_NR_MKNOD)     return  trace_check_syscall_C  (&state);
-	else if (nr == SB_NR_MKNODAT)   return  trace_check_syscall_DC (&state);
-	else if (nr == SB_NR_RENAME)    return  trace_check_syscall_C  (&state) &&
-	                                       _trace_check_syscall_C  (&state, 2);
-	else if (nr == SB_NR_RENAMEAT2) return  trace_check_syscall_DC (&state) &&
-	                                       _trace_check_syscall_DC (&state, 3);
-	else if (nr == SB_NR_RENAMEAT)  return  trace_check_syscall_DC (&state) &&
-	                                       _trace_check_syscall_DC (&state, 3);
-	else if (nr == SB_NR_RMDIR)     return  trace_check_syscall_C  (&state);
-	else if (nr == SB_NR_SYMLINK)   return _trace_check_syscall_C  (&state, 2);
-	else if (nr == SB_NR_SYMLINKAT) return _trace_check_syscall_DC (&state, 2);
-	else if (nr == SB_NR_TRUNCATE)  return  trace_check_syscall_C  (&state);
-	else if (nr == SB_NR_TRUNCATE64)return  trace_check_syscall_C  (&state);
-	else if (nr == SB_NR_UNLINK)    return  trace_check_syscall_C  (&state);
-	else if (nr == SB_NR_UNLINKAT)  return  trace_check_syscall_DCF(&state);
-	else if (nr == SB_NR_UTIME)     return  trace_check_syscall_C  (&state);
-	else if (nr == SB_NR_UTIMES)    return  trace_check_syscall_C  (&state);
-
-	else if (nr == SB_NR_UTIMENSAT) {
- utimensat:
-		return _trace_check_syscall_DCF(&state, 1, 4);
-	} else if (nr == SB_NR___UTIMENSAT64) {
+	/* The time64 variant takes the same args, & before_syscall() only lets
+	 * NULL paths (i.e. futimens) through for utimensat itself.
+	 */
+	if (nr == SB_NR___UTIMENSAT64)
 		state.nr = SB_NR_UTIMENSAT;
-		goto utimensat;
+
+	/* Most syscalls just need their path args checked as the generated
+	 * attributes describe.  The rest need some extra handling below.
+	 */
+	attrs = sb_nr_attrs_get(nr);
+	if (attrs->trace[0].path) {
+		ret = trace_check_path(&state, &attrs->trace[0]);
+		if (ret && attrs->trace[1].path)
+			ret = trace_check_path(&state, &attrs->trace[1]);
+		return ret;
 	}
 
-	else if (nr == SB_NR_ACCESS) {
-		char *path = do_peekstr(trace_arg(regs, 1));
-		int flags = trace_arg(regs, 2);
+	if (nr == SB_NR_ACCESS) {
+		char *path = do_peekstr(trace_stop_arg(stop, 1));
+		int flags = trace_stop_arg(stop, 2);
 		__sb_debug("(\"%s\", %x)", path, flags);
 		ret = _SB_SAFE_ACCESS(nr, name, path, flags);
 		free(path);
 		return ret;
 
 	} else if (nr == SB_NR_FACCESSAT) {
-		int dirfd = trace_arg(regs, 1);
-		char *path = do_peekstr(trace_arg(regs, 2));
-		int flags = trace_arg(regs, 3);
+		int dirfd = trace_stop_arg(stop, 1);
+		char *path = do_peekstr(trace_stop_arg(stop, 2));
+		int flags = trace_stop_arg(stop, 3);
 		__sb_debug("(%i, \"%s\", %x)", dirfd, path, flags);
 		ret = _SB_SAFE_ACCESS_AT(nr, name, dirfd, path, flags);
 		free(path);
 		return ret;
 
 	} else if (nr == SB_NR_OPEN) {
-		char *path = do_peekstr(trace_arg(regs, 1));
-		int flags = trace_arg(regs, 2);
+		char *path = do_peekstr(trace_stop_arg(stop, 1));
+		int flags = trace_stop_arg(stop, 2);
 		__sb_debug("(\"%s\", %x)", path, flags);
 		if (sb_openat_pre_check(name, path, AT_FDCWD, flags))
 			ret = _SB_SAFE_OPEN_INT(nr, name, path, flags);
@@ -412,9 +445,9 @@ static bool trace_check_syscall(const struct syscall_entry *se, void *regs)
 		return ret;
 
 	} else if (nr == SB_NR_OPENAT) {
-		int dirfd = trace_arg(regs, 1);
-		char *path = do_peekstr(trace_arg(regs, 2));
-		int flags = trace_arg(regs, 3);
+		int dirfd = trace_stop_arg(stop, 1);
+		char *path = do_peekstr(trace_stop_arg(stop, 2));
+		int flags = trace_stop_arg(stop, 3);
 		__sb_debug("(%i, \"%s\", %x)", dirfd, path, flags);
 		if (sb_openat_pre_check(name, path, dirfd, flags))
 			ret = _SB_SAFE_OPEN_INT_AT(nr, name, dirfd, path, flags);
@@ -429,15 +462,15 @@ static bool trace_check_syscall(const struct syscall_entry *se, void *regs)
 		unsigned long environ, i = 0;
 
 		if (nr == SB_NR_EXECVEAT) {
-			int dirfd = do_peekdata(trace_arg(regs, 1));
-			unsigned long argv = trace_arg(regs, 3);
-			environ = trace_arg(regs, 4);
-			path = do_peekstr(trace_arg(regs, 2));
+			int dirfd = do_peekdata(trace_stop_arg(stop, 1));
+			unsigned long argv = trace_stop_arg(stop, 3);
+			environ = trace_stop_arg(stop, 4);
+			path = do_peekstr(trace_stop_arg(stop, 2));
 			__sb_debug("(%i, \"%s\", %lx, %lx{", dirfd, path, argv, environ);
 		} else {
-			path = do_peekstr(trace_arg(regs, 1));
-			unsigned long argv = trace_arg(regs, 2);
-			environ = trace_arg(regs, 3);
+			path = do_peekstr(trace_stop_arg(stop, 1));
+			unsigned long argv = trace_stop_arg(stop, 2);
+			environ = trace_stop_arg(stop, 3);
 			__sb_debug("(\"%s\", %lx, %lx{", path, argv, environ);
 		}
 
@@ -456,15 +489,15 @@ static bool trace_check_syscall(const struct syscall_entry *se, void *regs)
 		__sb_debug("})");
 		return 1;
 	} else if (nr == SB_NR_FCHMOD) {
-		int fd = trace_arg(regs, 1);
-		mode_t mode = trace_arg(regs, 2);
+		int fd = trace_stop_arg(stop, 1);
+		mode_t mode = trace_stop_arg(stop, 2);
 		__sb_debug("(%i, %o)", fd, mode);
 		return _SB_SAFE_FD(nr, name, fd);
 
 	} else if (nr == SB_NR_FCHOWN) {
-		int fd = trace_arg(regs, 1);
-		uid_t uid = trace_arg(regs, 2);
-		gid_t gid = trace_arg(regs, 3);
+		int fd = trace_stop_arg(stop, 1);
+		uid_t uid = trace_stop_arg(stop, 2);
+		gid_t gid = trace_stop_arg(stop, 3);
 		__sb_debug("(%i, %i, %i)", fd, uid, gid);
 		return _SB_SAFE_FD(nr, name, fd);
 	}
@@ -475,6 +508,108 @@ static bool trace_check_syscall(const struct syscall_entry *se, void *regs)
 	return ret;
 }
 
+/* Whether |pid| shares the tracee's cwd or fd table.  The kernel reports
+ * clone() children as forks unless they use a signal other than SIGCHLD, so
+ * the event doesn't tell us.  If we can't compare, assume it does.
+ */
+static bool trace_state_shares(pid_t pid)
+{
+#if defined(HAVE_LINUX_KCMP_H) && defined(SYS_kcmp)
+	/* 0 means they're the same one, & -1 that we couldn't tell. */
+	return syscall(SYS_kcmp, trace_pid, pid, KCMP_FS, 0, 0) <= 0 ||
+	       syscall(SYS_kcmp, trace_pid, pid, KCMP_FILES, 0, 0) <= 0;
+#else
+	return true;
+#endif
+}
+
+static void trace_state_drop_fds(void)
+{
+	size_t fd;
+	for (fd = 0; fd < trace_fds_len; ++fd)
+		trace_state_drop(&trace_fds[fd]);
+}
+
+/* The arguments of a syscall that trace_state_update() needs to follow. */
+struct trace_state_call {
+	int sys;
+	unsigned long args[2];
+};
+
+static bool trace_state_follows(const struct syscall_entry *se)
+{
+	if (!se || trace_state_shared)
+		return false;
+
+	int sys = se->sys;
+	return sys == SB_NR_CHDIR || sys == SB_NR_FCHDIR ||
+	       sys == SB_NR_CLOSE || sys == SB_NR_CLOSE_RANGE ||
+	       sys == SB_NR_DUP || sys == SB_NR_DUP2 || sys == SB_NR_DUP3 ||
+	       sys == SB_NR_FCNTL || sys == SB_NR_FCNTL64;
+}
+
+static void trace_state_dup(int oldfd, int newfd)
+{
+	struct trace_state_entry *old, *new;
+
+	if (oldfd == newfd)
+		return;
+
+	trace_state_drop(trace_state_fd(newfd, false));
+	old = trace_state_fd(oldfd, false);
+	if (old && old->path) {
+		new = trace_state_fd(newfd, true);
+		if (new) {
+			*new = *old;
+			new->path = xstrdup(old->path);
+		}
+	}
+}
+
+/* Called at the exit stop of a syscall accepted by trace_state_follows(). */
+static void trace_state_update(const struct trace_state_call *call, long ret)
+{
+	int sys = call->sys;
+
+	/* The fd is released even if close() returns an error. */
+	if (sys == SB_NR_CLOSE) {
+		trace_state_drop(trace_state_fd(call->args[0], false));
+		return;
+	}
+
+	if (ret == -1)
+		return;
+
+	if (sys == SB_NR_CHDIR) {
+		trace_state_drop(&trace_cwd);
+
+	} else if (sys == SB_NR_FCHDIR) {
+		struct trace_state_entry *fd = trace_state_fd(call->args[0], false);
+		trace_state_drop(&trace_cwd);
+		if (fd && fd->path) {
+			trace_cwd = *fd;
+			trace_cwd.path = xstrdup(fd->path);
+		}
+
+	} else if (sys == SB_NR_CLOSE_RANGE) {
+		/* Whether closed or marked close-on-exec, forget them. */
+		size_t fd = call->args[0], last = call->args[1];
+		for (; fd <= last && fd < trace_fds_len; ++fd)
+			trace_state_drop(&trace_fds[fd]);
+
+	} else if (sys == SB_NR_DUP) {
+		trace_state_dup(call->args[0], ret);
+
+	} else if (sys == SB_NR_DUP2 || sys == SB_NR_DUP3) {
+		trace_state_dup(call->args[0], call->args[1]);
+
+	} else if (sys == SB_NR_FCNTL || sys == SB_NR_FCNTL64) {
+		int cmd = call->args[1];
+		if (cmd == F_DUPFD || cmd == F_DUPFD_CLOEXEC)
+			trace_state_dup(call->args[0], ret);
+	}
+}
+
 static void trace_init_tracee(void)
 {
 	do_ptrace(PTRACE_SETOPTIONS, NULL, (void *)(uintptr_t)(
@@ -490,13 +625,15 @@ static void trace_init_tracee(void)
 
 static void trace_loop(void)
 {
-	trace_regs regs;
+	struct trace_stop stop;
+	struct trace_state_call state_call = { .sys = 0, };
 	bool before_exec, before_syscall, fake_syscall_ret;
 	unsigned event;
 	long ret;
 	int status, sig;
-	const struct syscall_entry *tbl_after_fork;
+	const struct syscall_table *tbl_after_fork;
 	void *data;
+	uint64_t span_start;
 
 	before_exec = true;
 	before_syscall = false;
@@ -506,7 +643,11 @@ static void trace_loop(void)
 	do {
 		ret = do_ptrace(PTRACE_SYSCALL, NULL, data);
 		data = NULL;
+		span_start = sb_timeline_start();
 		waitpid(trace_pid, &status, 0);
+		sb_timeline_span(SB_SPAN_TRACE_WAIT, "waitpid", span_start);
+		SB_PROBE(trace__stop, trace_pid, status);
+		sb_stats_trace_stop();
 
 		event = (unsigned)status >> 16;
 
@@ -551,8 +692,11 @@ static void trace_loop(void)
 		case PTRACE_EVENT_EXEC:
 			__sb_debug("hit exec!");
 			before_exec = false;
-			ret = trace_get_regs(&regs);
-			tbl_after_fork = trace_check_personality(&regs);
+			/* We don't track close-on-exec, so forget all the fds. */
+			trace_state_drop_fds();
+			sb_log_cmdline_reset();
+			trace_stop_get_regs(&stop);
+			tbl_after_fork = trace_check_personality(&stop.regs);
 			continue;
 
 		case PTRACE_EVENT_EXIT:
@@ -570,6 +714,16 @@ static void trace_loop(void)
 			do_ptrace(PTRACE_GETEVENTMSG, NULL, &newpid);
 			sb_debug("following forking event %i; pid=%li %i\n",
 			         event, newpid, before_syscall);
+			SB_PROBE(trace__fork, trace_pid, newpid, event);
+
+			/* Threads (and the like) might share the cwd & fd table, so
+			 * neither tracer would see all the changes to them.
+			 */
+			if (trace_state_shares(newpid)) {
+				trace_state_shared = true;
+				trace_state_drop(&trace_cwd);
+				trace_state_drop_fds();
+			}
 
 			/* If YAMA ptrace_scope is active, then we can't hand off the child
 			 * to a new tracer.  Give up.  #821403
@@ -599,6 +753,7 @@ static void trace_loop(void)
 						goto retry_attach;
 					sb_ebort("ISE:PTRACE_ATTACH %s", strerror(errno));
 				}
+				SB_PROBE(trace__attach, newpid);
 				trace_init_tracee();
 				before_syscall = true;
 				continue;
@@ -627,29 +782,46 @@ static void trace_loop(void)
 			         strsig(sig), sig, event);
 		}
 
-		ret = trace_get_regs(&regs);
-
 		if (before_syscall) {
 			/* NB: The kernel guarantees syscall NR is valid only on entry. */
-			int nr = trace_get_sysnum(&regs);
+			trace_stop_get(&stop, true);
+			int nr = trace_stop_sysnum(&stop);
 			const struct syscall_entry *se = lookup_syscall_in_tbl(tbl_after_fork, nr);
 
 			_sb_debug("%s:%i", se ? se->name : "IDK", nr);
-			if (!trace_check_syscall(se, &regs)) {
+			if (!trace_check_syscall(se, &stop)) {
 				sb_debug_dyn("trace_loop: forcing EPERM after %s\n", se->name);
-				trace_set_sysnum(&regs, -1);
+				trace_stop_set_sysnum(&stop, -1);
 				fake_syscall_ret = true;
+			} else if (trace_state_follows(se)) {
+				state_call.sys = se->sys;
+				state_call.args[0] = trace_stop_arg(&stop, 1);
+				state_call.args[1] = trace_stop_arg(&stop, 2);
 			}
 		} else {
 			int err;
 
+			/* When we let the syscall through, the result is only needed
+			 * for debugging & following state changes, so skip fetching
+			 * it otherwise.
+			 */
 			if (unlikely(fake_syscall_ret)) {
 				ret = -1;
 				err = EPERM;
-				trace_set_ret(&regs, err);
+				trace_stop_get(&stop, false);
+				trace_stop_set_ret(&stop, err);
 				fake_syscall_ret = false;
-			} else
-				ret = trace_result(&regs, &err);
+			} else if (SBDEBUG || state_call.sys) {
+				trace_stop_get(&stop, false);
+				ret = trace_stop_result(&stop, &err);
+				if (state_call.sys) {
+					trace_state_update(&state_call, ret);
+					state_call.sys = 0;
+				}
+			} else {
+				ret = 0;
+				err = 0;
+			}
 
 			__sb_debug(" = %li", ret);
 			if (err)
@@ -674,6 +846,7 @@ void trace_main(void)
 		sb_ebort("ISE: vfork() failed: %s\n", strerror(errno));
 	} else if (trace_pid) {
 		sb_debug("parent waiting for child (pid=%i) to signal", trace_pid);
+		SB_PROBE(trace__start, trace_pid);
 		waitpid(trace_pid, NULL, 0);
 		trace_init_tracee();
 		sb_close_all_fds();
@@ -682,6 +855,7 @@ void trace_main(void)
 	}
 
 	sb_debug("child setting up ...");
+	sb_self_pid = getpid();
 	sigaction(SIGCHLD, &old_sa, NULL);
 	do_ptrace(PTRACE_TRACEME, NULL, NULL);
 	kill(getpid(), SIGSTOP);
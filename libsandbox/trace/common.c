@@ -3,16 +3,24 @@ struct syscall_entry {
 	const char *name;
 };
 
+/* The entries are indexed directly by (syscall number - base). */
+struct syscall_table {
+	const struct syscall_entry *entries;
+	int base;
+	size_t count;
+};
+#define SYSCALL_TABLE(entries, base) { entries, base, ARRAY_SIZE(entries) }
+
 static int trace_get_sysnum(void *vregs);
 static long trace_raw_ret(void *vregs);
 static unsigned long trace_arg(void *vregs, int num);
 
 #ifndef SB_SCHIZO
-static const struct syscall_entry syscall_table[] = {
-#define S(s) { SB_SYS_##s, SB_NR_##s, #s },
+static const struct syscall_entry syscall_entries[] = {
+#define S(s) [SB_SYS_##s - SB_SYS_BASE] = { SB_SYS_##s, SB_NR_##s, #s },
 #include "trace_syscalls.h"
 #undef S
-	{ SB_NR_UNDEF, SB_NR_UNDEF, NULL },
 };
-# define trace_check_personality(regs) syscall_table
+static const struct syscall_table syscall_table = SYSCALL_TABLE(syscall_entries, SB_SYS_BASE);
+# define trace_check_personality(regs) (&syscall_table)
 #endif
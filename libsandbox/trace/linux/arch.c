@@ -68,4 +68,6 @@ static void trace_set_ret(void *vregs, int err)
 }
 # endif
 
+# include "syscall_stop.c"
+
 #endif
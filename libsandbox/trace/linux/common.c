@@ -5,6 +5,11 @@
 #define trace_get_regs(regs) do_ptrace(PTRACE_GETREGS, NULL, regs)
 #define trace_set_regs(regs) do_ptrace(PTRACE_SETREGS, NULL, regs)
 
+/* Added in linux-6.16; older C library headers might not know about it yet. */
+#ifndef PTRACE_SET_SYSCALL_INFO
+# define PTRACE_SET_SYSCALL_INFO 0x4212
+#endif
+
 static int trace_errno(long err)
 {
 	return (err < 0 && err > -4096) ? err * -1 : 0;
@@ -9,13 +9,13 @@ static bool _trace_possible(const void *data)
 }
 
 #ifdef SB_SCHIZO
-static const struct syscall_entry syscall_table[] = {
-#define S(s) { SB_SYS_x86_##s, SB_NR_##s, #s },
+static const struct syscall_entry syscall_entries[] = {
+#define S(s) [SB_SYS_x86_##s - SB_SYS_x86_BASE] = { SB_SYS_x86_##s, SB_NR_##s, #s },
 #include "trace_syscalls_x86.h"
 #undef S
-	{ SB_NR_UNDEF, SB_NR_UNDEF, NULL },
 };
-# define trace_check_personality(regs) syscall_table
+static const struct syscall_table syscall_table = SYSCALL_TABLE(syscall_entries, SB_SYS_x86_BASE);
+# define trace_check_personality(regs) (&syscall_table)
 #endif
 
 #define trace_reg_sysnum orig_eax
@@ -3,32 +3,36 @@
 
 #ifdef SB_SCHIZO
 
-static const struct syscall_entry syscall_table_32[] = {
 #ifdef SB_SCHIZO_s390
-#define S(s) { SB_SYS_s390_##s, SB_NR_##s, #s },
+static const struct syscall_entry syscall_entries_32[] = {
+#define S(s) [SB_SYS_s390_##s - SB_SYS_s390_BASE] = { SB_SYS_s390_##s, SB_NR_##s, #s },
 #include "trace_syscalls_s390.h"
 #undef S
-#endif
-	{ SB_NR_UNDEF, SB_NR_UNDEF, NULL },
 };
-static const struct syscall_entry syscall_table_64[] = {
+static const struct syscall_table syscall_table_32 = SYSCALL_TABLE(syscall_entries_32, SB_SYS_s390_BASE);
+#else
+static const struct syscall_table syscall_table_32 = { NULL, 0, 0 };
+#endif
 #ifdef SB_SCHIZO_s390x
-#define S(s) { SB_SYS_s390x_##s, SB_NR_##s, #s },
+static const struct syscall_entry syscall_entries_64[] = {
+#define S(s) [SB_SYS_s390x_##s - SB_SYS_s390x_BASE] = { SB_SYS_s390x_##s, SB_NR_##s, #s },
 #include "trace_syscalls_s390x.h"
 #undef S
-#endif
-	{ SB_NR_UNDEF, SB_NR_UNDEF, NULL },
 };
+static const struct syscall_table syscall_table_64 = SYSCALL_TABLE(syscall_entries_64, SB_SYS_s390x_BASE);
+#else
+static const struct syscall_table syscall_table_64 = { NULL, 0, 0 };
+#endif
 
 static bool pers_is_31(trace_regs *regs)
 {
 	return regs->psw.mask & 0x100000000ul ? false : true;
 }
 
-static const struct syscall_entry *trace_check_personality(void *vregs)
+static const struct syscall_table *trace_check_personality(void *vregs)
 {
 	trace_regs *regs = vregs;
-	return pers_is_31(regs) ? syscall_table_32 : syscall_table_64;
+	return pers_is_31(regs) ? &syscall_table_32 : &syscall_table_64;
 }
 
 static bool _trace_possible(const void *data)
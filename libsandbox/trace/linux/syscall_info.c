@@ -2,7 +2,6 @@
 #define trace_regs struct ptrace_syscall_info
 
 #define trace_reg_sysnum entry.nr
-#define trace_reg_ret exit.rval
 
 #undef trace_get_regs
 #define trace_get_regs(regs) do_ptrace(PTRACE_GET_SYSCALL_INFO, (void *)(uintptr_t)sizeof(trace_regs), regs)
@@ -16,9 +15,28 @@ static unsigned long trace_arg(void *vregs, int num)
 		return -1;
 }
 
+static long trace_raw_ret(void *vregs)
+{
+	trace_regs *regs = vregs;
+	return regs->exit.rval;
+}
+
+/* Modifying the syscall info requires linux-6.16+. */
 #undef trace_set_regs
 static long trace_set_regs(void *vregs)
 {
-	sb_ewarn("sandbox: Unable to block violation\n");
+	errno = 0;
+	if (ptrace(PTRACE_SET_SYSCALL_INFO, trace_pid, (void *)(uintptr_t)sizeof(trace_regs), vregs) == -1) {
+		sb_ewarn("sandbox: Unable to block violation\n");
+		return -1;
+	}
 	return 0;
 }
+
+static void trace_set_ret(void *vregs, int err)
+{
+	trace_regs *regs = vregs;
+	regs->exit.rval = -err;
+	regs->exit.is_error = 1;
+	trace_set_regs(regs);
+}
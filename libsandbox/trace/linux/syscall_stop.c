@@ -0,0 +1,149 @@
+/* Access to the tracee state at a syscall stop.
+ *
+ * Newer kernels let us read (5.3+) and modify (6.16+) just the syscall info
+ * with PTRACE_{GET,SET}_SYSCALL_INFO rather than copying out the whole register
+ * set at every stop.  Support is detected at runtime the first time we try to
+ * use it, and we fall back to the arch register code when the kernel does not
+ * know about the request.  Forked tracers inherit what we learned.
+ */
+
+struct trace_stop {
+	bool si;
+	union {
+		trace_regs regs;
+#ifdef HAVE_STRUCT_PTRACE_SYSCALL_INFO
+		struct ptrace_syscall_info info;
+#endif
+	};
+};
+
+#ifdef HAVE_STRUCT_PTRACE_SYSCALL_INFO
+
+/* -1: not yet probed; 0: not supported; 1: supported */
+static int trace_si_get = -1, trace_si_set = -1;
+
+static bool trace_si_unsupported(void)
+{
+	/* Older kernels reject unknown requests with EIO, and newer ones reject
+	 * modifications they do not support with EINVAL.
+	 */
+	return errno == EIO || errno == EINVAL;
+}
+
+static bool trace_stop_get_info(struct trace_stop *stop, __u8 op)
+{
+	long ret;
+
+	if (!trace_si_get)
+		return false;
+
+	errno = 0;
+	ret = ptrace(PTRACE_GET_SYSCALL_INFO, trace_pid,
+	             (void *)(uintptr_t)sizeof(stop->info), &stop->info);
+	if (ret == -1) {
+		if (!trace_si_unsupported())
+			return false;
+		trace_si_get = 0;
+		return false;
+	}
+	trace_si_get = 1;
+
+	return stop->info.op == op;
+}
+
+static bool trace_stop_set_info(struct trace_stop *stop)
+{
+	if (!trace_si_set)
+		return false;
+
+	errno = 0;
+	if (ptrace(PTRACE_SET_SYSCALL_INFO, trace_pid,
+	           (void *)(uintptr_t)sizeof(stop->info), &stop->info) == -1) {
+		if (trace_si_unsupported())
+			trace_si_set = 0;
+		return false;
+	}
+	trace_si_set = 1;
+
+	return true;
+}
+
+#else
+# define trace_stop_get_info(stop, op) false
+# define trace_stop_set_info(stop) false
+#endif
+
+/* Load the state for a syscall entry (|entry| is true) or exit stop. */
+static void trace_stop_get(struct trace_stop *stop, bool entry)
+{
+	stop->si = trace_stop_get_info(stop,
+		entry ? PTRACE_SYSCALL_INFO_ENTRY : PTRACE_SYSCALL_INFO_EXIT);
+	if (!stop->si)
+		trace_get_regs(&stop->regs);
+}
+
+/* Load the full register set.  Used for personality checks, and when the
+ * syscall info could not be written back so the arch code can do it instead.
+ */
+static void trace_stop_get_regs(struct trace_stop *stop)
+{
+	stop->si = false;
+	trace_get_regs(&stop->regs);
+}
+
+static int trace_stop_sysnum(struct trace_stop *stop)
+{
+#ifdef HAVE_STRUCT_PTRACE_SYSCALL_INFO
+	if (stop->si)
+		return stop->info.entry.nr;
+#endif
+	return trace_get_sysnum(&stop->regs);
+}
+
+static unsigned long trace_stop_arg(struct trace_stop *stop, int num)
+{
+#ifdef HAVE_STRUCT_PTRACE_SYSCALL_INFO
+	if (stop->si)
+		return num < 7 ? stop->info.entry.args[num - 1] : -1;
+#endif
+	return trace_arg(&stop->regs, num);
+}
+
+static void trace_stop_set_sysnum(struct trace_stop *stop, long nr)
+{
+#ifdef HAVE_STRUCT_PTRACE_SYSCALL_INFO
+	if (stop->si) {
+		stop->info.entry.nr = nr;
+		if (trace_stop_set_info(stop))
+			return;
+		trace_stop_get_regs(stop);
+	}
+#endif
+	trace_set_sysnum(&stop->regs, nr);
+}
+
+static void trace_stop_set_ret(struct trace_stop *stop, int err)
+{
+#ifdef HAVE_STRUCT_PTRACE_SYSCALL_INFO
+	if (stop->si) {
+		stop->info.exit.rval = -err;
+		stop->info.exit.is_error = 1;
+		if (trace_stop_set_info(stop))
+			return;
+		trace_stop_get_regs(stop);
+	}
+#endif
+	trace_set_ret(&stop->regs, err);
+}
+
+static long trace_stop_result(struct trace_stop *stop, int *error)
+{
+#ifdef HAVE_STRUCT_PTRACE_SYSCALL_INFO
+	if (stop->si) {
+		long sr = stop->info.exit.rval;
+		*error = stop->info.exit.is_error ? -sr : 0;
+		return *error ? -1 : sr;
+	}
+#endif
+	return trace_result(&stop->regs, error);
+}
@@ -3,30 +3,36 @@
 
 #ifdef SB_SCHIZO
 
-static const struct syscall_entry syscall_table_32[] = {
 #ifdef SB_SCHIZO_x86
-#define S(s) { SB_SYS_x86_##s, SB_NR_##s, #s },
+static const struct syscall_entry syscall_entries_32[] = {
+#define S(s) [SB_SYS_x86_##s - SB_SYS_x86_BASE] = { SB_SYS_x86_##s, SB_NR_##s, #s },
 #include "trace_syscalls_x86.h"
 #undef S
-#endif
-	{ SB_NR_UNDEF, SB_NR_UNDEF, NULL },
 };
-static const struct syscall_entry syscall_table_64[] = {
+static const struct syscall_table syscall_table_32 = SYSCALL_TABLE(syscall_entries_32, SB_SYS_x86_BASE);
+#else
+static const struct syscall_table syscall_table_32 = { NULL, 0, 0 };
+#endif
 #ifdef SB_SCHIZO_x86_64
-#define S(s) { SB_SYS_x86_64_##s, SB_NR_##s, #s },
+static const struct syscall_entry syscall_entries_64[] = {
+#define S(s) [SB_SYS_x86_64_##s - SB_SYS_x86_64_BASE] = { SB_SYS_x86_64_##s, SB_NR_##s, #s },
 #include "trace_syscalls_x86_64.h"
 #undef S
-#endif
-	{ SB_NR_UNDEF, SB_NR_UNDEF, NULL },
 };
-static const struct syscall_entry syscall_table_x32[] = {
+static const struct syscall_table syscall_table_64 = SYSCALL_TABLE(syscall_entries_64, SB_SYS_x86_64_BASE);
+#else
+static const struct syscall_table syscall_table_64 = { NULL, 0, 0 };
+#endif
 #ifdef SB_SCHIZO_x32
-#define S(s) { SB_SYS_x32_##s, SB_NR_##s, #s },
+static const struct syscall_entry syscall_entries_x32[] = {
+#define S(s) [SB_SYS_x32_##s - SB_SYS_x32_BASE] = { SB_SYS_x32_##s, SB_NR_##s, #s },
 #include "trace_syscalls_x32.h"
 #undef S
-#endif
-	{ SB_NR_UNDEF, SB_NR_UNDEF, NULL },
 };
+static const struct syscall_table syscall_table_x32 = SYSCALL_TABLE(syscall_entries_x32, SB_SYS_x32_BASE);
+#else
+static const struct syscall_table syscall_table_x32 = { NULL, 0, 0 };
+#endif
 
 static bool pers_is_32(trace_regs *regs)
 {
@@ -46,15 +52,15 @@ static bool pers_is_x32(trace_regs *regs)
 	}
 }
 
-static const struct syscall_entry *trace_check_personality(void *vregs)
+static const struct syscall_table *trace_check_personality(void *vregs)
 {
 	trace_regs *regs = vregs;
 	if (pers_is_32(regs))
-		return syscall_table_32;
+		return &syscall_table_32;
 	else if (pers_is_x32(regs))
-		return syscall_table_x32;
+		return &syscall_table_x32;
 	else
-		return syscall_table_64;
+		return &syscall_table_64;
 }
 
 static bool _trace_possible(const void *data)
@@ -0,0 +1,188 @@
+/* tracebuf.c - record the accesses we check in the shared trace buffer
+ *
+ * When the sandbox program was started with SANDBOX_TRACE, it passes down the
+ * path of a trace buffer (see sb_tracebuf.h) that we map & append a record to
+ * for every access we check.  The sandbox program decodes it into the debug
+ * log once everything is done.  Like the exec cache, none of this is critical:
+ * if anything goes wrong, the record is simply lost.
+ *
+ * Copyright 2026 Gentoo Foundation
+ * Licensed under the GPL-2
+ */
+
+#include "headers.h"
+#include "sbutil.h"
+#include "libsandbox.h"
+#include "wrappers.h"
+#include "sb_tracebuf.h"
+
+/* How many slots to look at for a given string before giving up on it. */
+#define TRACEBUF_PROBES 16
+
+/* Strings in the older half of the ring get copied again rather than reused,
+ * so that the ones a new record refers to stay around for a while yet.
+ */
+#define TRACEBUF_STR_FRESH(pos, used) ((used) - (pos) <= SB_TRACEBUF_STRINGS / 2)
+
+char sb_tracebuf_path[SB_PATH_MAX];
+static struct sb_tracebuf *tracebuf;
+static bool tracebuf_mapped;
+
+/* The cmdline only changes when we exec, so only intern it once per process. */
+static pid_t tracebuf_cmdline_pid;
+static uint64_t tracebuf_cmdline;
+
+void sb_tracebuf_init(void)
+{
+	const char *path = getenv(ENV_SANDBOX_TRACEBUF);
+
+	if (path && strlen(path) < sizeof(sb_tracebuf_path))
+		strcpy(sb_tracebuf_path, path);
+}
+
+/* Our callers hold sb_lock() already. */
+static struct sb_tracebuf *tracebuf_map(void)
+{
+	if (!tracebuf_mapped) {
+		tracebuf = sb_map_shared_file(sb_tracebuf_path, sizeof(*tracebuf), PROT_READ|PROT_WRITE,
+		                              SB_TRACEBUF_MAGIC, SB_TRACEBUF_VERSION);
+		tracebuf_mapped = true;
+	}
+	return tracebuf;
+}
+
+static bool tracebuf_str_eq(const struct sb_tracebuf *tb, uint64_t pos, const char *str, size_t len)
+{
+	size_t off = pos % SB_TRACEBUF_STRINGS;
+	uint32_t slen;
+
+	if (off > SB_TRACEBUF_STRINGS - SB_TRACEBUF_STR_SIZE(len))
+		return false;
+	memcpy(&slen, tb->strings + off, sizeof(slen));
+	return slen == len && !memcmp(tb->strings + off + sizeof(slen), str, len);
+}
+
+/* Copy |str| into the string ring, and return where it went. */
+static uint64_t tracebuf_str_add(struct sb_tracebuf *tb, const char *str, size_t len)
+{
+	uint64_t pos, size = SB_TRACEBUF_STR_SIZE(len);
+	uint32_t slen = len;
+	char *dst;
+
+	/* If it doesn't fit before the end, take the space at the start. */
+	do
+		pos = __atomic_fetch_add(&tb->strings_used, size, __ATOMIC_RELAXED);
+	while (pos % SB_TRACEBUF_STRINGS + size > SB_TRACEBUF_STRINGS);
+
+	dst = tb->strings + pos % SB_TRACEBUF_STRINGS;
+	memcpy(dst, &slen, sizeof(slen));
+	memcpy(dst + sizeof(slen), str, len);
+	dst[sizeof(slen) + len] = '\0';
+	return pos;
+}
+
+/* Find |str| in the string table, adding it if need be.  Returns its position,
+ * or 0 if it's too big to store.
+ */
+static uint64_t tracebuf_intern(struct sb_tracebuf *tb, const char *str, size_t len)
+{
+	uint64_t pos = 0, cur, used;
+	uint32_t hash = 2166136261u;
+	size_t i;
+
+	if (len > SB_TRACEBUF_STRINGS / 2)
+		return 0;
+
+	for (i = 0; i < len; ++i)
+		hash = (hash ^ (unsigned char)str[i]) * 16777619u;
+
+	for (i = 0; i < TRACEBUF_PROBES; ++i) {
+		uint64_t *slot = &tb->slots[(hash + i) % SB_TRACEBUF_SLOTS];
+
+		cur = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+		/* Only now is |cur| sure to have been handed out already. */
+		used = __atomic_load_n(&tb->strings_used, __ATOMIC_RELAXED);
+		/* Take over slots whose strings have since been overwritten. */
+		if (!SB_TRACEBUF_STR_LIVE(cur, used)) {
+			/* Write it out before we publish it in the slot. */
+			if (!pos)
+				pos = tracebuf_str_add(tb, str, len);
+			if (__atomic_compare_exchange_n(slot, &cur, pos, false,
+			                                __ATOMIC_RELEASE, __ATOMIC_ACQUIRE))
+				return pos;
+			/* Someone beat us to it; see if it's the same string. */
+			used = __atomic_load_n(&tb->strings_used, __ATOMIC_RELAXED);
+		}
+		if (SB_TRACEBUF_STR_LIVE(cur, used) && tracebuf_str_eq(tb, cur, str, len)) {
+			if (TRACEBUF_STR_FRESH(cur, used))
+				return cur;
+			if (!pos)
+				pos = tracebuf_str_add(tb, str, len);
+			__atomic_compare_exchange_n(slot, &cur, pos, false,
+			                            __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+			return pos;
+		}
+	}
+
+	/* The table is too crowded around here; store it without an index. */
+	return pos ? : tracebuf_str_add(tb, str, len);
+}
+
+/* The cmdline changes when a traced process execs. */
+void sb_tracebuf_cmdline_reset(void)
+{
+	tracebuf_cmdline_pid = 0;
+}
+
+void sb_tracebuf_record(int sb_nr, const char *func, const char *path,
+                        const char *apath, const char *rpath, bool access)
+{
+	struct sb_tracebuf *tb;
+	struct sb_tracebuf_record *r;
+	struct timespec ts;
+	uint64_t func_off, path_off, apath_off, rpath_off;
+	uint64_t idx;
+	pid_t pid;
+
+	tb = tracebuf_map();
+	if (!tb)
+		return;
+
+	/* Go again too once the ring is about to wrap over our copy. */
+	pid = trace_pid ? : getpid();
+	if (tracebuf_cmdline_pid != pid ||
+	    (tracebuf_cmdline && !TRACEBUF_STR_FRESH(tracebuf_cmdline,
+	                         __atomic_load_n(&tb->strings_used, __ATOMIC_RELAXED)))) {
+		const char *cmdline;
+		size_t cmdline_len = 0;
+
+		cmdline = sb_log_get_cmdline(&cmdline_len);
+		tracebuf_cmdline = cmdline ? tracebuf_intern(tb, cmdline, cmdline_len) : 0;
+		tracebuf_cmdline_pid = pid;
+	}
+
+	func_off = tracebuf_intern(tb, func, strlen(func));
+	path_off = tracebuf_intern(tb, path, strlen(path));
+	apath_off = tracebuf_intern(tb, apath, strlen(apath));
+	rpath_off = rpath == apath ? apath_off : tracebuf_intern(tb, rpath, strlen(rpath));
+	clock_gettime(CLOCK_REALTIME, &ts);
+
+	idx = __atomic_fetch_add(&tb->head, 1, __ATOMIC_RELAXED);
+	r = &tb->records[idx % SB_TRACEBUF_RECORDS];
+
+	/* Let readers know the record is in flux while we fill it in. */
+	__atomic_store_n(&r->seq, 0, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	r->pid = pid;
+	r->sb_nr = sb_nr;
+	r->access = access;
+	r->time = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+	r->func = func_off;
+	r->path = path_off;
+	r->apath = apath_off;
+	r->rpath = rpath_off;
+	r->cmdline = tracebuf_cmdline;
+
+	__atomic_store_n(&r->seq, (uint32_t)(idx + 1), __ATOMIC_RELEASE);
+}
@@ -20,39 +20,75 @@ static WRAPPER_RET_TYPE (*WRAPPER_TRUE_NAME)(WRAPPER_ARGS_PROTO) = NULL;
 #ifndef SB_EXEC_COMMON
 #define SB_EXEC_COMMON
 
-/* Check to see if we can run this program in-process.  If not, try to fall back
- * tracing it out-of-process via some trace mechanisms (e.g. ptrace).
+/* Look at the program ourselves, and pass it along for the exec cache.  |st|
+ * is updated to match the file we actually looked at.  Returns false if we
+ * couldn't read it.
  */
-static bool sb_check_exec(const char *filename, char *const argv[])
+static bool sb_exec_inspect(const char *filename, struct stat64 *st,
+                            struct sb_exec_info *info)
 {
 	int fd;
-	unsigned char *elf;
+
+	fd = sb_unwrapped_open_DEFAULT(filename, O_RDONLY|O_CLOEXEC, 0);
+	if (fd == -1)
+		return false;
+	if (fstat64(fd, st)) {
+		close(fd);
+		return false;
+	}
+
+	sb_exec_classify(fd, st, info);
+	sb_exec_cache_put(fd);
+
+	close(fd);
+	return true;
+}
+
+/* Check to see if we can run this program in-process.  If not, see if we can
+ * fall back to tracing it out-of-process via some trace mechanisms (e.g.
+ * ptrace), and set |do_trace| if so.
+ */
+static bool sb_check_exec_trace(int sb_nr, const char *func, const char *filename,
+                                char *const argv[], bool *do_trace)
+{
 	struct stat64 st;
-	bool do_trace = false;
-	bool run_in_process = true;
+	struct sb_exec_info info;
+	bool run_in_process = true, cached, classified;
+	uint64_t classify_start;
+	int decision;
 	sandbox_method_t method = get_sandbox_method();
 
+	*do_trace = false;
+
 	if (unlikely(method == SANDBOX_METHOD_PRELOAD))
 		return true;
 
-	fd = sb_unwrapped_open_DEFAULT(filename, O_RDONLY|O_CLOEXEC, 0);
-	if (fd == -1)
+	/* The kernel holds static programs to SANDBOX_WRITE for us. */
+	if (method == SANDBOX_METHOD_LANDLOCK && sb_landlock_on())
+		return true;
+
+	/* Builds run the same programs over & over, so see if we (or any other
+	 * process in the sandbox) already looked at this one before opening it.
+	 */
+	if (stat64(filename, &st))
 		return true;
-	if (fstat64(fd, &st))
-		goto out_fd;
-	if (st.st_size < sizeof(Elf64_Ehdr))
-		goto out_fd;
-	elf = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
-	if (elf == MAP_FAILED)
-		goto out_fd;
-
-	if (elf[EI_MAG0] != ELFMAG0 &&
-	    elf[EI_MAG1] != ELFMAG1 &&
-	    elf[EI_MAG2] != ELFMAG2 &&
-	    elf[EI_MAG3] != ELFMAG3 &&
-	    !(elf[EI_CLASS] != ELFCLASS32 ||
-	      elf[EI_CLASS] != ELFCLASS64))
-		goto out_mmap;
+	cached = sb_exec_cache_get(&st, &info);
+	if (!cached) {
+		classify_start = sb_stats_start();
+		classified = sb_exec_inspect(filename, &st, &info);
+		sb_stats_time(SB_STATS_TIME_CLASSIFY, classify_start);
+		if (!classified)
+			return true;
+	}
+
+	if (!(info.flags & SB_EXEC_ELF)) {
+		SB_PROBE(exec, func, filename, SB_STATS_EXEC_OTHER, cached);
+		sb_stats_exec(sb_nr, func, SB_STATS_EXEC_OTHER, cached);
+		return true;
+	}
+
+	if (info.flags & SB_EXEC_TRACE)
+		run_in_process = false;
 
 	/* If we are non-root but attempt to execute a set*id program,
 	 * our LD_PRELOAD trick won't work.  So skip the static check.
@@ -68,179 +104,42 @@ static bool sb_check_exec(const char *filename, char *const argv[])
 		if (getuid() != 0)
 			run_in_process = false;
 
-	/* We also need to ptrace programs that interpose their own allocator.
-	 * https://crbug.com/586444
-	 */
-	if (run_in_process) {
-		static const char * const libc_alloc_syms[] = {
-			"__libc_calloc",
-			"__libc_free",
-			"__libc_malloc",
-			"__libc_realloc",
-			"__malloc_hook",
-			"__realloc_hook",
-			"__free_hook",
-			"__memalign_hook",
-			"__malloc_initialize_hook",
+	if (!run_in_process) {
+		Elf64_Ehdr ehdr = {
+			.e_ident[EI_CLASS] = info.ei_class,
+			.e_machine = info.e_machine,
 		};
-#define PARSE_ELF(n) \
-({ \
-	Elf##n##_Ehdr *ehdr = (void *)elf; \
-	Elf##n##_Phdr *phdr = (void *)(elf + ehdr->e_phoff); \
-	Elf##n##_Addr vaddr, filesz, vsym = 0, vstr = 0, vhash = 0, vgnuhash = 0; \
-	Elf##n##_Off offset, symoff = 0, stroff = 0, hashoff = 0, gnuhashoff = 0; \
-	Elf##n##_Dyn *dyn; \
-	Elf##n##_Sym *sym, *symend; \
-	uint##n##_t ent_size = 0, str_size = 0; \
-	bool dynamic = false; \
-	size_t i; \
-	\
-	if (st.st_size < ehdr->e_phoff + ehdr->e_phentsize * ehdr->e_phnum) \
-		goto out_mmap; \
-	\
-	/* First gather the tags we care about. */ \
-	for (i = 0; i < ehdr->e_phnum; ++i) { \
-		switch (phdr[i].p_type) { \
-		case PT_INTERP: dynamic = true; break; \
-		case PT_DYNAMIC: \
-			dyn = (void *)(elf + phdr[i].p_offset); \
-			while (dyn->d_tag != DT_NULL) { \
-				switch (dyn->d_tag) { \
-				case DT_SYMTAB:      vsym = dyn->d_un.d_val; break; \
-				case DT_SYMENT:      ent_size = dyn->d_un.d_val; break; \
-				case DT_STRTAB:      vstr = dyn->d_un.d_val; break; \
-				case DT_STRSZ:       str_size = dyn->d_un.d_val; break; \
-				case DT_HASH:        vhash = dyn->d_un.d_val; break; \
-				case DT_GNU_HASH:    vgnuhash = dyn->d_un.d_val; break; \
-				} \
-				++dyn; \
-			} \
-			break; \
-		} \
-	} \
-	\
-	if (dynamic && vsym && ent_size && vstr && str_size) { \
-		/* Figure out where in the file these tables live. */ \
-		for (i = 0; i < ehdr->e_phnum; ++i) { \
-			vaddr = phdr[i].p_vaddr; \
-			filesz = phdr[i].p_filesz; \
-			offset = phdr[i].p_offset; \
-			if (vsym >= vaddr && vsym < vaddr + filesz) \
-				symoff = offset + (vsym - vaddr); \
-			if (vstr >= vaddr && vstr < vaddr + filesz) \
-				stroff = offset + (vstr - vaddr); \
-			if (vhash >= vaddr && vhash < vaddr + filesz) \
-				hashoff = offset + (vhash - vaddr); \
-			if (vgnuhash >= vaddr && vgnuhash < vaddr + filesz) \
-				gnuhashoff = offset + (vgnuhash - vaddr); \
-		} \
-		\
-		/* Finally walk the symbol table.  This should generally be fast as \
-		 * we only look at exported symbols, and the vast majority of exes \
-		 * out there do not export any symbols at all. \
-		 */ \
-		if (symoff && stroff) { \
-			/* Nowhere is the # of symbols recorded, or the size of the symbol \
-			 * table.  Instead, we do what glibc does: use the gnu or sysv hash \
-			 * table if it exists, else assume that the string table always directly \
-			 * follows the symbol table.  This seems like a poor assumption to \
-			 * make, but glibc has gotten by this long.  See determine_info in \
-			 * glibc's elf/dl-addr.c. \
-			 * \
-			 * We don't sanity check the ranges here as you aren't executing \
-			 * corrupt programs in the sandbox. \
-			 */ \
-			sym = (void *)(elf + symoff); \
-			if (vgnuhash) { \
-				uint32_t *hash32 = (void *)(elf + gnuhashoff); \
-				/* use glibc's elf/dl-lookup.c:_dl_setup_hash() as a reference */ \
-				/*   DT_GNU_HASH header: */ \
-				uint32_t nbuckets = *hash32++; \
-				uint32_t symbias = *hash32++; \
-				uint32_t bitmask_nwords = *hash32++; \
-				hash32++; /* gnu_shift */ \
-				hash32 += n / 32 * bitmask_nwords; /* gnu_bitmask */ \
-				uint32_t *gnu_buckets = hash32; \
-				hash32 += nbuckets; \
-				uint32_t *gnu_chain_zero = hash32 - symbias; \
-				\
-				uint32_t bucket; \
-				\
-				for (bucket = 0; bucket < nbuckets; bucket++) { \
-					uint32_t symndx = gnu_buckets[bucket]; \
-					if (symndx != 0) { \
-						const uint32_t *hasharr = &gnu_chain_zero[symndx]; \
-						do { \
-							Elf##n##_Sym * s = &sym[symndx]; \
-							\
-							/* keep in sync with 'vhash' case */ \
-							char *symname = (void *)(elf + stroff + s->st_name); \
-							if (ELF##n##_ST_VISIBILITY(s->st_other) == STV_DEFAULT && \
-							    s->st_shndx != SHN_UNDEF && s->st_shndx < SHN_LORESERVE && \
-							    s->st_name && \
-							    /* Minor optimization to avoid strcmp. */ \
-							    symname[0] == '_' && symname[1] == '_') { \
-								/* Blacklist internal C library symbols. */ \
-								for (i = 0; i < ARRAY_SIZE(libc_alloc_syms); ++i) \
-									if (!strcmp(symname, libc_alloc_syms[i])) { \
-										run_in_process = false; \
-										goto use_trace; \
-									} \
-							} \
-							++symndx; \
-						} while ((*hasharr++ & 1u) == 0); \
-					} \
-				} \
-			} else { \
-				if (vhash) { \
-					/* Hash entries are always 32-bits. */ \
-					uint32_t *hashes = (void *)(elf + hashoff); \
-					symend = sym + hashes[1]; \
-				} else \
-					symend = (void *)(elf + stroff); \
-				\
-				while (sym < symend) { \
-					/* keep insync with 'vgnuhash' case */ \
-					char *symname = (void *)(elf + stroff + sym->st_name); \
-					if (ELF##n##_ST_VISIBILITY(sym->st_other) == STV_DEFAULT && \
-					    sym->st_shndx != SHN_UNDEF && sym->st_shndx < SHN_LORESERVE && \
-					    sym->st_name && \
-					    /* Minor optimization to avoid strcmp. */ \
-					    symname[0] == '_' && symname[1] == '_') { \
-						/* Blacklist internal C library symbols. */ \
-						for (i = 0; i < ARRAY_SIZE(libc_alloc_syms); ++i) \
-							if (!strcmp(symname, libc_alloc_syms[i])) { \
-								run_in_process = false; \
-								goto use_trace; \
-							} \
-					} \
-					++sym; \
-				} \
-			} \
-		} \
-		\
-	} \
-	\
-	if (dynamic) \
-		goto done; \
-})
-		if (elf[EI_CLASS] == ELFCLASS32)
-			PARSE_ELF(32);
-		else
-			PARSE_ELF(64);
-#undef PARSE_ELF
+		*do_trace = trace_possible(filename, argv, &ehdr);
 	}
 
- use_trace:
-	do_trace = trace_possible(filename, argv, elf);
-	/* Now that we're done with stuff, clean up before forking */
+	decision = run_in_process ? SB_STATS_EXEC_PRELOAD :
+		*do_trace ? SB_STATS_EXEC_TRACE : SB_STATS_EXEC_UNCHECKED;
+	SB_PROBE(exec, func, filename, decision, cached);
+	sb_stats_exec(sb_nr, func, decision, cached);
+	return run_in_process;
+}
+
+/* Like sb_check_exec_trace(), but start tracing the program we're about to
+ * exec when it needs it.
+ */
+static bool sb_check_exec(int sb_nr, const char *func, const char *filename, char *const argv[])
+{
+	bool do_trace;
+	uint64_t span_start = sb_timeline_start();
 
- done:
+	/* This process is about to become the program, so it's the one to hand
+	 * over to the kernel in, right before the exec (see WRAPPER_NAME()).
+	 * There's no undoing that, so don't for programs we can't run anyways.
+	 * Processes sharing memory with their parent can't (see
+	 * sb_check_exec_helper()), and leave it to what they run.
+	 */
+	if (get_sandbox_method() == SANDBOX_METHOD_LANDLOCK &&
+	    sb_unwrapped_access(filename, X_OK) == 0)
+		sb_landlock_prepare();
 
- out_mmap:
-	munmap(elf, st.st_size);
- out_fd:
-	close(fd);
+	bool run_in_process = sb_check_exec_trace(sb_nr, func, filename, argv, &do_trace);
+
+	sb_timeline_span(SB_SPAN_EXEC, func, span_start);
 
 	if (do_trace) {
 		sb_debug_dyn("tracing: %s\n", filename);
@@ -250,6 +149,72 @@ static bool sb_check_exec(const char *filename, char *const argv[])
 	return run_in_process;
 }
 
+/* posix_spawn() & vfork() children share memory with their parent until they
+ * exec, so we can't set up tracing in them like sb_check_exec() does (the
+ * tracer would be running on the parent's memory).  Instead we run the exec
+ * helper with us preloaded, and it execs the program for us from a process of
+ * its own.  Returns the argv to run the helper with, or NULL if it isn't
+ * available.
+ */
+static char **sb_exec_helper_argv(const char *path, char *const argv[])
+{
+	char **ret, *abspath;
+	size_t i, argc;
+
+	if (sb_unwrapped_access(sandbox_exec_helper, X_OK)) {
+		sb_eqawarn("Unable to trace static ELF: %s: missing %s\n",
+			path, sandbox_exec_helper);
+		return NULL;
+	}
+
+	/* Spawn file actions might change the cwd before the helper runs. */
+	if (path[0] == '/')
+		abspath = xstrdup(path);
+	else {
+		char cwd[SB_PATH_MAX];
+		if (!sb_unwrapped_getcwd(cwd, sizeof(cwd)))
+			return NULL;
+		abspath = xmalloc(strlen(cwd) + 1 + strlen(path) + 1);
+		sprintf(abspath, "%s/%s", cwd, path);
+	}
+
+	for (argc = 0; argv[argc]; ++argc)
+		continue;
+	ret = xmalloc(sizeof(*ret) * (argc + 3));
+	ret[0] = sandbox_exec_helper;
+	ret[1] = abspath;
+	for (i = 0; i <= argc; ++i)
+		ret[i + 2] = argv[i];
+
+	return ret;
+}
+
+/* Like sb_check_exec(), but for processes that share memory with their parent.
+ * When the program needs to be traced, |helper_argv| is set to run it via the
+ * exec helper instead.
+ */
+static bool sb_check_exec_helper(int sb_nr, const char *func, const char *filename,
+                                 char *const argv[], char ***helper_argv)
+{
+	bool do_trace;
+	uint64_t span_start = sb_timeline_start();
+	bool run_in_process = sb_check_exec_trace(sb_nr, func, filename, argv, &do_trace);
+
+	sb_timeline_span(SB_SPAN_EXEC, func, span_start);
+
+	*helper_argv = NULL;
+	if (do_trace) {
+		*helper_argv = sb_exec_helper_argv(filename, argv);
+		if (*helper_argv) {
+			sb_debug_dyn("tracing via %s: %s\n", sandbox_exec_helper, filename);
+			/* The helper itself is a normal program. */
+			return true;
+		}
+	}
+
+	return run_in_process;
+}
+
 #endif
 
 attribute_hidden
@@ -266,23 +231,31 @@ WRAPPER_RET_TYPE WRAPPER_NAME(WRAPPER_ARGS_PROTO)
 {
 	WRAPPER_RET_TYPE result = WRAPPER_RET_DEFAULT;
 	bool run_in_process = true;
+	uint64_t stats_start;
 
 	/* The C library may implement some exec funcs by calling other
 	 * exec funcs.  So we might get a little sandbox recursion going
 	 * on.  But this shouldn't cause a problem now should it ?
 	 */
 #ifdef EXEC_RECUR_CHECK
-	static __thread size_t recursive = 0;
+	/* Avoid the dynamic TLS model: it might call the program's malloc(). */
+	static __thread size_t recursive attribute_tls_ie = 0;
 
 	if (recursive++)
 		goto do_exec_only;
 #endif
 
 	save_errno();
+	stats_start = sb_stats_start();
+#ifndef EXEC_SPAWN
+	bool vforked = sb_in_vfork_child();
+#endif
+	sb_vfork_leftovers_free();
 
 #ifndef EXEC_NO_FILE
 	const char *check_path = path;
 	char *mem1 = NULL, *mem2 = NULL;
+	char **helper_argv = NULL;
 # ifndef EXEC_NO_PATH
 	/* Some exec funcs always operate on full paths, while others
 	 * will search $PATH if the specified name lacks a slash.
@@ -307,10 +280,25 @@ WRAPPER_RET_TYPE WRAPPER_NAME(WRAPPER_ARGS_PROTO)
 
 # endif
 	if (check_path) {
-		if (!SB_SAFE(check_path))
+		if (!SB_SAFE(check_path)) {
+# ifdef EXEC_SPAWN
+			/* The spawn funcs return the error rather than set errno. */
+			result = errno;
+# endif
 			goto done;
+		}
 
-		run_in_process = sb_check_exec(check_path, argv);
+# ifndef EXEC_SPAWN
+		if (!vforked)
+			run_in_process = sb_check_exec(WRAPPER_NR, STRING_NAME, check_path, argv);
+		else
+# endif
+			run_in_process = sb_check_exec_helper(WRAPPER_NR, STRING_NAME, check_path,
+			                                      argv, &helper_argv);
+		if (helper_argv) {
+			path = helper_argv[0];
+			argv = helper_argv;
+		}
 	}
 #endif
 
@@ -322,11 +310,41 @@ WRAPPER_RET_TYPE WRAPPER_NAME(WRAPPER_ARGS_PROTO)
 	environ = ec.sb_envp;
 #endif
 
+	sb_stats_time(SB_STATS_TIME_EXEC, stats_start);
 	restore_errno();
+
+	/* The env (& maybe the lack of a tracer) already count on the kernel
+	 * holding the program to SANDBOX_WRITE, so it can't run if it won't.
+	 */
+	if (unlikely(!sb_landlock())) {
+#ifdef EXEC_SPAWN
+		/* The spawn funcs return the error rather than set errno. */
+		result = errno ? : EPERM;
+		errno = old_errno;
+#else
+		errno = EPERM;
+#endif
+		goto landlock_failed;
+	}
+#ifndef EXEC_SPAWN
+	if (vforked) {
+# ifndef EXEC_NO_FILE
+		void *mem[] = { mem1, mem2, helper_argv ? helper_argv[1] : NULL, helper_argv, };
+		sb_vfork_leftovers_set(&ec, mem, ARRAY_SIZE(mem));
+# else
+		sb_vfork_leftovers_set(&ec, NULL, 0);
+# endif
+	}
+#endif
 #ifdef EXEC_RECUR_CHECK
  do_exec_only:
 #endif
 	result = SB_HIDDEN_FUNC(WRAPPER_NAME)(EXEC_ARGS);
+#ifndef EXEC_SPAWN
+	if (vforked)
+		sb_vfork_leftovers_clear();
+#endif
+ landlock_failed:
 
 #ifndef EXEC_MY_ENV
 	/* https://bugs.gentoo.org/669702: maintain illusion
@@ -343,13 +361,19 @@ WRAPPER_RET_TYPE WRAPPER_NAME(WRAPPER_ARGS_PROTO)
  done:
 	free(mem1);
 	free(mem2);
+	if (helper_argv) {
+		free(helper_argv[1]);
+		free(helper_argv);
+	}
 #endif
 	return result;
 }
 
 #undef EXEC_ARGS
 #undef EXEC_MY_ENV
+#undef EXEC_NO_FILE
 #undef EXEC_NO_PATH
+#undef EXEC_SPAWN
 #undef WRAPPER_ARGS_FULL
 #undef WRAPPER_ARGS_PROTO_FULL
 #undef WRAPPER_SAFE_POST_EXPAND
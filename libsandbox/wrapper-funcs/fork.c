@@ -8,6 +8,8 @@
 /* We're only wrapping fork() as a poor man's pthread_atfork().  That would
  * require dedicated linkage against libpthread.  So here we force the locks
  * to a consistent state before forking. #263657
+ *
+ * The child also notes its own pid so it can tell it isn't a vfork() child.
  */
 
 #define WRAPPER_ARGS_PROTO
@@ -18,6 +20,8 @@
 	/* pthread_atfork(sb_lock, sb_unlock, sb_unlock); */ \
 	sb_lock(); \
 	result = SB_HIDDEN_FUNC(WRAPPER_NAME)(WRAPPER_ARGS_FULL); \
+	if (result == 0) \
+		sb_self_pid = getpid(); \
 	sb_unlock(); \
 	false; \
 })
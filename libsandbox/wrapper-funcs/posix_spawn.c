@@ -0,0 +1,16 @@
+/*
+ * posix_spawn() wrapper.
+ *
+ * Copyright 2026 Gentoo Foundation
+ * Licensed under the GPL-2
+ */
+
+#define WRAPPER_ARGS_PROTO pid_t *pid, const char *path, \
+	const posix_spawn_file_actions_t *file_actions, \
+	const posix_spawnattr_t *attrp, char *const argv[], char *const envp[]
+#define WRAPPER_ARGS pid, path, file_actions, attrp, argv, envp
+#define EXEC_ARGS pid, path, file_actions, attrp, argv, my_env
+#define EXEC_MY_ENV
+#define EXEC_NO_PATH
+#define EXEC_SPAWN
+#include "__wrapper_exec.c"
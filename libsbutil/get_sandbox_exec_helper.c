@@ -0,0 +1,23 @@
+/*
+ * get_sandbox_exec_helper.c
+ *
+ * Util functions.
+ *
+ * Copyright 2026 Gentoo Foundation
+ * Licensed under the GPL-2
+ */
+
+#include "headers.h"
+#include "sbutil.h"
+
+void get_sandbox_exec_helper(char *path)
+{
+	save_errno();
+	if (is_env_on(ENV_SANDBOX_TESTING))
+		snprintf(path, SB_PATH_MAX, "%s/src/%s",
+			getenv("abs_top_builddir"), EXEC_HELPER_NAME);
+	else
+		snprintf(path, SB_PATH_MAX, "%s/%s",
+			SANDBOX_LIBEXEC_PATH, EXEC_HELPER_NAME);
+	restore_errno();
+}
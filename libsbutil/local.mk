@@ -9,6 +9,7 @@ noinst_LTLIBRARIES += %D%/libsbutil.la
 	%D%/sbutil.h                              \
 	%D%/get_sandbox_conf.c                    \
 	%D%/get_sandbox_confd.c                   \
+	%D%/get_sandbox_exec_helper.c             \
 	%D%/get_sandbox_lib.c                     \
 	%D%/get_sandbox_rc.c                      \
 	%D%/get_sandbox_log.c                     \
@@ -16,7 +17,13 @@ noinst_LTLIBRARIES += %D%/libsbutil.la
 	%D%/environment.c                         \
 	%D%/sb_backtrace.c                        \
 	%D%/sb_efuncs.c                           \
+	%D%/sb_exec_cache.h                       \
+	%D%/sb_exec_classify.c                    \
 	%D%/sb_exists.c                           \
+	%D%/sb_log.c                              \
+	%D%/sb_stats.h                            \
+	%D%/sb_timeline.h                         \
+	%D%/sb_tracebuf.h                         \
 	%D%/sb_gdb.c                              \
 	%D%/sb_method.c                           \
 	%D%/sb_open.c                             \
@@ -26,6 +33,8 @@ noinst_LTLIBRARIES += %D%/libsbutil.la
 	%D%/sb_close.c                            \
 	%D%/sb_printf.c                           \
 	%D%/sb_proc.c                             \
+	%D%/sb_shared_file.c                      \
+	%D%/sb_strv.c                             \
 	%D%/sb_memory.c                           \
 	%D%/include/rcscripts/rcutil.h            \
 	%D%/include/rcscripts/util/str_list.h     \
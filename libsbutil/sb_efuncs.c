@@ -26,31 +26,149 @@ static void sbio_init(void)
 	}
 }
 
+/* The message path stays open between messages.  Since the program is free
+ * to close or reuse any fd we hold on to (and might have done so after a
+ * fork), make sure it's still the file we opened before each use.  Only one
+ * caller at a time gets to use it (see sb_message_write).
+ */
+static struct {
+	bool busy;
+	int fd;
+	dev_t dev;
+	ino_t ino;
+} message = { .fd = -1, };
+
+static int sb_message_open(void)
+{
+	if (unlikely(!sbio_message_path))
+		return -1;
+	return sbio_open(sbio_message_path, O_WRONLY|O_APPEND|O_CLOEXEC, 0);
+}
+
+static int sb_message_fd(bool reopen)
+{
+	struct stat st;
+	int fd = message.fd;
+
+	if (fd != -1) {
+		if (fstat(fd, &st) || st.st_dev != message.dev || st.st_ino != message.ino)
+			/* Not ours anymore, so leave it be. */
+			reopen = true;
+		else if (!reopen)
+			return fd;
+		else
+			close(fd);
+		message.fd = -1;
+	}
+
+	fd = sb_message_open();
+	if (fd == -1)
+		return -1;
+	if (fstat(fd, &st)) {
+		close(fd);
+		return -1;
+	}
+	message.dev = st.st_dev;
+	message.ino = st.st_ino;
+	message.fd = fd;
+	return fd;
+}
+
+/* Write |buf| out to the message path.  Another thread (or a signal handler
+ * that interrupted us) might be using the fd we keep open, in which case we
+ * can't wait for it, so we open the path just for this one.
+ */
+static bool sb_message_write(const char *buf, size_t len)
+{
+	bool ret;
+	int fd;
+
+	if (__atomic_test_and_set(&message.busy, __ATOMIC_ACQUIRE)) {
+		fd = sb_message_open();
+		if (fd == -1)
+			return false;
+		ret = sb_write(fd, buf, len) == len;
+		close(fd);
+		return ret;
+	}
+
+	/* If the write fails, the fd might have gone stale, so give it one
+	 * more go with a fresh one.
+	 */
+	fd = sb_message_fd(false);
+	ret = fd != -1 && sb_write(fd, buf, len) == len;
+	if (!ret) {
+		fd = sb_message_fd(true);
+		ret = fd != -1 && sb_write(fd, buf, len) == len;
+	}
+
+	__atomic_clear(&message.busy, __ATOMIC_RELEASE);
+	return ret;
+}
+
 /*
  * First try to write to the known good message log location (which is
  * normally tied to the initial sandbox's stderr).  If that fails, fall
  * back to writing to /dev/tty.  While this might annoy some people,
  * using stderr will break tests that try to validate output. #261957
  * Other related bugs on the topic: #278761
+ *
+ * The whole message is formatted up front so it goes out in one write.
  */
 static void sb_vefunc(const char *prog, const char *color, const char *format, va_list args)
 {
+	char buf[4096];
+	size_t len = 0;
+	va_list copy;
 	bool opened;
 	int fd;
 
-	if (likely(sbio_message_path))
-		fd = sbio_open(sbio_message_path, O_WRONLY|O_APPEND|O_CLOEXEC, 0);
-	else
+	if (color)
+		len = sb_snprintf(buf, sizeof(buf), " %s*%s ", color, COLOR_NORMAL);
+	va_copy(copy, args);
+	len += sb_vsnprintf(buf + len, sizeof(buf) - len, format, copy);
+	va_end(copy);
+
+	opened = false;
+	if (len < sizeof(buf)) {
+		if (sb_message_write(buf, len))
+			return;
+
+		/* If we can't get at the message path ourselves (e.g. after
+		 * dropping privs), the sandbox program can: it owns it.
+		 */
+		if (sbio_collect) {
+			char type = SB_COLLECT_MSG;
+			struct iovec iov[] = {
+				{ .iov_base = &type, .iov_len = 1, },
+				{ .iov_base = buf, .iov_len = len, },
+			};
+			if (sbio_collect(iov, ARRAY_SIZE(iov)))
+				return;
+		}
 		fd = -1;
-	if (fd == -1)
+	} else {
+		/* Too long to go out in one write, so it gets an fd of its
+		 * own rather than tying up the shared one.
+		 */
+		fd = sb_message_open();
+		opened = (fd != -1);
+	}
+
+	if (fd == -1) {
 		fd = sbio_open(sbio_fallback_path, O_WRONLY|O_CLOEXEC, 0);
-	opened = (fd != -1);
+		opened = (fd != -1);
+	}
 	if (fd == -1)
 		fd = fileno(stderr);
 
-	if (color)
-		sb_fdprintf(fd, " %s*%s ", color, COLOR_NORMAL);
-	sb_vfdprintf(fd, format, args);
+	if (len < sizeof(buf))
+		sb_write(fd, buf, len);
+	else {
+		if (color)
+			sb_fdprintf(fd, " %s*%s ", color, COLOR_NORMAL);
+		sb_vfdprintf(fd, format, args);
+	}
 
 	if (opened)
 		close(fd);
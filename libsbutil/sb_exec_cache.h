@@ -0,0 +1,66 @@
+/*
+ * sb_exec_cache.h
+ *
+ * Layout of the exec cache: the sandbox program creates this file & libsandbox
+ * in all of its children map it to look up how to run the programs they exec
+ * (see libsandbox/exec_cache.c).  Since what's in there decides whether a
+ * program gets traced, only the sandbox program writes to it: the children
+ * hand it the programs they had to look at themselves, and it looks again.
+ *
+ * The table is a fixed size hash table of entries guarded by sequence counts:
+ * an odd count means the writer is updating the entry, and readers skip
+ * entries that change underneath them.  Entries are keyed by the identity of
+ * the file including its ctime, which nobody can set, so programs that get
+ * rebuilt or rewritten in place are looked at again.
+ *
+ * Copyright 2026 Gentoo Foundation
+ * Licensed under the GPL-2
+ */
+
+#ifndef __SB_EXEC_CACHE_H__
+#define __SB_EXEC_CACHE_H__
+
+#define SB_EXEC_CACHE_SIZE (192 * 1024)
+
+/* What sb_exec_classify() learned about a program. */
+#define SB_EXEC_ELF   0x01 /* An ELF we know how to handle */
+#define SB_EXEC_TRACE 0x02 /* Has to be traced (e.g. static) */
+struct sb_exec_info {
+	unsigned char flags;
+	unsigned char ei_class;
+	uint16_t e_machine;
+};
+
+struct sb_exec_cache_entry {
+	uint32_t seq;	/* 0 if the entry is unused */
+	struct sb_exec_info info;
+	uint32_t mtime_nsec, ctime_nsec;
+	uint64_t dev, ino, size, mtime, ctime;
+};
+
+#define SB_EXEC_CACHE_ENTRIES (SB_EXEC_CACHE_SIZE / sizeof(struct sb_exec_cache_entry))
+/* How many entries to look at for a given program before giving up. */
+#define SB_EXEC_CACHE_PROBES 4
+
+static inline size_t sb_exec_cache_hash(const struct stat64 *st)
+{
+	uint64_t h = (uint64_t)st->st_ino * 0x9e3779b97f4a7c15ull;
+	h ^= (uint64_t)st->st_dev + (h >> 29);
+	return h % SB_EXEC_CACHE_ENTRIES;
+}
+
+static inline bool sb_exec_cache_match(const struct sb_exec_cache_entry *e, const struct stat64 *st)
+{
+	return e->ino == (uint64_t)st->st_ino &&
+	       e->dev == (uint64_t)st->st_dev &&
+	       e->size == (uint64_t)st->st_size &&
+	       e->mtime == (uint64_t)st->st_mtim.tv_sec &&
+	       e->mtime_nsec == (uint32_t)st->st_mtim.tv_nsec &&
+	       e->ctime == (uint64_t)st->st_ctim.tv_sec &&
+	       e->ctime_nsec == (uint32_t)st->st_ctim.tv_nsec;
+}
+
+/* Work out how the program open on |fd| has to be run; see sb_exec_classify.c. */
+void sb_exec_classify(int fd, const struct stat64 *st, struct sb_exec_info *info);
+
+#endif
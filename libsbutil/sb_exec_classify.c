@@ -0,0 +1,112 @@
+/*
+ * sb_exec_classify.c
+ *
+ * Work out how a program has to be run: whether it's an ELF at all, and if
+ * so, whether our LD_PRELOAD trick will work on it.  libsandbox does this for
+ * every program it execs that isn't in the exec cache yet, and the sandbox
+ * program does it again before putting it there.
+ *
+ * Copyright 2026 Gentoo Foundation
+ * Licensed under the GPL-2
+ */
+
+#include "headers.h"
+#include "sbutil.h"
+#include "sb_exec_cache.h"
+
+/* Read exactly |len| bytes at |off| of the program, failing if that runs off
+ * the end of the file.  We only read the bits of the ELF we need rather than
+ * map the whole thing so that the cost doesn't scale with the program size.
+ */
+static bool sb_elf_read(int fd, const struct stat64 *st, void *buf, uint64_t len, uint64_t off)
+{
+	if (off > (uint64_t)st->st_size || len > (uint64_t)st->st_size - off)
+		return false;
+	return pread64(fd, buf, len, off) == (ssize_t)len;
+}
+
+/* Like sb_elf_read(), but into a new buffer. */
+static void *sb_elf_read_alloc(int fd, const struct stat64 *st, uint64_t len, uint64_t off)
+{
+	void *buf;
+
+	if (off > (uint64_t)st->st_size || len > (uint64_t)st->st_size - off)
+		return NULL;
+	buf = malloc(len + 1);
+	if (buf && !sb_elf_read(fd, st, buf, len, off)) {
+		free(buf);
+		buf = NULL;
+	}
+	return buf;
+}
+
+/* Return values of sb_elf_classify{32,64}(). */
+#define SB_ELF_BAD   -1 /* Couldn't make sense of it */
+#define SB_ELF_OK     0 /* Dynamic program that'll load us */
+#define SB_ELF_TRACE  1 /* Static program */
+
+/* Programs that interpose the C library allocator used to be traced too, but
+ * libsandbox doesn't rely on the program's allocator (see memory.c), so they
+ * load us like any other dynamic program.  https://crbug.com/586444
+ */
+#define ELF_CLASSIFY(n) \
+static int sb_elf_classify##n(int fd, const struct stat64 *st, const Elf##n##_Ehdr *ehdr) \
+{ \
+	Elf##n##_Phdr *phdr; \
+	int ret = SB_ELF_TRACE; \
+	size_t i; \
+	\
+	if (ehdr->e_phentsize != sizeof(*phdr)) \
+		return SB_ELF_BAD; \
+	phdr = sb_elf_read_alloc(fd, st, (uint64_t)ehdr->e_phnum * sizeof(*phdr), ehdr->e_phoff); \
+	if (!phdr) \
+		return SB_ELF_BAD; \
+	\
+	for (i = 0; i < ehdr->e_phnum; ++i) \
+		if (phdr[i].p_type == PT_INTERP) { \
+			ret = SB_ELF_OK; \
+			break; \
+		} \
+	\
+	free(phdr); \
+	return ret; \
+}
+ELF_CLASSIFY(32)
+ELF_CLASSIFY(64)
+#undef ELF_CLASSIFY
+
+void sb_exec_classify(int fd, const struct stat64 *st, struct sb_exec_info *info)
+{
+	int ret;
+	union {
+		unsigned char e_ident[EI_NIDENT];
+		Elf32_Ehdr e32;
+		Elf64_Ehdr e64;
+	} ehdr;
+
+	memset(info, 0, sizeof(*info));
+	if (!sb_elf_read(fd, st, &ehdr, sizeof(ehdr), 0))
+		return;
+
+	if (ehdr.e_ident[EI_MAG0] != ELFMAG0 ||
+	    ehdr.e_ident[EI_MAG1] != ELFMAG1 ||
+	    ehdr.e_ident[EI_MAG2] != ELFMAG2 ||
+	    ehdr.e_ident[EI_MAG3] != ELFMAG3 ||
+	    (ehdr.e_ident[EI_CLASS] != ELFCLASS32 &&
+	     ehdr.e_ident[EI_CLASS] != ELFCLASS64))
+		return;
+
+	/* The tracer only needs to know the ABI; e_machine is at the same
+	 * offset in the 32 & 64 bit headers.
+	 */
+	info->flags = SB_EXEC_ELF;
+	info->ei_class = ehdr.e_ident[EI_CLASS];
+	info->e_machine = ehdr.e64.e_machine;
+
+	if (ehdr.e_ident[EI_CLASS] == ELFCLASS32)
+		ret = sb_elf_classify32(fd, st, &ehdr.e32);
+	else
+		ret = sb_elf_classify64(fd, st, &ehdr.e64);
+	if (ret == SB_ELF_TRACE)
+		info->flags |= SB_EXEC_TRACE;
+}
@@ -0,0 +1,222 @@
+/*
+ * sb_log.c
+ *
+ * Format the records that go into the sandbox logs, and parse them back.  Both
+ * libsandbox (as it logs things) and the sandbox program (when it decodes a
+ * trace buffer) write these, so they have to agree on the layout.
+ *
+ * Copyright 2026 Gentoo Foundation
+ * Licensed under the GPL-2
+ */
+
+#include "headers.h"
+#include "sbutil.h"
+
+/* Append |len| bytes of |str| as a JSON string to |buf|, and return how many
+ * bytes that took.  If |buf| is NULL, only count them.
+ */
+static size_t sb_log_json_str(char *buf, const char *str, size_t len)
+{
+	static const char hex[] = "0123456789abcdef";
+	size_t i, ret = 0;
+
+#define _PUT(c) do { if (buf) buf[ret] = (c); ++ret; } while (0)
+	_PUT('"');
+	for (i = 0; i < len; ++i) {
+		unsigned char c = str[i];
+		if (c == '"' || c == '\\') {
+			_PUT('\\');
+			_PUT(c);
+		} else if (c < 0x20 || c == 0x7f) {
+			_PUT('\\');
+			_PUT('u');
+			_PUT('0');
+			_PUT('0');
+			_PUT(hex[c >> 4]);
+			_PUT(hex[c & 0xf]);
+		} else
+			_PUT(c);
+	}
+	_PUT('"');
+#undef _PUT
+
+	return ret;
+}
+
+/* Format one log record into |buf| (or just count its size if it's NULL).
+ * Records are one line each, and look like:
+ *  {"version":2,"func":"open_wr","status":"deny","path":"foo",
+ *   "abs_path":"/tmp/foo","canonical_path":"/tmp/foo","pid":123,
+ *   "cmdline":["touch","foo"]}
+ */
+size_t sb_log_format_record(char *buf, const struct sb_log_record *rec)
+{
+	const char * const fields[][2] = {
+		{ "func",           rec->func, },
+		{ "status",         rec->access ? "allow" : "deny", },
+		{ "path",           rec->path, },
+		{ "abs_path",       rec->apath, },
+		{ "canonical_path", rec->rpath, },
+	};
+	char num[64];
+	size_t i, len, ret = 0;
+
+#define _PUTS(str, len) do { if (buf) memcpy(buf + ret, str, len); ret += len; } while (0)
+#define _PUTJ(str, len) (ret += sb_log_json_str(buf ? buf + ret : NULL, str, len))
+	len = sprintf(num, "{\"version\":%s", SB_LOG_JSON_VERSION);
+	_PUTS(num, len);
+	for (i = 0; i < ARRAY_SIZE(fields); ++i) {
+		_PUTS(",", 1);
+		_PUTJ(fields[i][0], strlen(fields[i][0]));
+		_PUTS(":", 1);
+		_PUTJ(fields[i][1], strlen(fields[i][1]));
+	}
+	len = sprintf(num, ",\"pid\":%i", rec->pid);
+	_PUTS(num, len);
+	if (rec->time) {
+		len = sprintf(num, ",\"time\":%" PRIu64, rec->time);
+		_PUTS(num, len);
+	}
+
+	if (rec->cmdline) {
+		/* The args are each NUL terminated. */
+		_PUTS(",\"cmdline\":[", 12);
+		for (i = 0; i < rec->cmdline_len; i += len + 1) {
+			len = strnlen(rec->cmdline + i, rec->cmdline_len - i);
+			if (i)
+				_PUTS(",", 1);
+			_PUTJ(rec->cmdline + i, len);
+		}
+		_PUTS("]", 1);
+	}
+	_PUTS("}\n", 2);
+#undef _PUTJ
+#undef _PUTS
+
+	return ret;
+}
+
+/* Decode the JSON string that |*p| points to in place, and leave |*p| pointing
+ * just past it.  Returns the decoded string, or NULL if it's malformed.  We
+ * only need to handle what libsandbox writes.
+ */
+static char *log_json_str(char **p)
+{
+	char *in = *p, *out, *ret;
+
+	if (*in++ != '"')
+		return NULL;
+	ret = out = in;
+	while (*in != '"') {
+		if (*in == '\0')
+			return NULL;
+		if (*in == '\\') {
+			switch (*++in) {
+			case 'u': {
+				char hex[5];
+				if (strnlen(in + 1, 4) != 4)
+					return NULL;
+				memcpy(hex, in + 1, 4);
+				hex[4] = '\0';
+				*out++ = strtoul(hex, NULL, 16);
+				in += 5;
+				continue;
+			}
+			case 'n': *in = '\n'; break;
+			case 't': *in = '\t'; break;
+			case '\0': return NULL;
+			}
+		}
+		*out++ = *in++;
+	}
+	*p = in + 1;
+	*out = '\0';
+	return ret;
+}
+
+/* Parse a JSON log record in place.  Returns false if |line| isn't a record
+ * we understand (it gets clobbered either way).  The cmdline args get joined
+ * with spaces.
+ */
+bool sb_log_parse_record(char *line, struct sb_log_entry *e)
+{
+	char *cmdline_end = NULL;
+	char *p = line, *key, *val;
+
+	memset(e, 0, sizeof(*e));
+	e->count = 1;
+
+	if (*p++ != '{')
+		return false;
+	while (*p != '}') {
+		if (!(key = log_json_str(&p)) || *p++ != ':')
+			return false;
+
+		if (*p == '"') {
+			if (!(val = log_json_str(&p)))
+				return false;
+			if (!strcmp(key, "func"))
+				e->func = val;
+			else if (!strcmp(key, "status"))
+				e->status = val;
+			else if (!strcmp(key, "path"))
+				e->path = val;
+			else if (!strcmp(key, "abs_path"))
+				e->apath = val;
+			else if (!strcmp(key, "canonical_path"))
+				e->rpath = val;
+		} else if (*p == '[') {
+			/* Join the args with spaces like the old format.  Each
+			 * decoded arg is shorter than the JSON it came from, so
+			 * we can shuffle them down in place.
+			 */
+			++p;
+			while (*p != ']') {
+				size_t len;
+				if (!(val = log_json_str(&p)))
+					return false;
+				if (!strcmp(key, "cmdline")) {
+					if (!e->cmdline)
+						e->cmdline = cmdline_end = val;
+					else
+						*cmdline_end++ = ' ';
+					len = strlen(val);
+					memmove(cmdline_end, val, len);
+					cmdline_end += len;
+				}
+				if (*p == ',')
+					++p;
+				else if (*p != ']')
+					return false;
+			}
+			++p;
+			if (cmdline_end)
+				*cmdline_end = '\0';
+		} else {
+			/* Numbers.  Records that stand for more than one access
+			 * (see the collector) have a "count".
+			 */
+			if (!strcmp(key, "count"))
+				e->count = strtoul(p, NULL, 10);
+			else if (!strcmp(key, "time"))
+				e->time = strtoull(p, NULL, 10);
+			p += strspn(p, "-0123456789");
+		}
+
+		if (*p == ',')
+			++p;
+		else if (*p != '}')
+			return false;
+	}
+	if (!e->func || !e->status)
+		return false;
+	if (!e->path)
+		e->path = "";
+	if (!e->apath)
+		e->apath = "";
+	if (!e->rpath)
+		e->rpath = "";
+	if (!e->cmdline)
+		e->cmdline = "";
+	return true;
+}
@@ -18,6 +18,9 @@ sandbox_method_t parse_sandbox_method(const char *method)
 	if (streq(method, "preload"))
 		return SANDBOX_METHOD_PRELOAD;
 
+	if (streq(method, "landlock"))
+		return SANDBOX_METHOD_LANDLOCK;
+
 	return SANDBOX_METHOD_ANY;
 }
 
@@ -26,6 +29,8 @@ const char *str_sandbox_method(sandbox_method_t method)
 	switch (method) {
 		case SANDBOX_METHOD_PRELOAD:
 			return "preload";
+		case SANDBOX_METHOD_LANDLOCK:
+			return "landlock";
 		case SANDBOX_METHOD_ANY:
 			return "any";
 		default:
@@ -2,7 +2,8 @@
  * Minimal printf implementation that is designed to work without calling back
  * into the C library or libsandbox.  Goes straight to kernel so that this
  * should be usable from anywhere.  All state is on stack, so also avoids
- * signal, threaded, and other fun async behavior.
+ * signal, threaded, and other fun async behavior.  Output is gathered in a
+ * small buffer on the stack, so a message normally takes a single write().
  *
  * The following conversion specifiers are supported:
  *	c - character
@@ -33,7 +34,52 @@
 #define MOD_LONG_T       (1 << 2)
 #define MOD_LONG_LONG_T  (1 << 3)
 
-void sb_vfdprintf(int fd, const char *format, va_list args)
+/* How much sb_fdprintf() buffers before it has to write things out. */
+#define SB_PRINTF_BUF_SIZE 1024
+
+/* Where the output goes: to |fd| via |buf|, or only into |buf| if |fd| is -1.
+ * When only writing to a buffer, |len| keeps counting past |size| so callers
+ * can tell it didn't fit.
+ */
+struct sb_printf_out {
+	int fd;
+	char *buf;
+	size_t size, len;
+};
+
+static void sb_out_flush(struct sb_printf_out *out)
+{
+	if (out->fd != -1 && out->len) {
+		sb_write(out->fd, out->buf, out->len);
+		out->len = 0;
+	}
+}
+
+static void sb_out(struct sb_printf_out *out, const void *data, size_t len)
+{
+	if (out->fd == -1) {
+		if (out->len < out->size) {
+			size_t avail = out->size - out->len;
+			memcpy(out->buf + out->len, data, len < avail ? len : avail);
+		}
+		out->len += len;
+		return;
+	}
+
+	if (out->len + len > out->size) {
+		sb_out_flush(out);
+		if (len > out->size) {
+			sb_write(out->fd, data, len);
+			return;
+		}
+	}
+	memcpy(out->buf + out->len, data, len);
+	out->len += len;
+}
+
+__printf(2, 3) static void sb_outf(struct sb_printf_out *out, const char *format, ...);
+
+static void sb_vout(struct sb_printf_out *out, const char *format, va_list args)
 {
 	const char *fmt = format;
 	const char *format_end = format + strlen(format);
@@ -44,7 +90,7 @@ void sb_vfdprintf(int fd, const char *format, va_list args)
 
 		if (conv != fmt) {
 			size_t out_bytes = (conv ? conv : format_end) - fmt;
-			sb_write(fd, fmt, out_bytes);
+			sb_out(out, fmt, out_bytes);
 			if (!conv)
 				return;
 		}
@@ -59,15 +105,15 @@ void sb_vfdprintf(int fd, const char *format, va_list args)
  eat_more:
 		switch (conv[1]) {
 			default:
-				sb_fdprintf(fd, "{invalid conversion specifier in string: %s}", format);
+				sb_outf(out, "{invalid conversion specifier in string: %s}", format);
 				break;
 
 			case '%':
 				if (modifiers) {
  inv_modifier:
-					sb_fdprintf(fd, "{invalid modifier in string: %s}", format);
+					sb_outf(out, "{invalid modifier in string: %s}", format);
 				}
-				sb_write(fd, conv, 1);
+				sb_out(out, conv, 1);
 				break;
 			case 'l':
 				++conv;
@@ -98,7 +144,7 @@ void sb_vfdprintf(int fd, const char *format, va_list args)
 
 			case 'c': {
 				char c = va_arg(args, int);
-				sb_write(fd, &c, 1);
+				sb_out(out, &c, 1);
 				break;
 			}
 			case 's': {
@@ -107,8 +153,8 @@ void sb_vfdprintf(int fd, const char *format, va_list args)
 					s = "(null)";
 				size_t len = strlen(s);
 				while (len < padding--)
-					sb_write(fd, " ", 1);
-				sb_write(fd, s, len);
+					sb_out(out, " ", 1);
+				sb_out(out, s, len);
 				break;
 			}
 
@@ -125,7 +171,7 @@ void sb_vfdprintf(int fd, const char *format, va_list args)
 					i = va_arg(args, int);
 				u = i;
 				if (i < 0) {
-					sb_write(fd, "-", 1);
+					sb_out(out, "-", 1);
 					u = i * -1;
 				}
  out_uint:
@@ -134,7 +180,7 @@ void sb_vfdprintf(int fd, const char *format, va_list args)
 					buf[idx++] = '0' + (u % 10);
 				} while (u /= 10);
 				while (idx--)
-					sb_write(fd, buf+idx, 1);
+					sb_out(out, buf+idx, 1);
 				break;
 			}
 			case 'u': {
@@ -176,7 +222,7 @@ void sb_vfdprintf(int fd, const char *format, va_list args)
 				buf[idx++] = 'x';
 				buf[idx++] = '0';
 				while (idx--)
-					sb_write(fd, buf+idx, 1);
+					sb_out(out, buf+idx, 1);
 				break;
 			}
 			case 'p': {
@@ -192,6 +238,44 @@ void sb_vfdprintf(int fd, const char *format, va_list args)
 	}
 }
 
+static void sb_outf(struct sb_printf_out *out, const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	sb_vout(out, format, args);
+	va_end(args);
+}
+
+void sb_vfdprintf(int fd, const char *format, va_list args)
+{
+	char buf[SB_PRINTF_BUF_SIZE];
+	struct sb_printf_out out = { .fd = fd, .buf = buf, .size = sizeof(buf), };
+	sb_vout(&out, format, args);
+	sb_out_flush(&out);
+}
+
+/* Like vsnprintf(): returns the length of the full output, even if it had to
+ * be truncated to fit in |size| (including the NUL).
+ */
+size_t sb_vsnprintf(char *buf, size_t size, const char *format, va_list args)
+{
+	struct sb_printf_out out = { .fd = -1, .buf = buf, .size = size, };
+	sb_vout(&out, format, args);
+	if (size)
+		buf[out.len < size ? out.len : size - 1] = '\0';
+	return out.len;
+}
+
+size_t sb_snprintf(char *buf, size_t size, const char *format, ...)
+{
+	size_t ret;
+	va_list args;
+	va_start(args, format);
+	ret = sb_vsnprintf(buf, size, format, args);
+	va_end(args);
+	return ret;
+}
+
 void sb_fdprintf(int fd, const char *format, ...)
 {
 	va_list args;
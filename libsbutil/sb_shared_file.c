@@ -0,0 +1,44 @@
+/*
+ * sb_shared_file.c
+ *
+ * Map the files the sandbox program shares with the processes it runs.
+ *
+ * Copyright 2026 Gentoo Foundation
+ * Licensed under the GPL-2
+ */
+
+#include "headers.h"
+#include "sbutil.h"
+
+/* Map the |size| bytes of the file at |path| with |prot|.  The program being
+ * run could have swapped it out, so only use a file that looks like the sandbox
+ * program made it: a regular file of just that size, which starts with |magic|
+ * & |version| (unless |magic| is 0).  Returns NULL otherwise.
+ */
+void *sb_map_shared_file(const char *path, size_t size, int prot, uint32_t magic, uint32_t version)
+{
+	const uint32_t *hdr;
+	struct stat64 st;
+	void *map = NULL;
+	int fd;
+
+	fd = sbio_open(path, (prot & PROT_WRITE ? O_RDWR : O_RDONLY) | O_CLOEXEC, 0);
+	if (fd == -1)
+		return NULL;
+
+	if (fstat64(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size == size) {
+		map = mmap(NULL, size, prot, MAP_SHARED, fd, 0);
+		if (map == MAP_FAILED)
+			map = NULL;
+		else if (magic) {
+			hdr = map;
+			if (hdr[0] != magic || hdr[1] != version) {
+				munmap(map, size);
+				map = NULL;
+			}
+		}
+	}
+	close(fd);
+
+	return map;
+}
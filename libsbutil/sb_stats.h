@@ -0,0 +1,75 @@
+/*
+ * sb_stats.h
+ *
+ * Layout of the stats file: with SANDBOX_STATS enabled, the sandbox program
+ * creates this file & libsandbox in all of its children map it and count the
+ * checks they make.  Each process takes a slot of its own so they don't fight
+ * over the same cache lines, and the sandbox program adds them all up at the
+ * end.  Once the slots run out, the rest of the processes share the last one
+ * (everything is updated with atomic adds, so that's only slower), so funcs
+ * get claimed with a CAS on their state and only named by whoever won it.
+ *
+ * Copyright 2026 Gentoo Foundation
+ * Licensed under the GPL-2
+ */
+
+#ifndef __SB_STATS_H__
+#define __SB_STATS_H__
+
+#define SB_STATS_MAGIC    0x53425354	/* "SBST" */
+#define SB_STATS_VERSION  3
+
+#define SB_STATS_SLOTS    1024
+#define SB_STATS_FUNCS    128
+/* Check latencies are counted in power of 2 buckets: the first is everything
+ * under 512ns, the last everything from 2^(SB_STATS_BUCKETS + 7)ns (~8ms) up.
+ */
+#define SB_STATS_BUCKETS  16
+#define SB_STATS_BUCKET_MIN_SHIFT 9
+
+/* States of a func entry: the name is only valid once it's named. */
+#define SB_STATS_FUNC_FREE    0
+#define SB_STATS_FUNC_NAMING  1
+#define SB_STATS_FUNC_NAMED   2
+
+struct sb_stats_func {
+	/* Set the first time the func is used; see the states above. */
+	char name[20];
+	uint32_t state;
+	uint64_t calls;
+	/* How the checks turned out.  Predicted also covers other denials
+	 * that don't get logged (e.g. access() probes).
+	 */
+	uint64_t allowed, denied, predicted;
+	/* Execs that found the program in the exec cache. */
+	uint64_t cache_hits;
+	uint64_t ns;		/* Total time spent checking */
+	uint64_t latency[SB_STATS_BUCKETS];
+};
+
+struct sb_stats_slot {
+	int32_t pid;		/* The first process to use it */
+	uint32_t pad;
+	uint64_t trace_stops;	/* Times a tracer woke up */
+	/* How execs were classified (see sb_check_exec()). */
+	uint64_t exec_classify;	/* Programs opened & looked at */
+	uint64_t exec_preload;	/* Run with us preloaded */
+	uint64_t exec_trace;	/* Run under the tracer */
+	uint64_t exec_unchecked;/* Run without either (e.g. set*id) */
+	uint64_t exec_other;	/* Not ELFs (e.g. scripts) */
+	/* Where else the time goes (in ns), and how often. */
+	uint64_t inits, init_ns;	/* Our constructor */
+	uint64_t exec_wrapped, exec_wrapper_ns;	/* Exec wrappers up to the real exec */
+	uint64_t classify_ns;	/* Looking at programs (see exec_classify) */
+	uint64_t pad2;
+	struct sb_stats_func funcs[SB_STATS_FUNCS];
+};
+
+struct sb_stats {
+	uint32_t magic, version;
+	uint32_t slots_used;	/* Slots handed out (can exceed SB_STATS_SLOTS) */
+	uint8_t pad[52];
+	struct sb_stats_slot slots[SB_STATS_SLOTS];
+};
+
+#endif
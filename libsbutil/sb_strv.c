@@ -0,0 +1,78 @@
+/*
+ * sb_strv.c
+ *
+ * NULL terminated string vectors that keep track of their length & size, so
+ * appending is amortized O(1) rather than a walk to the end & a realloc every
+ * time like the str_list macros.
+ *
+ * Copyright 2026 Gentoo Foundation
+ * Licensed under the GPL-2
+ */
+
+#include "headers.h"
+#include "sbutil.h"
+
+/* Make room for |n| more strings (and the terminator). */
+void sb_strv_reserve(struct sb_strv *v, size_t n)
+{
+	size_t size = v->size ? : 8;
+
+	if (v->len + n < v->size)
+		return;
+	while (size <= v->len + n)
+		size *= 2;
+	v->strs = xrealloc(v->strs, sizeof(*v->strs) * size);
+	v->strs[v->len] = NULL;
+	v->size = size;
+}
+
+/* Append |str| itself; it's freed along with the vector. */
+void sb_strv_add(struct sb_strv *v, char *str)
+{
+	sb_strv_reserve(v, 1);
+	v->strs[v->len++] = str;
+	v->strs[v->len] = NULL;
+}
+
+void sb_strv_add_copy(struct sb_strv *v, const char *str)
+{
+	sb_strv_add(v, xstrdup(str));
+}
+
+/* Append all the strings in the NULL terminated |strs| themselves. */
+void sb_strv_add_all(struct sb_strv *v, char * const *strs)
+{
+	size_t n;
+
+	for (n = 0; strs && strs[n]; ++n)
+		continue;
+	if (!n)
+		return;
+	sb_strv_reserve(v, n);
+	memcpy(&v->strs[v->len], strs, sizeof(*strs) * n);
+	v->len += n;
+	v->strs[v->len] = NULL;
+}
+
+static int sb_strv_cmp(const void *a, const void *b)
+{
+	return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+void sb_strv_sort(struct sb_strv *v)
+{
+	if (v->len > 1)
+		qsort(v->strs, v->len, sizeof(*v->strs), sb_strv_cmp);
+}
+
+/* Free the strings & the vector itself. */
+void sb_strv_free(struct sb_strv *v)
+{
+	size_t i;
+
+	for (i = 0; i < v->len; ++i)
+		free(v->strs[i]);
+	free(v->strs);
+	v->strs = NULL;
+	v->len = v->size = 0;
+}
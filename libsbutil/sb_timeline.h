@@ -0,0 +1,61 @@
+/*
+ * sb_timeline.h
+ *
+ * Layout of the timeline buffer: with SANDBOX_TIMELINE set, the sandbox program
+ * creates this file & libsandbox in all of its children record how long the
+ * interesting bits of each check took in it.  Every process grabs page sized
+ * chunks of its own to append its spans to, so the only thing processes share
+ * is the count of chunks handed out.  Once they're all gone, spans are dropped
+ * (and counted), as are those of children sharing their parent's memory
+ * (clone(CLONE_VM)) when the parent has no chunk yet.  The sandbox program
+ * turns the lot into a Chrome trace.
+ *
+ * Copyright 2026 Gentoo Foundation
+ * Licensed under the GPL-2
+ */
+
+#ifndef __SB_TIMELINE_H__
+#define __SB_TIMELINE_H__
+
+#define SB_TIMELINE_MAGIC   0x5342544c	/* "SBTL" */
+#define SB_TIMELINE_VERSION 1
+
+#define SB_TIMELINE_CHUNKS       16384
+#define SB_TIMELINE_CHUNK_SPANS  127
+
+/* What a span covers. */
+#define SB_SPAN_CHECK       0	/* All of before_syscall() */
+#define SB_SPAN_RESOLVE     1	/* resolve_path() */
+#define SB_SPAN_LOG         2	/* write_logfile() */
+#define SB_SPAN_EXEC        3	/* sb_check_exec() */
+#define SB_SPAN_TRACE_WAIT  4	/* The tracer waiting for its next stop */
+#define SB_SPAN_MAX         5
+
+struct sb_timeline_span {
+	/* CLOCK_MONOTONIC ns; 0 until the span is filled in. */
+	uint64_t start;
+	uint32_t dur;		/* In ns (saturates at ~4s) */
+	int32_t tid;
+	uint8_t kind;
+	char name[15];		/* The func, possibly cut short */
+};
+
+struct sb_timeline_chunk {
+	int32_t pid;
+	/* Spans handed out (can exceed SB_TIMELINE_CHUNK_SPANS) */
+	uint32_t used;
+	char comm[16];		/* The program's name */
+	uint8_t pad[8];
+	struct sb_timeline_span spans[SB_TIMELINE_CHUNK_SPANS];
+};
+
+struct sb_timeline {
+	uint32_t magic, version;
+	uint32_t chunks_used;	/* Can exceed SB_TIMELINE_CHUNKS */
+	uint32_t pad;
+	uint64_t dropped;	/* Spans that had nowhere to go */
+	uint8_t pad2[4072];
+	struct sb_timeline_chunk chunks[SB_TIMELINE_CHUNKS];
+};
+
+#endif
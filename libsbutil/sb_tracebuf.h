@@ -0,0 +1,70 @@
+/*
+ * sb_tracebuf.h
+ *
+ * Layout of the trace buffer: with SANDBOX_TRACE enabled, the sandbox program
+ * creates this file & libsandbox in all of its children map it and record
+ * every access they check.  That's far cheaper than writing each one out to
+ * the debug log, so it can be left on for whole builds.
+ *
+ * The buffer holds a ring of fixed size records, and a ring of the strings
+ * (paths, funcs, cmdlines) they refer to.  Strings are interned so that the
+ * same path shows up only once no matter how often it's checked.  Writers
+ * reserve records & string space with atomic adds, so nothing here takes a
+ * lock.  Once either ring wraps, the oldest entries get overwritten.
+ *
+ * Copyright 2026 Gentoo Foundation
+ * Licensed under the GPL-2
+ */
+
+#ifndef __SB_TRACEBUF_H__
+#define __SB_TRACEBUF_H__
+
+#define SB_TRACEBUF_MAGIC    0x53425442	/* "SBTB" */
+#define SB_TRACEBUF_VERSION  2
+
+#define SB_TRACEBUF_RECORDS  (64 * 1024)
+#define SB_TRACEBUF_SLOTS    (256 * 1024)
+#define SB_TRACEBUF_STRINGS  (32 * 1024 * 1024)
+
+struct sb_tracebuf_record {
+	/* 0 while the record is being written, else its index + 1 */
+	uint32_t seq;
+	int32_t pid;
+	int32_t sb_nr;
+	uint8_t access;
+	uint8_t pad[3];
+	uint64_t time;		/* In ns since the epoch */
+	/* Positions of the strings (see below); 0 if there are none. */
+	uint64_t func, path, apath, rpath, cmdline;
+};
+
+struct sb_tracebuf {
+	uint32_t magic, version;
+	uint64_t head;		/* Index of the next record */
+	uint64_t strings_used;	/* Bytes of |strings| handed out, ever */
+	uint8_t pad[40];
+
+	/* Hash table of the strings we've interned so far (0 = unused). */
+	uint64_t slots[SB_TRACEBUF_SLOTS];
+	struct sb_tracebuf_record records[SB_TRACEBUF_RECORDS];
+	/* Each string is a uint32_t length followed by the bytes & a NUL,
+	 * padded out to a multiple of 4.  Strings never straddle the end; the
+	 * space left there is skipped instead.
+	 *
+	 * Strings are referred to by their position counting every byte ever
+	 * handed out, and live at that modulo the size of the ring.  That way
+	 * we know it's been overwritten once more than a ring's worth has been
+	 * handed out after it.  The first string starts after a zero length
+	 * one so 0 can mean "no string".
+	 */
+	char strings[SB_TRACEBUF_STRINGS];
+};
+
+/* How many bytes string |len| takes up in |strings|. */
+#define SB_TRACEBUF_STR_SIZE(len) ((sizeof(uint32_t) + (len) + 1 + 3) & ~(size_t)3)
+
+/* Whether the string at |pos| is still there with |used| bytes handed out. */
+#define SB_TRACEBUF_STR_LIVE(pos, used) \
+	((pos) != 0 && (used) - (pos) <= SB_TRACEBUF_STRINGS)
+
+#endif
@@ -21,12 +21,41 @@
 
 #define LIB_NAME               "libsandbox.so"
 #define BASHRC_NAME            "sandbox.bashrc"
+#define EXEC_HELPER_NAME       "exec-helper"
 #define TMPDIR                 "/tmp"
 #define PORTAGE_TMPDIR         "/var/tmp/portage"
 #define SANDBOX_LOG_LOCATION   "/var/log/sandbox"
+#define SANDBOX_CACHE_LOCATION "/var/cache/sandbox"
 #define LOG_FILE_PREFIX        "/sandbox-"
 #define DEBUG_LOG_FILE_PREFIX  "/sandbox-debug-"
 #define LOG_FILE_EXT           ".log"
+#define EXEC_CACHE_FILE_PREFIX "/sandbox-exec-cache-"
+#define COLLECTOR_FILE_PREFIX  "/sandbox-collector-"
+#define TRACEBUF_FILE_PREFIX   "/sandbox-tracebuf-"
+#define STATS_FILE_PREFIX      "/sandbox-stats-"
+#define TIMELINE_FILE_PREFIX   "/sandbox-timeline-"
+#define CONF_CACHE_FILE        "/conf-cache"
+
+/* Version of the JSON records written to the logs.  The older text format
+ * ("VERSION 1.0" followed by F:/S:/P:/A:/R:/C: lines) is still understood by
+ * the sandbox program when it prints a log.
+ */
+#define SB_LOG_JSON_VERSION    "2"
+
+/* Datagrams libsandbox sends to the sandbox program's collector socket start
+ * with one of these, followed by:
+ *  MSG:   the message text
+ *  LOG:   the func, NUL, the canonical path, NUL, then the log record
+ *  DEBUG: the log record
+ *  EXEC:  nothing, but the program (open for reading) for the exec cache
+ * The sandbox program sends QUIT to tell the collector to finish up; it's
+ * ignored from anyone else.
+ */
+#define SB_COLLECT_MSG         'M'
+#define SB_COLLECT_LOG         'L'
+#define SB_COLLECT_DEBUG       'D'
+#define SB_COLLECT_EXEC        'X'
+#define SB_COLLECT_QUIT        'Q'
 
 #define ENV_LD_PRELOAD         "LD_PRELOAD"
 
@@ -39,6 +68,10 @@
 
 #define ENV_SANDBOX_VERBOSE    "SANDBOX_VERBOSE"
 #define ENV_SANDBOX_DEBUG      "SANDBOX_DEBUG"
+#define ENV_SANDBOX_TRACE      "SANDBOX_TRACE"
+#define ENV_SANDBOX_STATS      "SANDBOX_STATS"
+#define ENV_SANDBOX_TIMELINE   "SANDBOX_TIMELINE"
+#define ENV_SANDBOX_CONF_CACHE "SANDBOX_CONF_CACHE"
 
 #define ENV_SANDBOX_TESTING    "__SANDBOX_TESTING"
 
@@ -46,8 +79,14 @@
 #define ENV_SANDBOX_BASHRC     "SANDBOX_BASHRC"
 #define ENV_SANDBOX_LOG        "SANDBOX_LOG"
 #define ENV_SANDBOX_DEBUG_LOG  "SANDBOX_DEBUG_LOG"
+#define ENV_SANDBOX_LOG_MAX    "SANDBOX_LOG_MAX"
 #define ENV_SANDBOX_MESSAGE_PATH "SANDBOX_MESSAGE_P@TH" /* @ is not a typo */
 #define ENV_SANDBOX_WORKDIR    "SANDBOX_WORKDIR"
+#define ENV_SANDBOX_EXEC_CACHE "SANDBOX_EXEC_CACHE"
+#define ENV_SANDBOX_COLLECTOR  "SANDBOX_COLLECTOR"
+#define ENV_SANDBOX_TRACEBUF   "SANDBOX_TRACEBUF"
+#define ENV_SANDBOX_STATSBUF   "SANDBOX_STATSBUF"
+#define ENV_SANDBOX_TIMELINEBUF "SANDBOX_TIMELINEBUF"
 
 #define ENV_SANDBOX_DENY       "SANDBOX_DENY"
 #define ENV_SANDBOX_READ       "SANDBOX_READ"
@@ -55,6 +94,7 @@
 #define ENV_SANDBOX_PREDICT    "SANDBOX_PREDICT"
 
 #define ENV_SANDBOX_METHOD     "SANDBOX_METHOD"
+#define ENV_SANDBOX_LANDLOCKED "__SANDBOX_LANDLOCKED"
 #define ENV_SANDBOX_ON         "SANDBOX_ON"
 
 #define ENV_SANDBOX_INTRACTV   "SANDBOX_INTRACTV"
@@ -72,6 +112,7 @@ char *get_sandbox_conf(void);
 char *get_sandbox_confd(char *path);
 void get_sandbox_lib(char *path);
 void get_sandbox_rc(char *path);
+void get_sandbox_exec_helper(char *path);
 void get_sandbox_log(char *path, const char *tmpdir);
 void get_sandbox_debug_log(char *path, const char *tmpdir);
 void get_sandbox_message_path(char *path);
@@ -90,6 +131,7 @@ static inline bool is_env_var(const char *env, const char *var, size_t vlen)
 typedef enum sandbox_method_t {
   SANDBOX_METHOD_ANY = 0,
   SANDBOX_METHOD_PRELOAD,
+  SANDBOX_METHOD_LANDLOCK,
 } sandbox_method_t;
 sandbox_method_t parse_sandbox_method(const char *);
 const char *str_sandbox_method(sandbox_method_t);
@@ -102,6 +144,10 @@ const char *sb_get_cmdline(pid_t pid);
 /* libsandbox need to use a wrapper for open */
 attribute_hidden extern int (*sbio_open)(const char *, int, mode_t);
 attribute_hidden extern FILE *(*sbio_popen)(const char *, const char *);
+/* Hand a datagram to the collector; returns false if it has to be written
+ * out directly instead.  NULL when there is no collector.
+ */
+attribute_hidden extern bool (*sbio_collect)(const struct iovec *, int);
 extern const char *sbio_message_path;
 extern const char sbio_fallback_path[];
 /* Convenience functions to reliably open, read and write to a file */
@@ -112,11 +158,47 @@ int sb_close(int fd);
 void sb_close_all_fds(void);
 int sb_copy_file_to_fd(const char *file, int ofd);
 int sb_exists(int dirfd, const char *pathname, int flags);
+void *sb_map_shared_file(const char *path, size_t size, int prot, uint32_t magic, uint32_t version);
+
+/* One record in the (debug) log; see sb_log.c for the format. */
+struct sb_log_record {
+	const char *func, *path, *apath, *rpath;
+	bool access;
+	pid_t pid;
+	uint64_t time;		/* In ns since the epoch, or 0 if unknown */
+	const char *cmdline;	/* The NUL terminated args */
+	size_t cmdline_len;
+};
+size_t sb_log_format_record(char *buf, const struct sb_log_record *rec);
+/* A record parsed back out of a log. */
+struct sb_log_entry {
+	char *func, *status, *path, *apath, *rpath, *cmdline;
+	unsigned long count;
+	unsigned long long time;
+};
+bool sb_log_parse_record(char *line, struct sb_log_entry *e);
+
+/* A string vector that knows its length, so appending doesn't have to walk it.
+ * Start from all zeros; .strs is NULL terminated (once anything is added), so
+ * it can be passed as is to anything wanting an argv or envp.
+ */
+struct sb_strv {
+	char **strs;
+	size_t len, size;
+};
+void sb_strv_reserve(struct sb_strv *v, size_t n);
+void sb_strv_add(struct sb_strv *v, char *str);
+void sb_strv_add_copy(struct sb_strv *v, const char *str);
+void sb_strv_add_all(struct sb_strv *v, char * const *strs);
+void sb_strv_sort(struct sb_strv *v);
+void sb_strv_free(struct sb_strv *v);
 
 /* Reliable output */
 __printf(1, 2) void sb_printf(const char *format, ...);
 __printf(2, 3) void sb_fdprintf(int fd, const char *format, ...);
 __printf(2, 0) void sb_vfdprintf(int fd, const char *format, va_list args);
+__printf(3, 4) size_t sb_snprintf(char *buf, size_t size, const char *format, ...);
+__printf(3, 0) size_t sb_vsnprintf(char *buf, size_t size, const char *format, va_list args);
 __printf(3, 4) void sb_efunc(const char *color, const char *hilight, const char *format, ...);
 __printf(1, 2) void sb_einfo(const char *format, ...);
 __printf(1, 2) void sb_ewarn(const char *format, ...);
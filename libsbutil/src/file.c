@@ -10,7 +10,6 @@
 
 #include "headers.h"
 #include "rcscripts/rcutil.h"
-#include "rcscripts/util/str_list.h"
 
 bool
 rc_file_exists (const char *pathname)
@@ -77,7 +76,7 @@ rc_ls_dir (const char *pathname, bool hidden, bool sort)
 {
   DIR *dp;
   struct dirent64 *dir_entry;
-  char **dirlist = NULL;
+  struct sb_strv dirlist = {};
 
   if (!check_arg_str (pathname))
     return NULL;
@@ -128,29 +127,25 @@ rc_ls_dir (const char *pathname, bool hidden, bool sort)
 	      goto error;
 	    }
 
-	  if (sort)
-	    str_list_add_item_sorted (dirlist, str_ptr, error);
-	  else
-	    str_list_add_item (dirlist, str_ptr, error);
+	  sb_strv_add (&dirlist, str_ptr);
 	}
     }
   while (NULL != dir_entry);
 
-  if (!check_strv (dirlist))
-    {
-      if (NULL != dirlist)
-	str_list_free (dirlist);
+  /* Sort once we have them all, rather than as we go */
+  if (sort)
+    sb_strv_sort (&dirlist);
 
-      DBG_MSG ("Directory '%s' is empty.\n", pathname);
-    }
+  if (0 == dirlist.len)
+    DBG_MSG ("Directory '%s' is empty.\n", pathname);
 
   closedir (dp);
 
-  return dirlist;
+  return dirlist.strs;
 
 error:
   /* Free dirlist on error */
-  str_list_free (dirlist);
+  sb_strv_free (&dirlist);
 
   if (NULL != dp)
       closedir (dp);
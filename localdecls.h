@@ -125,6 +125,7 @@ typedef struct user_regs_struct trace_regs;
 	extern __typeof (_name) _aliasname __attribute__ ((weak, alias (#_name)));
 
 #define attribute_hidden __attribute__((visibility("hidden")))
+#define attribute_tls_ie __attribute__((tls_model("initial-exec")))
 
 #define likely(x)   __builtin_expect(!!(x), 1)
 #define unlikely(x) __builtin_expect(!!(x), 0)
@@ -1,3 +1,63 @@
+function attr_error(msg)
+{
+	printf("gen_symbol_header.awk: %s: %s\n", SYMBOLS[COUNT], msg) > "/dev/stderr";
+	exit(1);
+}
+
+# Turn one trace=... layout into the arg numbers of its { dirfd, path, flags }.
+function parse_trace(spec,    n)
+{
+	if (spec ~ /^DCF[0-9]+:[0-9]+$/) {
+		sub(/^DCF/, "", spec);
+		split(spec, n, ":");
+		return "{ " n[1] ", " (n[1] + 1) ", " n[2] " }";
+	} else if (spec ~ /^DC[0-9]+$/) {
+		sub(/^DC/, "", spec);
+		return "{ " spec ", " (spec + 1) ", 0 }";
+	} else if (spec ~ /^C[0-9]+$/) {
+		sub(/^C/, "", spec);
+		return "{ 0, " spec ", 0 }";
+	}
+	attr_error("bad trace layout " spec);
+}
+
+# Parse the attributes after the ":" into the rest of an sb_nr_attrs[]
+# initializer (after the name).
+function parse_attrs(fields, nfields,    i, flags, trace, specs, nspecs, j)
+{
+	flags = "";
+	trace = "";
+	for (i = 1; i <= nfields && fields[i] != ":"; ++i)
+		continue;
+	for (++i; i <= nfields; ++i) {
+		if (fields[i] == "read")
+			flags = flags " | SB_ATTR_READ";
+		else if (fields[i] == "write")
+			flags = flags " | SB_ATTR_WRITE";
+		else if (fields[i] == "exec")
+			flags = flags " | SB_ATTR_EXEC";
+		else if (fields[i] == "nofollow")
+			flags = flags " | SB_ATTR_NOFOLLOW";
+		else if (fields[i] == "nofollow?")
+			flags = flags " | SB_ATTR_NOFOLLOW_FLAG";
+		else if (fields[i] ~ /^trace=/) {
+			nspecs = split(substr(fields[i], 7), specs, ",");
+			if (nspecs > 2)
+				attr_error("too many trace layouts");
+			for (j = 1; j <= nspecs; ++j)
+				trace = trace (j > 1 ? ", " : "") parse_trace(specs[j]);
+		} else
+			attr_error("unknown attribute " fields[i]);
+	}
+
+	if (flags == "" && trace == "")
+		return "";
+	flags = flags == "" ? "0" : substr(flags, 4);
+	if (trace == "")
+		return ", " flags;
+	return ", " flags ", { " trace " }";
+}
+
 # Read the symbols list and create regexs to use for processing readelf output.
 BEGIN {
 	COUNT = 0;
@@ -6,10 +66,11 @@ BEGIN {
 	while ((getline line < SYMBOLS_FILE) > 0) {
 		if (line ~ /^ *#/ || line ~ /^$/)
 			continue;
-		split(line, fields);
+		nfields = split(line, fields);
 		symbol = fields[1];
 
 		SYMBOLS[++COUNT] = symbol;
+		ATTRS[COUNT] = parse_attrs(fields, nfields);
 		if (sym_regex)
 			sym_regex = sym_regex "|";
 		sym_regex = sym_regex symbol;
@@ -96,6 +157,19 @@ BEGIN {
 }
 
 END {
+	# The attributes go in a header of their own, so that programs that aren't
+	# libsandbox can use them too (see libsandbox/policy.c).
+	if (MODE == "attrs") {
+		printf("/* The SB_NR_* values of defined symbols index this directly, while\n");
+		printf(" * undefined ones use (SB_NR_UNDEF - SB_NR_*); see sb_nr_attrs_get().\n");
+		printf(" */\n");
+		printf("const struct sb_nr_attrs sb_nr_attrs[SB_NR_MAX + 1] = {\n");
+		for (i = 1; i <= COUNT; ++i)
+			printf("\t[%i] = { \"%s\"%s },\n", i, SYMBOLS[i], ATTRS[i]);
+		printf("};\n");
+		exit;
+	}
+
 	printf("#ifndef __symbols_h\n");
 	printf("#define __symbols_h\n\n");
 
@@ -203,5 +277,8 @@ END {
 
 	printf("#define SB_MAX_STRING_LEN %i\n\n", SB_MAX_STRING_LEN);
 
+	# The size of sb_nr_attrs[] (MODE=attrs above).
+	printf("#define SB_NR_MAX %i\n\n", COUNT);
+
 	printf("#endif /* __symbols_h */\n");
 }
@@ -1,12 +1,12 @@
 # Read the symbols list and create regexs to use for processing readelf output.
-function read_symbols() {
-	COUNT = 0;
-	while ((getline line < SYMBOLS_FILE) > 0) {
+function read_symbols(file) {
+	while ((getline line < file) > 0) {
 		if (line ~ /^ *#/ || line ~ /^$/)
 			continue;
 		nfields = split(line, fields);
 		symbol = fields[1];
-		syscall = nfields > 1 ? fields[2] : symbol;
+		# Attributes (after a ":") are for gen_symbol_header.awk.
+		syscall = (nfields > 1 && fields[2] != ":") ? fields[2] : symbol;
 
 		c = ++COUNT
 		SYMBOLS[c] = symbol;
@@ -15,7 +15,11 @@ function read_symbols() {
 }
 
 BEGIN {
-	read_symbols();
+	COUNT = 0;
+	read_symbols(SYMBOLS_FILE);
+	# Syscalls the tracer follows but which have no wrapper.
+	if (TRACE_SYMBOLS_FILE)
+		read_symbols(TRACE_SYMBOLS_FILE);
 
 	if (MODE == "gen") {
 		for (x in SYSCALLS) {
@@ -25,15 +29,48 @@ BEGIN {
 	}
 }
 
+# Evaluate the preprocessed syscall number.  These are plain numbers, or sums
+# of them when the ABI uses a syscall base (e.g. "(0x40000000 + 2)").
+function eval_nr(val,    terms, i, n, t, ret, d)
+{
+	gsub(/[() \t]/, "", val);
+	n = split(val, terms, "+");
+	ret = 0;
+	for (i = 1; i <= n; ++i) {
+		t = terms[i];
+		sub(/[uUlL]+$/, "", t);
+		if (t ~ /^0[xX][0-9a-fA-F]+$/) {
+			d = 0;
+			t = tolower(substr(t, 3));
+			while (t != "") {
+				d = d * 16 + index("0123456789abcdef", substr(t, 1, 1)) - 1;
+				t = substr(t, 2);
+			}
+			ret += d;
+		} else if (t ~ /^[0-9]+$/) {
+			ret += t;
+		} else {
+			printf("gen_trace_header.awk: unable to parse syscall number: %s\n", val) > "/dev/stderr";
+			exit(1);
+		}
+	}
+	return ret;
+}
+
+# The entries are indexed by (syscall number - base) in the tables, so work out
+# the base before we write anything out.
 function out(name, syscall, val)
 {
 	uname = toupper(name)
 	syscall_define = "SB_SYS" syscall_prefix "_" uname
-	print "#define " syscall_define " " val;
-	if (name == syscall)
-		print "S(" uname ")";
-	else
-		print "{ " syscall_define ", SB_NR_" uname ", \"" uname "\" },";
+	DEFINES = DEFINES "#define " syscall_define " " val "\n";
+	if (val == "SB_NR_UNDEF")
+		return;
+
+	nr = eval_nr(val);
+	if (!ENTRY_COUNT++ || nr < BASE)
+		BASE = nr;
+	ENTRIES = ENTRIES "S(" uname ")\n";
 }
 
 {
@@ -68,5 +105,9 @@ END {
 			if (!FOUND[x])
 				out(SYMBOLS[x], SYSCALLS[x], "SB_NR_UNDEF");
 		}
+
+		print "#define SB_SYS" syscall_prefix "_BASE " (ENTRY_COUNT ? BASE : 0);
+		printf("%s", DEFINES);
+		printf("%s", ENTRIES);
 	}
 }
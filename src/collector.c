@@ -0,0 +1,460 @@
+/*
+ * collector.c
+ *
+ * Collect the messages & log records libsandbox in all of our children sends
+ * us (see libsandbox/collector.c), and write them out ourselves.  We run it as
+ * a separate process so that the main sandbox process can keep on waiting for
+ * its child like it always has.
+ *
+ * Violations are deduplicated: the first time we see a (function, path) pair,
+ * the record goes straight into the log (so it's there while the sandbox is
+ * still running), and repeats are only counted.  When we're done, we go back
+ * and add the counts to those records.  So that a build hitting lots of
+ * different paths can't eat up all our memory, only so many are remembered.
+ *
+ * We're also the only ones who write to the exec cache: children send us the
+ * programs they had to look at themselves, and we look at them again before
+ * adding them (see libsandbox/exec_cache.c).
+ *
+ * Copyright 2026 Gentoo Foundation
+ * Licensed under the GPL-2
+ */
+
+#include "headers.h"
+#include "sbutil.h"
+#include "sandbox.h"
+#include "sb_exec_cache.h"
+
+/* Bigger than any datagram the kernel will let libsandbox send by default. */
+#define COLLECTOR_BUF_SIZE (256 * 1024)
+#define COLLECTOR_BUCKETS  1024
+/* Past this many different violations, the rest go into the log uncounted. */
+#define COLLECTOR_MAX_VIOLATIONS (64 * 1024)
+
+struct violation {
+	struct violation *hash_next, *next;
+	char *key;		/* func, NUL, canonical path */
+	size_t key_len;
+	char *record;
+	size_t record_len;
+	off_t offset;		/* Where it is in the log, or -1 */
+	unsigned long count;
+};
+
+static int collector_fd = -1;
+static pid_t collector_pid;
+static struct violation *buckets[COLLECTOR_BUCKETS];
+static struct violation *violations, **violations_tail = &violations;
+static size_t num_violations;
+static struct sb_exec_cache_entry *exec_cache;
+
+/* Create the socket before we set up the environment so its path can be
+ * passed down.  It's only an optimization, so carry on without it if we
+ * can't set it up.
+ */
+void collector_setup(struct sandbox_info_t *sandbox_info)
+{
+	struct sockaddr_un sun = { .sun_family = AF_UNIX, };
+	char *path = sandbox_info->sandbox_collector;
+
+	if (snprintf(path, SB_PATH_MAX, "%s%s%d", sandbox_info->tmp_dir,
+	             COLLECTOR_FILE_PREFIX, getpid()) >= sizeof(sun.sun_path)) {
+		/* Too long for a socket; fall back to direct writes quietly. */
+		path[0] = '\0';
+		return;
+	}
+	strcpy(sun.sun_path, path);
+
+	collector_fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (collector_fd == -1)
+		goto error;
+	unlink(path);
+	if (bind(collector_fd, (void *)&sun, sizeof(sun)))
+		goto error;
+	if (!share_with_children(sandbox_info, path, true))
+		goto error;
+	/* So we can tell the sandbox program from its children (see QUIT). */
+	if (setsockopt(collector_fd, SOL_SOCKET, SO_PASSCRED, &(int){1}, sizeof(int)))
+		goto error;
+	return;
+
+ error:
+	sb_pwarn("could not create collector socket: %s", path);
+	if (collector_fd != -1) {
+		close(collector_fd);
+		collector_fd = -1;
+	}
+	path[0] = '\0';
+}
+
+/* Append |len| bytes to |path|, and note where they went in |offset|. */
+static bool collector_append(const char *path, const char *data, size_t len, off_t *offset)
+{
+	struct stat st;
+	bool ret = false;
+	int fd;
+
+	fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_NOFOLLOW | O_CLOEXEC,
+		S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if (fd == -1) {
+		sb_pwarn("unable to append log file: %s", path);
+		return false;
+	}
+	if (fstat(fd, &st) || !S_ISREG(st.st_mode)) {
+		sb_warn("SECURITY BREACH: '%s' already exists and is not a regular file!", path);
+		close(fd);
+		return false;
+	}
+	if (sb_write(fd, data, len) == len) {
+		if (offset)
+			*offset = lseek(fd, 0, SEEK_CUR) - len;
+		ret = true;
+	}
+	close(fd);
+	return ret;
+}
+
+static bool collector_log(const char *log, char *data, size_t len)
+{
+	struct violation *v;
+	const char *end = data + len, *path;
+	size_t key_len, hash = 2166136261u;
+	size_t i;
+
+	/* Records arrive as: func, NUL, canonical path, NUL, JSON record. */
+	path = memchr(data, '\0', len);
+	if (!path || !(path = memchr(path + 1, '\0', end - path - 1)))
+		return false;
+	key_len = path + 1 - data;
+
+	for (i = 0; i < key_len; ++i)
+		hash = (hash ^ (unsigned char)data[i]) * 16777619u;
+	hash %= COLLECTOR_BUCKETS;
+
+	for (v = buckets[hash]; v; v = v->hash_next)
+		if (v->key_len == key_len && !memcmp(v->key, data, key_len)) {
+			++v->count;
+			return true;
+		}
+
+	if (num_violations == COLLECTOR_MAX_VIOLATIONS)
+		return collector_append(log, path + 1, end - path - 1, NULL);
+	++num_violations;
+
+	v = xzalloc(sizeof(*v));
+	v->key = xmalloc(len);
+	memcpy(v->key, data, len);
+	v->key_len = key_len;
+	v->record = v->key + key_len;
+	v->record_len = len - key_len;
+	v->offset = -1;
+	v->count = 1;
+	v->hash_next = buckets[hash];
+	buckets[hash] = v;
+	*violations_tail = v;
+	violations_tail = &v->next;
+
+	return collector_append(log, v->record, v->record_len, &v->offset);
+}
+
+/* Go back over the log & add a "count" to the records that we saw more than
+ * once.  Anything else in there (e.g. records written directly by processes
+ * that couldn't reach us) is left as-is.
+ */
+static void collector_write_counts(const char *log)
+{
+	struct violation *v;
+	struct stat st;
+	char *data, *tmp;
+	size_t len, pos;
+	FILE *fp;
+	int fd;
+
+	for (v = violations; v; v = v->next)
+		if (v->count > 1)
+			break;
+	if (!v)
+		return;
+
+	fd = open(log, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+	if (fd == -1)
+		return;
+	if (fstat(fd, &st) || !S_ISREG(st.st_mode)) {
+		close(fd);
+		return;
+	}
+	data = xmalloc(st.st_size);
+	len = sb_read(fd, data, st.st_size);
+	close(fd);
+	if (len == -1)
+		goto out;
+
+	xasprintf(&tmp, "%s.tmp", log);
+	fp = fopen(tmp, "we");
+	if (!fp) {
+		sb_pwarn("unable to rewrite log file: %s", log);
+		goto out_tmp;
+	}
+
+	pos = 0;
+	for (v = violations; v; v = v->next) {
+		size_t end;
+
+		if (v->count == 1 || v->offset < 0 || (size_t)v->offset < pos)
+			continue;
+		end = v->offset + v->record_len;
+		/* Make sure it's still our record, then slip the count in
+		 * before the closing "}\n".
+		 */
+		if (end > len || v->record_len < 2 ||
+		    memcmp(data + v->offset, v->record, v->record_len))
+			continue;
+		fwrite(data + pos, 1, end - 2 - pos, fp);
+		fprintf(fp, ",\"count\":%lu}\n", v->count);
+		pos = end;
+	}
+	fwrite(data + pos, 1, len - pos, fp);
+
+	if (fclose(fp) || rename(tmp, log)) {
+		sb_pwarn("unable to rewrite log file: %s", log);
+		unlink(tmp);
+	}
+
+ out_tmp:
+	free(tmp);
+ out:
+	free(data);
+}
+
+static void collector_map_exec_cache(const char *path)
+{
+	void *map;
+	int fd;
+
+	if (!path[0])
+		return;
+	fd = open(path, O_RDWR | O_NOFOLLOW | O_CLOEXEC);
+	if (fd == -1)
+		return;
+	map = mmap(NULL, SB_EXEC_CACHE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map != MAP_FAILED)
+		exec_cache = map;
+	close(fd);
+}
+
+/* Add the program open on |fd| to the exec cache. */
+static bool collector_exec(int fd)
+{
+	struct sb_exec_cache_entry *e;
+	struct sb_exec_info info;
+	struct stat64 st, after;
+	uint32_t seq;
+	size_t i, idx;
+
+	if (!exec_cache || fd == -1)
+		return false;
+
+	/* Don't trust anything the sender worked out: look at it ourselves,
+	 * and make sure it didn't change while we did.
+	 */
+	if (fstat64(fd, &st) || !S_ISREG(st.st_mode))
+		return false;
+	sb_exec_classify(fd, &st, &info);
+	if (fstat64(fd, &after) ||
+	    after.st_size != st.st_size ||
+	    after.st_ctim.tv_sec != st.st_ctim.tv_sec ||
+	    after.st_ctim.tv_nsec != st.st_ctim.tv_nsec)
+		return false;
+
+	/* Take the first unused entry, else evict the first one we'd look at.
+	 * With --server, other collectors write to it too.
+	 */
+	idx = sb_exec_cache_hash(&st);
+	e = &exec_cache[idx];
+	for (i = 0; i < SB_EXEC_CACHE_PROBES; ++i) {
+		struct sb_exec_cache_entry *p = &exec_cache[(idx + i) % SB_EXEC_CACHE_ENTRIES];
+		if (p->seq == 0) {
+			e = p;
+			break;
+		}
+	}
+
+	/* If someone else is writing it, let them have it. */
+	seq = e->seq;
+	if ((seq & 1) || !__sync_bool_compare_and_swap(&e->seq, seq, seq + 1))
+		return true;
+	__sync_synchronize();
+
+	e->info = info;
+	e->dev = st.st_dev;
+	e->ino = st.st_ino;
+	e->size = st.st_size;
+	e->mtime = st.st_mtim.tv_sec;
+	e->mtime_nsec = st.st_mtim.tv_nsec;
+	e->ctime = st.st_ctim.tv_sec;
+	e->ctime_nsec = st.st_ctim.tv_nsec;
+
+	__sync_synchronize();
+	e->seq = (seq + 2) ? : 2;
+	return true;
+}
+
+static void collector_main(const struct sandbox_info_t *sandbox_info)
+{
+	int sigs[] = { SIGHUP, SIGINT, SIGQUIT, SIGTERM, SIGUSR1, };
+	size_t i;
+	ssize_t len;
+	char *buf;
+
+	/* The sandbox program tells us when to stop. */
+	for (i = 0; i < ARRAY_SIZE(sigs); ++i)
+		signal(sigs[i], SIG_IGN);
+#if defined(HAVE_PRCTL) && defined(PR_SET_PDEATHSIG)
+	prctl(PR_SET_PDEATHSIG, SIGKILL);
+#endif
+
+	collector_map_exec_cache(sandbox_info->sandbox_exec_cache);
+
+	buf = xmalloc(COLLECTOR_BUF_SIZE);
+	while (1) {
+		union {
+			struct cmsghdr align;
+			char buf[CMSG_SPACE(sizeof(int)) + CMSG_SPACE(sizeof(struct ucred))];
+		} control;
+		struct iovec iov = {
+			.iov_base = buf,
+			.iov_len = COLLECTOR_BUF_SIZE,
+		};
+		struct msghdr msg = {
+			.msg_iov = &iov,
+			.msg_iovlen = 1,
+			.msg_control = control.buf,
+			.msg_controllen = sizeof(control.buf),
+		};
+		struct cmsghdr *cmsg;
+		struct ucred cred = { .pid = 0, };
+		bool handled = true;
+		int fd = -1;
+
+		len = recvmsg(collector_fd, &msg, MSG_TRUNC | MSG_CMSG_CLOEXEC);
+		if (len == -1) {
+			if (errno == EINTR)
+				continue;
+			sb_pwarn("collector failed");
+			break;
+		}
+
+		/* Senders pass along an fd to tell when we're done (LOG), or
+		 * the program to look at (EXEC).  Don't hold onto any more.
+		 * The kernel tells us who they are.
+		 */
+		for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+			if (cmsg->cmsg_level == SOL_SOCKET &&
+			    cmsg->cmsg_type == SCM_RIGHTS) {
+				int *fds = (int *)CMSG_DATA(cmsg);
+				size_t nfds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+
+				for (i = 0; i < nfds; ++i)
+					if (fd == -1)
+						fd = fds[i];
+					else
+						close(fds[i]);
+			} else if (cmsg->cmsg_level == SOL_SOCKET &&
+			           cmsg->cmsg_type == SCM_CREDENTIALS &&
+			           cmsg->cmsg_len == CMSG_LEN(sizeof(cred)))
+				memcpy(&cred, CMSG_DATA(cmsg), sizeof(cred));
+
+		/* If we can't handle it, don't ack it: the sender will write it
+		 * out itself.
+		 */
+		if (len == 0 || len > COLLECTOR_BUF_SIZE || (msg.msg_flags & MSG_CTRUNC))
+			handled = false;
+		else switch (buf[0]) {
+		case SB_COLLECT_QUIT:
+			/* Only the sandbox program (our parent) gets to stop us;
+			 * anything in the sandbox could send this.
+			 */
+			if (cred.pid == getppid())
+				goto done;
+			handled = false;
+			break;
+		case SB_COLLECT_MSG:
+			sb_write(STDERR_FILENO, buf + 1, len - 1);
+			break;
+		case SB_COLLECT_LOG:
+			handled = collector_log(sandbox_info->sandbox_log, buf + 1, len - 1);
+			break;
+		case SB_COLLECT_DEBUG:
+			handled = collector_append(sandbox_info->sandbox_debug_log, buf + 1, len - 1, NULL);
+			break;
+		case SB_COLLECT_EXEC:
+			/* Nothing to ack: the fd is the program. */
+			collector_exec(fd);
+			handled = false;
+			break;
+		default:
+			handled = false;
+			break;
+		}
+
+		if (fd != -1) {
+			if (handled)
+				send(fd, "", 1, MSG_NOSIGNAL | MSG_DONTWAIT);
+			close(fd);
+		}
+	}
+
+ done:
+	collector_write_counts(sandbox_info->sandbox_log);
+	_exit(0);
+}
+
+void collector_start(const struct sandbox_info_t *sandbox_info)
+{
+	if (collector_fd == -1)
+		return;
+
+	collector_pid = fork();
+	if (collector_pid == 0)
+		collector_main(sandbox_info);
+	else if (collector_pid == -1) {
+		sb_pwarn("could not start the collector");
+		/* Make sure the children can't queue up messages nobody reads;
+		 * they'll notice & write things out themselves.
+		 */
+		unlink(sandbox_info->sandbox_collector);
+	}
+
+	/* Only the collector keeps the socket open, so if it goes away, the
+	 * children get refused rather than blocking on a full queue.
+	 */
+	close(collector_fd);
+	collector_fd = -1;
+}
+
+/* Wait for the collector to write out everything it has been sent. */
+void collector_stop(const struct sandbox_info_t *sandbox_info)
+{
+	struct sockaddr_un sun = { .sun_family = AF_UNIX, };
+	char quit = SB_COLLECT_QUIT;
+	int fd;
+
+	if (collector_pid <= 0)
+		return;
+
+	/* Datagrams are delivered in order, so the collector will have handled
+	 * everything that came before this.
+	 */
+	strcpy(sun.sun_path, sandbox_info->sandbox_collector);
+	fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (fd == -1 || sendto(fd, &quit, 1, 0, (void *)&sun, sizeof(sun)) != 1) {
+		sb_pwarn("could not stop the collector");
+		kill(collector_pid, SIGKILL);
+	}
+	if (fd != -1)
+		close(fd);
+	waitpid(collector_pid, NULL, 0);
+	collector_pid = 0;
+
+	unlink(sandbox_info->sandbox_collector);
+}
@@ -0,0 +1,469 @@
+/*
+ * config.c
+ *
+ * Load sandbox.conf & sandbox.d/.  Each file is parsed once into the list of
+ * assignments in it (in order, as the last one wins), and all the lookups walk
+ * those rather than going back to the files.  The lists are also saved to a
+ * compiled cache keyed by the sizes & mtimes of the files, and of sandbox.d/
+ * itself so files coming & going are noticed.  That way, the runs after the
+ * first one (portage starts one per phase) only have to stat the files.
+ *
+ * Copyright 2026 Gentoo Foundation
+ * Licensed under the GPL-2
+ */
+
+#include "headers.h"
+#include "sbutil.h"
+#include "sandbox.h"
+
+struct conf_entry {
+	const char *key;
+	/* NULL for a bare `key=`, which unsets it. */
+	const char *value;
+};
+
+struct conf_file {
+	const char *path;
+	/* What stat said when we parsed it; size is -1 if it didn't exist. */
+	int64_t size, mtime_sec, mtime_nsec;
+	const struct conf_entry *entries;
+	uint32_t nentries;
+};
+
+/* sandbox.conf, sandbox.d/ (which has no entries), then the files in it. */
+#define CONF_FILE 0
+#define CONFD_DIR 1
+static struct conf_file *conf_files;
+static size_t conf_nfiles;
+
+/* The cache: a header, the files, all their entries, then the strings, which
+ * everything else refers to by offset.
+ */
+#define CONF_CACHE_MAGIC   0x53424346	/* "SBCF" */
+#define CONF_CACHE_VERSION 1
+#define CONF_CACHE_MAX     (16 * 1024 * 1024)
+#define CONF_CACHE_NULL    UINT32_MAX
+
+struct conf_cache_hdr {
+	uint32_t magic, version;
+	uint32_t nfiles, nentries, strings_size;
+};
+
+struct conf_cache_file {
+	int64_t size, mtime_sec, mtime_nsec;
+	uint32_t path, nentries;
+};
+
+struct conf_cache_entry {
+	uint32_t key, value;
+};
+
+static void conf_stat(struct conf_file *f)
+{
+	struct stat64 st;
+
+	if (stat64(f->path, &st)) {
+		f->size = -1;
+		f->mtime_sec = f->mtime_nsec = 0;
+	} else {
+		f->size = st.st_size;
+		f->mtime_sec = st.st_mtim.tv_sec;
+		f->mtime_nsec = st.st_mtim.tv_nsec;
+	}
+}
+
+/* This handles simple 'entry="bar"' type variables, the same way the config
+ * used to be read: everything up to the first '=' is the key, and the value is
+ * the first non-empty run of chars between quotes.
+ */
+static void conf_parse_line(char *line, struct conf_entry *e)
+{
+	char *token;
+
+	/* Strip leading spaces/tabs */
+	line += strspn(line, " \t");
+	e->key = strsep(&line, "=");
+
+	do
+		token = strsep(&line, "\"'");
+	while (token && !token[0]);
+	e->value = token;
+}
+
+static void conf_parse(struct conf_file *f)
+{
+	struct conf_entry *entries = NULL;
+	size_t nentries = 0, len = 0;
+	char *buf, *line, *next;
+	struct stat64 st;
+	ssize_t ret;
+	int fd;
+
+	/* Stat first, so if it changes while we read it, the next run will
+	 * notice the cache is stale.
+	 */
+	conf_stat(f);
+	if (f->size <= 0)
+		return;
+
+	/* If it is not a file or symlink pointing to a file, skip it */
+	fd = open(f->path, O_RDONLY|O_CLOEXEC|O_NONBLOCK);
+	if (fd == -1)
+		return;
+	if (fstat64(fd, &st) || !S_ISREG(st.st_mode)) {
+		close(fd);
+		return;
+	}
+	buf = xmalloc(f->size + 1);
+	while (len < (size_t)f->size) {
+		ret = read(fd, buf + len, f->size - len);
+		if (ret <= 0)
+			break;
+		len += ret;
+	}
+	close(fd);
+	buf[len] = '\0';
+
+	for (line = buf; line; line = next) {
+		next = strchr(line, '\n');
+		if (next)
+			*next++ = '\0';
+
+		entries = xrealloc(entries, sizeof(*entries) * (nentries + 1));
+		conf_parse_line(line, &entries[nentries]);
+		/* None of the keys we look up are empty or comments. */
+		if (entries[nentries].key[0] && entries[nentries].key[0] != '#')
+			++nentries;
+	}
+
+	/* The entries point into the buffer, so it stays. */
+	f->entries = entries;
+	f->nentries = nentries;
+}
+
+static char *conf_cache_path(void)
+{
+	static char path[SB_PATH_MAX];
+	const char *env = getenv(ENV_SANDBOX_CONF_CACHE);
+	char dir[SB_PATH_MAX], *slash;
+	struct stat st;
+
+	if (env) {
+		if (!env[0] || strlen(env) >= sizeof(path))
+			return NULL;
+		strcpy(path, env);
+	} else {
+		/* In another sandbox (which only happens when testing), its
+		 * policy says where we may write, so only cache where we're
+		 * told to.
+		 */
+		if (getenv(ENV_SANDBOX_ACTIVE))
+			return NULL;
+
+		/* Not in $TMPDIR: builds get to write there, and one running
+		 * as root could leave a policy of its own for the next run.
+		 * Only root can write to this dir, and libsandbox denies
+		 * writes to it like it does to the log dir.  So only root
+		 * launches (like portage's) get cached by default.
+		 */
+		if (geteuid() != 0)
+			return NULL;
+		if (mkdir(SANDBOX_CACHE_LOCATION, 0755) && errno != EEXIST)
+			return NULL;
+		strcpy(path, SANDBOX_CACHE_LOCATION CONF_CACHE_FILE);
+	}
+
+	/* Whoever can write to the dir can swap the cache for theirs. */
+	strcpy(dir, path);
+	slash = strrchr(dir, '/');
+	if (!slash)
+		strcpy(dir, ".");
+	else
+		slash[slash == dir] = '\0';
+	if (stat(dir, &st) || !S_ISDIR(st.st_mode) ||
+	    (st.st_uid != 0 && st.st_uid != geteuid()) ||
+	    (st.st_mode & (S_IWGRP|S_IWOTH)))
+		return NULL;
+	return path;
+}
+
+/* Load the cache into conf_files[], as long as it's ours & looks sane.  The
+ * strings are used straight from it, so it's never freed once it's loaded.
+ */
+static bool conf_cache_load(const char *path)
+{
+	const struct conf_cache_hdr *hdr;
+	const struct conf_cache_file *cfiles;
+	const struct conf_cache_entry *centries;
+	struct conf_entry *entries;
+	const char *strings;
+	struct stat64 st;
+	size_t i, e, n, size;
+	char *buf = NULL;
+	ssize_t ret;
+	int fd;
+
+	fd = open(path, O_RDONLY|O_CLOEXEC|O_NOFOLLOW|O_NONBLOCK);
+	if (fd == -1)
+		return false;
+	if (fstat64(fd, &st) || !S_ISREG(st.st_mode) || st.st_uid != geteuid() ||
+	    (st.st_mode & (S_IWGRP|S_IWOTH)) || st.st_size < (off64_t)sizeof(*hdr) ||
+	    st.st_size > CONF_CACHE_MAX)
+		goto fail;
+
+	size = st.st_size;
+	buf = xmalloc(size);
+	ret = read(fd, buf, size);
+	if (ret != (ssize_t)size)
+		goto fail;
+
+	hdr = (const void *)buf;
+	if (hdr->magic != CONF_CACHE_MAGIC || hdr->version != CONF_CACHE_VERSION ||
+	    hdr->nfiles <= CONFD_DIR || hdr->nfiles > CONF_CACHE_MAX ||
+	    hdr->nentries > CONF_CACHE_MAX || hdr->strings_size == 0 ||
+	    size != sizeof(*hdr) + hdr->nfiles * sizeof(*cfiles) +
+	            hdr->nentries * sizeof(*centries) + hdr->strings_size)
+		goto fail;
+
+	cfiles = (const void *)(hdr + 1);
+	centries = (const void *)(cfiles + hdr->nfiles);
+	strings = (const void *)(centries + hdr->nentries);
+	/* Then every string ends in the cache, wherever it starts. */
+	if (strings[hdr->strings_size - 1])
+		goto fail;
+
+#define conf_cache_str(off) ((off) < hdr->strings_size ? strings + (off) : NULL)
+
+	conf_files = xzalloc(sizeof(*conf_files) * hdr->nfiles);
+	entries = xmalloc(sizeof(*entries) * (hdr->nentries ? : 1));
+	for (i = 0, e = 0; i < hdr->nfiles; ++i) {
+		struct conf_file *f = &conf_files[i];
+
+		f->path = conf_cache_str(cfiles[i].path);
+		f->size = cfiles[i].size;
+		f->mtime_sec = cfiles[i].mtime_sec;
+		f->mtime_nsec = cfiles[i].mtime_nsec;
+		f->entries = &entries[e];
+		f->nentries = cfiles[i].nentries;
+		if (!f->path || f->nentries > hdr->nentries - e)
+			goto fail_files;
+
+		for (n = 0; n < f->nentries; ++n, ++e) {
+			entries[e].key = conf_cache_str(centries[e].key);
+			entries[e].value = centries[e].value == CONF_CACHE_NULL ?
+				NULL : conf_cache_str(centries[e].value);
+			if (!entries[e].key ||
+			    (!entries[e].value && centries[e].value != CONF_CACHE_NULL))
+				goto fail_files;
+		}
+	}
+	if (e != hdr->nentries)
+		goto fail_files;
+#undef conf_cache_str
+
+	conf_nfiles = hdr->nfiles;
+	close(fd);
+	return true;
+
+ fail_files:
+	free(entries);
+	free(conf_files);
+	conf_files = NULL;
+ fail:
+	free(buf);
+	close(fd);
+	return false;
+}
+
+/* Whether the cache is for the files we'd read, and none of them changed. */
+static bool conf_cache_fresh(const char *conf, const char *confd)
+{
+	struct conf_file now;
+	size_t i;
+
+	if (strcmp(conf_files[CONF_FILE].path, conf) ||
+	    strcmp(conf_files[CONFD_DIR].path, confd))
+		return false;
+
+	for (i = 0; i < conf_nfiles; ++i) {
+		now.path = conf_files[i].path;
+		conf_stat(&now);
+		if (now.size != conf_files[i].size ||
+		    now.mtime_sec != conf_files[i].mtime_sec ||
+		    now.mtime_nsec != conf_files[i].mtime_nsec)
+			return false;
+	}
+
+	return true;
+}
+
+/* A file changed again within the same mtime tick (and to the same size) would
+ * look unchanged, so hold off on caching ones that were only just written.
+ */
+static bool conf_settled(void)
+{
+	time_t now = time(NULL);
+	size_t i;
+
+	for (i = 0; i < conf_nfiles; ++i)
+		if (conf_files[i].size != -1 && conf_files[i].mtime_sec >= now - 1)
+			return false;
+	return true;
+}
+
+struct conf_cache_strings {
+	char *data;
+	size_t len;
+};
+
+static uint32_t conf_cache_add_str(struct conf_cache_strings *strings, const char *str)
+{
+	size_t off = strings->len, len;
+
+	if (!str)
+		return CONF_CACHE_NULL;
+	len = strlen(str) + 1;
+	strings->data = xrealloc(strings->data, off + len);
+	memcpy(strings->data + off, str, len);
+	strings->len += len;
+	return off;
+}
+
+/* Best effort: whatever goes wrong, we just parse the files again next time. */
+static void conf_cache_save(const char *path)
+{
+	struct conf_cache_hdr hdr = {
+		.magic = CONF_CACHE_MAGIC,
+		.version = CONF_CACHE_VERSION,
+		.nfiles = conf_nfiles,
+	};
+	struct conf_cache_file *cfiles;
+	struct conf_cache_entry *centries = NULL;
+	struct conf_cache_strings strings = { NULL, 0 };
+	char tmp[SB_PATH_MAX];
+	size_t i, n;
+	bool ok;
+	int fd;
+
+	cfiles = xzalloc(sizeof(*cfiles) * conf_nfiles);
+	for (i = 0; i < conf_nfiles; ++i) {
+		const struct conf_file *f = &conf_files[i];
+
+		cfiles[i].size = f->size;
+		cfiles[i].mtime_sec = f->mtime_sec;
+		cfiles[i].mtime_nsec = f->mtime_nsec;
+		cfiles[i].path = conf_cache_add_str(&strings, f->path);
+		cfiles[i].nentries = f->nentries;
+
+		centries = xrealloc(centries, sizeof(*centries) * (hdr.nentries + f->nentries + 1));
+		for (n = 0; n < f->nentries; ++n, ++hdr.nentries) {
+			centries[hdr.nentries].key = conf_cache_add_str(&strings, f->entries[n].key);
+			centries[hdr.nentries].value = conf_cache_add_str(&strings, f->entries[n].value);
+		}
+	}
+	hdr.strings_size = strings.len;
+
+	if (snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path) >= sizeof(tmp))
+		goto done;
+	fd = mkstemp(tmp);
+	if (fd == -1)
+		goto done;
+	ok = write(fd, &hdr, sizeof(hdr)) == sizeof(hdr) &&
+	     write(fd, cfiles, sizeof(*cfiles) * hdr.nfiles) == sizeof(*cfiles) * hdr.nfiles &&
+	     write(fd, centries, sizeof(*centries) * hdr.nentries) == sizeof(*centries) * hdr.nentries &&
+	     write(fd, strings.data, hdr.strings_size) == hdr.strings_size;
+	/* Replace the old one in one go, as other runs might be reading it. */
+	if (close(fd) || !ok || rename(tmp, path))
+		unlink(tmp);
+
+ done:
+	free(strings.data);
+	free(centries);
+	free(cfiles);
+}
+
+static void conf_load(void)
+{
+	static char confd[SB_PATH_MAX];
+	const char *conf, *cache;
+	char **confd_files;
+	size_t i, n;
+
+	if (conf_files)
+		return;
+
+	conf = get_sandbox_conf();
+	get_sandbox_confd(confd);
+	cache = conf_cache_path();
+	if (cache) {
+		if (conf_cache_load(cache)) {
+			if (conf_cache_fresh(conf, confd))
+				return;
+			/* The strings stay, but they're only a few KiB. */
+			free((void *)conf_files[0].entries);
+			free(conf_files);
+			conf_files = NULL;
+		}
+	}
+
+	confd_files = rc_ls_dir(confd, false, true);
+	for (n = 0; confd_files && confd_files[n]; ++n)
+		continue;
+
+	conf_nfiles = CONFD_DIR + 1 + n;
+	conf_files = xzalloc(sizeof(*conf_files) * conf_nfiles);
+	conf_files[CONF_FILE].path = conf;
+	conf_files[CONFD_DIR].path = confd;
+	for (i = 0; i < n; ++i)
+		conf_files[CONFD_DIR + 1 + i].path = confd_files[i];
+
+	conf_parse(&conf_files[CONF_FILE]);
+	conf_stat(&conf_files[CONFD_DIR]);
+	for (i = CONFD_DIR + 1; i < conf_nfiles; ++i)
+		conf_parse(&conf_files[i]);
+
+	if (cache && conf_settled())
+		conf_cache_save(cache);
+}
+
+/* The value of |key| in sandbox.conf, following bash's rules: the last one
+ * wins, and `key=` unsets it.
+ */
+const char *sb_conf_get(const char *key)
+{
+	const struct conf_file *f;
+	const char *value = NULL;
+	size_t i;
+
+	conf_load();
+	f = &conf_files[CONF_FILE];
+	for (i = 0; i < f->nentries; ++i)
+		if (!strcmp(f->entries[i].key, key))
+			value = f->entries[i].value;
+	return value;
+}
+
+/* Append every value of |key| in sandbox.conf (or all the files in sandbox.d/
+ * when |confd| is set) to |buf|, separated by ':'.
+ */
+int sb_conf_append(rc_dynbuf_t *buf, const char *key, bool confd)
+{
+	const struct conf_file *f;
+	size_t first, last, i, e;
+
+	conf_load();
+	first = confd ? CONFD_DIR + 1 : CONF_FILE;
+	last = confd ? conf_nfiles : CONF_FILE + 1;
+	for (i = first; i < last; ++i) {
+		f = &conf_files[i];
+		for (e = 0; e < f->nentries; ++e) {
+			if (!f->entries[e].value || strcmp(f->entries[e].key, key))
+				continue;
+			if (rc_dynbuf_sprintf(buf, buf->wr_index ? ":%s" : "%s",
+			                      f->entries[e].value) == -1)
+				return -1;
+		}
+	}
+
+	return 0;
+}
@@ -78,32 +78,22 @@ error:
 	return NULL;
 }
 
-static char *sb_conf_file(void)
-{
-	static char *conf_file;
-	if (!conf_file)
-		conf_file = get_sandbox_conf();
-	return conf_file;
-}
-
 /* Get passed variable from sandbox.conf, and set it in the environment. */
-static void setup_cfg_var(const char *env_var)
+void setup_cfg_var(const char *env_var)
 {
-	char *config;
+	const char *config;
 
 	/* We check if the variable is set in the environment, and if not, we
 	 * get it from sandbox.conf, and if they exist, we just add them to the
 	 * environment if not already present. */
-	config = rc_get_cnf_entry(sb_conf_file(), env_var, NULL);
-	if (NULL != config) {
+	config = sb_conf_get(env_var);
+	if (NULL != config)
 		setenv(env_var, config, 0);
-		free(config);
-	}
 }
 
 bool sb_get_cnf_bool(const char *key, bool default_val)
 {
-	const char *val = rc_get_cnf_entry(sb_conf_file(), key, NULL);
+	const char *val = sb_conf_get(key);
 	return val ? is_val_on(val) : default_val;
 }
 
@@ -112,57 +102,26 @@ bool sb_get_cnf_bool(const char *key, bool default_val)
 static int setup_access_var(const char *access_var)
 {
 	rc_dynbuf_t *env_data;
-  	int count = 0;
-	char confd_path[SB_PATH_MAX];
-	char *config;
-	char **confd_files = NULL;
-	bool use_confd = true;
 
 	env_data = rc_dynbuf_new();
 
 	/* Now get the defaults for the access variable from sandbox.conf.
 	 * These do not get overridden via the environment. */
-	config = rc_get_cnf_entry(sb_conf_file(), access_var, ":");
-	if (NULL != config) {
-		if (-1 == rc_dynbuf_write(env_data, config, strlen(config)))
-			goto error;
-		free(config);
-		config = NULL;
-	}
+	if (-1 == sb_conf_append(env_data, access_var, false))
+		goto error;
 	/* Append whatever might be already set.  If anything is set, we do
 	 * not process the sandbox.d/ files for this variable. */
 	if (NULL != getenv(access_var)) {
-		use_confd = false;
 		if (-1 == rc_dynbuf_sprintf(env_data, env_data->wr_index ? ":%s" : "%s",
 					  getenv(access_var)))
 			goto error;
+	} else {
+		/* Now scan the files in sandbox.d/ if the access variable was
+		 * not alreay set. */
+		if (-1 == sb_conf_append(env_data, access_var, true))
+			goto error;
 	}
 
-	if (!use_confd)
-		goto done;
-
-	/* Now scan the files in sandbox.d/ if the access variable was not
-	 * alreay set. */
-	confd_files = rc_ls_dir(get_sandbox_confd(confd_path), false, true);
-	if (NULL != confd_files) {
-		while (NULL != confd_files[count]) {
-			config = rc_get_cnf_entry(confd_files[count], access_var, ":");
-			if (NULL != config) {
-				if (-1 == rc_dynbuf_sprintf(env_data,
-							  env_data->wr_index ? ":%s" : "%s",
-							  config))
-					goto error;
-				free(config);
-				config = NULL;
-			}
-			count++;
-		}
-
-		str_list_free(confd_files);
-		confd_files = NULL;
-	}
-
-done:
 	if (env_data->wr_index > 0) {
 	  	char *subst;
 
@@ -180,10 +139,6 @@ done:
 
 error:
 	rc_dynbuf_free(env_data);
-	if (NULL != config)
-		free(config);
-	if (NULL != confd_files)
-		str_list_free(confd_files);
 
 	return -1;
 }
@@ -220,7 +175,7 @@ static int setup_cfg_vars(struct sandbox_info_t *sandbox_info)
 	return 0;
 }
 
-static void sb_setenv(char ***envp, const char *name, const char *val)
+static void sb_setenv(struct sb_strv *envp, const char *name, const char *val)
 {
 	char *tmp_string;
 
@@ -230,13 +185,7 @@ static void sb_setenv(char ***envp, const char *name, const char *val)
 	snprintf(tmp_string, strlen(name) + strlen(val) + 2,
 		 "%s=%s", name, val);
 
-	str_list_add_item((*envp), tmp_string, error);
-
-	return;
-
- error:
-	sb_pwarn("out of memory");
-	exit(EXIT_FAILURE);
+	sb_strv_add(envp, tmp_string);
 }
 
 /* We setup the environment child side only to prevent issues with
@@ -245,7 +194,7 @@ char **setup_environ(struct sandbox_info_t *sandbox_info, bool interactive)
 {
 	int have_ld_preload = 0;
 
-	char **new_environ = NULL;
+	struct sb_strv new_environ = {};
 	char **env_ptr;
 	char *ld_preload_envvar = NULL;
 	char *orig_ld_preload_envvar = NULL;
@@ -262,9 +211,15 @@ char **setup_environ(struct sandbox_info_t *sandbox_info, bool interactive)
 	unsetenv(ENV_SANDBOX_LOG);
 	unsetenv(ENV_SANDBOX_DEBUG_LOG);
 	unsetenv(ENV_SANDBOX_MESSAGE_PATH);
+	unsetenv(ENV_SANDBOX_EXEC_CACHE);
+	unsetenv(ENV_SANDBOX_COLLECTOR);
+	unsetenv(ENV_SANDBOX_TRACEBUF);
+	unsetenv(ENV_SANDBOX_STATSBUF);
+	unsetenv(ENV_SANDBOX_TIMELINEBUF);
 	unsetenv(ENV_SANDBOX_WORKDIR);
 	unsetenv(ENV_SANDBOX_ACTIVE);
 	unsetenv(ENV_SANDBOX_INTRACTV);
+	unsetenv(ENV_SANDBOX_LANDLOCKED);
 	unsetenv(ENV_BASH_ENV);
 
 	orig_ld_preload_envvar = getenv(ENV_LD_PRELOAD);
@@ -296,6 +251,16 @@ char **setup_environ(struct sandbox_info_t *sandbox_info, bool interactive)
 	sb_setenv(&new_environ, ENV_SANDBOX_LOG, sandbox_info->sandbox_log);
 	sb_setenv(&new_environ, ENV_SANDBOX_DEBUG_LOG, sandbox_info->sandbox_debug_log);
 	sb_setenv(&new_environ, ENV_SANDBOX_MESSAGE_PATH, sandbox_info->sandbox_message_path);
+	if (sandbox_info->sandbox_exec_cache[0])
+		sb_setenv(&new_environ, ENV_SANDBOX_EXEC_CACHE, sandbox_info->sandbox_exec_cache);
+	if (sandbox_info->sandbox_collector[0])
+		sb_setenv(&new_environ, ENV_SANDBOX_COLLECTOR, sandbox_info->sandbox_collector);
+	if (sandbox_info->sandbox_tracebuf[0])
+		sb_setenv(&new_environ, ENV_SANDBOX_TRACEBUF, sandbox_info->sandbox_tracebuf);
+	if (sandbox_info->sandbox_stats[0])
+		sb_setenv(&new_environ, ENV_SANDBOX_STATSBUF, sandbox_info->sandbox_stats);
+	if (sandbox_info->sandbox_timeline[0])
+		sb_setenv(&new_environ, ENV_SANDBOX_TIMELINEBUF, sandbox_info->sandbox_timeline);
 	/* Is this an interactive session? */
 	if (interactive)
 		sb_setenv(&new_environ, ENV_SANDBOX_INTRACTV, "1");
@@ -325,9 +290,11 @@ char **setup_environ(struct sandbox_info_t *sandbox_info, bool interactive)
 	sb_setenv(&new_environ, ENV_SANDBOX_ACTIVE, SANDBOX_ACTIVE);
 
 	/* Now add the rest */
-	env_ptr = environ;
 	size_t vlen = strlen(ENV_LD_PRELOAD);
-	while (NULL != *env_ptr) {
+	for (env_ptr = environ; *env_ptr; ++env_ptr)
+		continue;
+	sb_strv_reserve(&new_environ, env_ptr - environ);
+	for (env_ptr = environ; *env_ptr; ++env_ptr) {
 		if ((1 == have_ld_preload) && is_env_var(*env_ptr, ENV_LD_PRELOAD, vlen))
 			/* If LD_PRELOAD was set, and this is it in the original
 			 * environment, replace it with our new copy */
@@ -336,21 +303,11 @@ char **setup_environ(struct sandbox_info_t *sandbox_info, bool interactive)
 			sb_setenv(&new_environ, ENV_LD_PRELOAD,
 					ld_preload_envvar);
 		else
-		  	str_list_add_item_copy(new_environ, (*env_ptr), error);
-
-		env_ptr++;
+			sb_strv_add_copy(&new_environ, *env_ptr);
 	}
 
 	if (NULL != ld_preload_envvar)
 		free(ld_preload_envvar);
 
-	return new_environ;
-
-error:
-	if (NULL != new_environ)
-		str_list_free(new_environ);
-	if (NULL != ld_preload_envvar)
-		free(ld_preload_envvar);
-
-	return NULL;
+	return new_environ.strs;
 }
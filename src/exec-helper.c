@@ -0,0 +1,31 @@
+/*
+ * exec-helper.c
+ *
+ * Run a program on behalf of libsandbox.
+ *
+ * Programs that need to be traced have the tracer set up by libsandbox in the
+ * process that execs them.  That can't happen when that process belongs to
+ * someone else, like a posix_spawn() or vfork() child sharing its parent's
+ * memory.  Those get pointed at us instead: libsandbox is preloaded into us
+ * like any other program, so our exec sets up the tracing from a process of
+ * our own.
+ *
+ * Usage: exec-helper <path> [argv0 [args...]]
+ *
+ * Copyright 2026 Gentoo Foundation
+ * Licensed under the GPL-2
+ */
+
+#include "headers.h"
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <path> [argv0 [args...]]\n", argv[0]);
+		return 127;
+	}
+
+	execv(argv[1], argv + 2);
+	fprintf(stderr, "%s: %s: %s\n", argv[0], argv[1], strerror(errno));
+	return 127;
+}
@@ -7,8 +7,18 @@ bin_PROGRAMS += %D%/sandbox
 
 %C%_sandbox_LDADD = libsbutil/libsbutil.la $(LIBDL)
 %C%_sandbox_SOURCES = \
+	%D%/collector.c \
+	%D%/config.c \
 	%D%/environ.c \
+	%D%/log.c \
 	%D%/namespaces.c \
 	%D%/options.c \
 	%D%/sandbox.h \
-	%D%/sandbox.c
+	%D%/sandbox.c \
+	%D%/server.c \
+	%D%/stats.c \
+	%D%/timeline.c \
+	%D%/tracebuf.c
+
+pkglibexec_PROGRAMS = %D%/exec-helper
+%C%_exec_helper_SOURCES = %D%/exec-helper.c
@@ -0,0 +1,199 @@
+/*
+ * log.c
+ *
+ * Print the sandbox log in readable form.  A misbehaving build can hit the
+ * same denial tens of thousands of times, so rather than dumping the whole
+ * thing back out, we read it a line at a time and group the records by
+ * (function, canonical path, cmdline), showing each group once with a count.
+ * Only a bounded number of groups & examples are kept around, so this works
+ * no matter how big the log got.
+ *
+ * Copyright 2026 Gentoo Foundation
+ * Licensed under the GPL-2
+ */
+
+#include "headers.h"
+#include "sbutil.h"
+#include "sandbox.h"
+
+/* How many distinct groups we keep track of; the rest are only counted. */
+#define LOG_GROUPS_MAX   1024
+#define LOG_BUCKETS      256
+/* How much of each example we keep. */
+#define LOG_EXAMPLE_MAX  4096
+
+struct log_group {
+	struct log_group *hash_next, *next;
+	uint64_t hash;
+	char *key;		/* The func, rpath & cmdline, each NUL terminated */
+	unsigned long count;
+	char *first, *last;	/* The examples in readable form */
+};
+
+/* Print a record in the same layout as the old text records. */
+static void print_log_entry(FILE *out, const struct sb_log_entry *e)
+{
+	fprintf(out, "\nF: %s\nS: %s\nP: %s\nA: %s\nR: %s\nC: %s\n",
+		e->func, e->status, e->path, e->apath, e->rpath, e->cmdline);
+	if (e->count > 1)
+		fprintf(out, "N: %lu\n", e->count);
+	/* Records decoded from the trace buffer say when they happened. */
+	if (e->time)
+		fprintf(out, "T: %llu.%09llu\n", e->time / 1000000000, e->time % 1000000000);
+}
+
+bool print_log_record(FILE *out, char *line)
+{
+	struct sb_log_entry e;
+
+	if (!sb_log_parse_record(line, &e))
+		return false;
+	print_log_entry(out, &e);
+	return true;
+}
+
+/* Render |e| (minus its count) for keeping as an example. */
+static char *log_example(struct sb_log_entry *e)
+{
+	char *text = NULL;
+	size_t len;
+	FILE *out;
+
+	out = open_memstream(&text, &len);
+	if (!out)
+		sb_perr("out of memory (log)");
+	e->count = 1;
+	print_log_entry(out, e);
+	fclose(out);
+
+	if (len > LOG_EXAMPLE_MAX)
+		strcpy(text + LOG_EXAMPLE_MAX - 5, "...\n");
+	return text;
+}
+
+static uint64_t log_hash(uint64_t hash, const char *str)
+{
+	/* Include the NUL so the fields can't run into each other. */
+	do
+		hash = (hash ^ (unsigned char)*str) * 0x100000001b3ull;
+	while (*str++);
+	return hash;
+}
+
+/* The hash only narrows things down; make sure it's really the same group. */
+static bool log_group_match(const struct log_group *g, const struct sb_log_entry *e)
+{
+	const char *fields[] = { e->func, e->rpath, e->cmdline, };
+	const char *key = g->key;
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(fields); ++i) {
+		if (strcmp(key, fields[i]))
+			return false;
+		key += strlen(key) + 1;
+	}
+	return true;
+}
+
+static char *log_group_key(const struct sb_log_entry *e)
+{
+	size_t func_len = strlen(e->func) + 1, rpath_len = strlen(e->rpath) + 1;
+	size_t cmdline_len = strlen(e->cmdline) + 1;
+	char *key = xmalloc(func_len + rpath_len + cmdline_len);
+
+	memcpy(key, e->func, func_len);
+	memcpy(key + func_len, e->rpath, rpath_len);
+	memcpy(key + func_len + rpath_len, e->cmdline, cmdline_len);
+	return key;
+}
+
+/* The log is a mix of JSON records (one per line) written by current versions
+ * of libsandbox and the "VERSION 1.0" text written by older ones (e.g. in a
+ * multilib or chroot setup).  Show them all in the text layout.
+ */
+void print_sandbox_log(const char *sandbox_log)
+{
+	struct log_group *buckets[LOG_BUCKETS] = {}, *groups = NULL, **tail = &groups;
+	struct log_group *g;
+	unsigned long ngroups = 0, hidden = 0;
+	struct sb_log_entry e;
+	char *line = NULL;
+	size_t size = 0;
+	ssize_t len;
+	uint64_t hash;
+	FILE *fp;
+
+	fp = fopen(sandbox_log, "re");
+	if (!fp) {
+		sb_pwarn("could not open log file: %s", sandbox_log);
+		return;
+	}
+
+	sb_eerror("----------------------- SANDBOX ACCESS VIOLATION SUMMARY -----------------------\n");
+	sb_eerror("LOG FILE: \"%s\"\n", sandbox_log);
+	sb_eerror("\n");
+
+	while ((len = getline(&line, &size, fp)) != -1) {
+		if (len && line[len - 1] == '\n')
+			line[--len] = '\0';
+
+		/* Old style records go straight out. */
+		if (line[0] != '{') {
+			sb_eraw("%s\n", line);
+			continue;
+		}
+		if (!sb_log_parse_record(line, &e)) {
+			sb_eraw("%s\n", line);
+			continue;
+		}
+
+		hash = log_hash(0xcbf29ce484222325ull, e.func);
+		hash = log_hash(hash, e.rpath);
+		hash = log_hash(hash, e.cmdline);
+		for (g = buckets[hash % LOG_BUCKETS]; g; g = g->hash_next)
+			if (g->hash == hash && log_group_match(g, &e))
+				break;
+
+		if (g) {
+			g->count += e.count;
+			free(g->last);
+			g->last = log_example(&e);
+		} else if (ngroups < LOG_GROUPS_MAX) {
+			g = xzalloc(sizeof(*g));
+			g->hash = hash;
+			g->key = log_group_key(&e);
+			g->count = e.count;
+			g->first = log_example(&e);
+			g->hash_next = buckets[hash % LOG_BUCKETS];
+			buckets[hash % LOG_BUCKETS] = g;
+			*tail = g;
+			tail = &g->next;
+			++ngroups;
+		} else
+			hidden += e.count;
+	}
+	free(line);
+	if (ferror(fp))
+		sb_pwarn("could not read log file: %s", sandbox_log);
+	fclose(fp);
+
+	while (groups) {
+		g = groups;
+		groups = g->next;
+
+		sb_eraw("%s", g->first);
+		if (g->count > 1)
+			sb_eraw("N: %lu\n", g->count);
+		if (g->last && strcmp(g->first, g->last))
+			sb_eraw("Last seen as:%s", g->last);
+
+		free(g->key);
+		free(g->first);
+		free(g->last);
+		free(g);
+	}
+	if (hidden)
+		sb_eraw("\n(%lu more accesses not shown)\n", hidden);
+
+	sb_eerror("--------------------------------------------------------------------------------\n");
+}
@@ -22,6 +22,8 @@ int opt_use_ns_user = -1;
 int opt_use_ns_uts = -1;
 bool opt_use_bash = false;
 int opt_debug = -1;
+const char *opt_server = NULL;
+const char *opt_connect = NULL;
 
 static const struct {
 	const char *name;
@@ -107,6 +109,11 @@ static struct option const long_opts[] = {
 	{"help",          no_argument, NULL, 'h'},
 	{"version",       no_argument, NULL, 'V'},
 	{"run-configure", no_argument, NULL, 0x800},
+	{"print-log",     a_argument,  NULL, 0x801},
+	{"dump-trace",    a_argument,  NULL, 0x802},
+	{"stats",         no_argument, NULL, 0x803},
+	{"server",        a_argument,  NULL, 0x804},
+	{"connect",       a_argument,  NULL, 0x805},
 	{NULL,            no_argument, NULL, 0x0}
 };
 static const char * const opts_help[] = {
@@ -135,6 +142,11 @@ static const char * const opts_help[] = {
 	"Print this help and exit",
 	"Print version and exit",
 	"Run local sandbox configure in same way and exit (developer only)",
+	"Print a sandbox log file in readable form and exit",
+	"Print a trace buffer (see SANDBOX_TRACE) in readable form and exit",
+	"Show how many checks were made & how long they took (see SANDBOX_STATS)",
+	"Set up once, then run the programs sent to this socket in sandboxes",
+	"Run the program in a sandbox of the server on this socket",
 	NULL
 };
 
@@ -204,10 +216,15 @@ static void run_configure(int argc, char *argv[])
 
 void parseargs(int argc, char *argv[])
 {
-	int i;
+	const char *ns_opt = NULL;
+	int i, idx;
 
-	while ((i = getopt_long(argc, argv, PARSE_FLAGS, long_opts, NULL)) != -1) {
+	while ((i = getopt_long(argc, argv, PARSE_FLAGS, long_opts, &idx)) != -1) {
 		switch (i) {
+		case 0:
+			/* A flag (the --ns-* ones) that getopt set for us. */
+			ns_opt = long_opts[idx].name;
+			break;
 		case 'c':
 			opt_use_bash = true;
 			break;
@@ -223,6 +240,21 @@ void parseargs(int argc, char *argv[])
 			show_usage(0);
 		case 0x800:
 			run_configure(argc, argv);
+		case 0x801:
+			print_sandbox_log(optarg);
+			exit(0);
+		case 0x802:
+			dump_tracebuf(optarg);
+			exit(0);
+		case 0x803:
+			opt_stats = true;
+			break;
+		case 0x804:
+			opt_server = optarg;
+			break;
+		case 0x805:
+			opt_connect = optarg;
+			break;
 		case '?':
 			show_usage(1);
 		default:
@@ -230,5 +262,15 @@ void parseargs(int argc, char *argv[])
 		}
 	}
 
+	/* The server set up the namespaces for all of its sandboxes already;
+	 * the rest of the options go along with the request.
+	 */
+	if (opt_connect) {
+		if (opt_server)
+			sb_err("--server & --connect don't go together");
+		if (ns_opt)
+			sb_err("--%s has to be given to the --server", ns_opt);
+	}
+
 	read_config();
 }
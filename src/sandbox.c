@@ -14,6 +14,7 @@
 #include "headers.h"
 #include "sbutil.h"
 #include "sandbox.h"
+#include "sb_exec_cache.h"
 
 /* The C library might have a macro for this. */
 #undef dprintf
@@ -23,6 +24,7 @@ static int print_debug = 0;
 #define dputs(str) do { if (print_debug) puts(str); } while (0)
 int (*sbio_open)(const char *, int, mode_t) = (void *)open;
 FILE *(*sbio_popen)(const char *, const char *) = popen;
+bool (*sbio_collect)(const struct iovec *, int);
 
 volatile static int stop_called = 0;
 volatile static pid_t child_pid = 0;
@@ -32,7 +34,81 @@ static const char sandbox_footer[] = "------------------------------------------
 const char *sbio_message_path;
 const char sbio_fallback_path[] = "/dev/stderr";
 
-static int setup_sandbox(struct sandbox_info_t *sandbox_info, bool interactive)
+/* Let the children at a file (or socket) we made for them, but nobody else.
+ * Normally they run as us, but with userpriv, they don't run as root like we
+ * do.  They do have to be able to write to the tmp dir though, so give it to
+ * whoever owns that, or when they only get to read it, its group.
+ */
+bool share_with_children(const struct sandbox_info_t *sandbox_info, const char *path,
+                         bool writable)
+{
+	struct stat st;
+
+	if (geteuid() != 0)
+		return chmod(path, 0600) == 0;
+	if (stat(sandbox_info->tmp_dir, &st))
+		return false;
+	if (!writable)
+		return chown(path, -1, st.st_gid) == 0 && chmod(path, 0640) == 0;
+	return chown(path, st.st_uid, st.st_gid) == 0 && chmod(path, 0660) == 0;
+}
+
+/* Create the file of |size| bytes (named |prefix| & our pid, in the tmp dir)
+ * that the processes we run will map, and map it so it can be set up.  Most of
+ * it is never touched, so it's left sparse.  Returns NULL if that fails (with
+ * |path| set to what it tried).
+ */
+void *create_shared_file(const struct sandbox_info_t *sandbox_info, char *path,
+                         const char *prefix, size_t size, bool writable)
+{
+	void *map = NULL;
+	int fd;
+
+	if (snprintf(path, SB_PATH_MAX, "%s%s%d", sandbox_info->tmp_dir,
+	             prefix, getpid()) >= SB_PATH_MAX) {
+		errno = ENAMETOOLONG;
+		return NULL;
+	}
+	unlink(path);
+	fd = open(path, O_RDWR|O_CREAT|O_EXCL|O_NOFOLLOW|O_CLOEXEC, 0600);
+	if (fd == -1)
+		return NULL;
+	if (ftruncate(fd, size) == 0 &&
+	    share_with_children(sandbox_info, path, writable)) {
+		map = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+		if (map == MAP_FAILED)
+			map = NULL;
+	}
+	save_errno();
+	close(fd);
+	if (!map)
+		unlink(path);
+	restore_errno();
+	return map;
+}
+
+/* Generate the exec cache path -- libsandbox in all of our children maps this
+ * so they only have to inspect a given program once.  It's only an
+ * optimization, so carry on without it if we can't set it up.
+ */
+void setup_exec_cache(struct sandbox_info_t *sandbox_info)
+{
+	char *path = sandbox_info->sandbox_exec_cache;
+	void *map;
+
+	/* Only we write to it; see libsandbox/exec_cache.c. */
+	map = create_shared_file(sandbox_info, path, EXEC_CACHE_FILE_PREFIX,
+	                         SB_EXEC_CACHE_SIZE, false);
+	if (map)
+		munmap(map, SB_EXEC_CACHE_SIZE);
+	else {
+		sb_pwarn("could not create exec cache: %s", path);
+		path[0] = '\0';
+	}
+}
+
+static int setup_sandbox(struct sandbox_info_t *sandbox_info, bool interactive,
+                         const char *exec_cache)
 {
 	if (NULL != getenv(ENV_PORTAGE_TMPDIR)) {
 		/* Portage handle setting SANDBOX_WRITE itself. */
@@ -84,6 +160,24 @@ static int setup_sandbox(struct sandbox_info_t *sandbox_info, bool interactive)
 		}
 	}
 
+	/* A server shares its exec cache with all the sandboxes it runs. */
+	if (exec_cache)
+		strcpy(sandbox_info->sandbox_exec_cache, exec_cache);
+	else
+		setup_exec_cache(sandbox_info);
+
+	/* Set up the socket libsandbox sends us messages & log records over. */
+	collector_setup(sandbox_info);
+
+	/* Set up the trace buffer if the user wants every access recorded. */
+	tracebuf_setup(sandbox_info);
+
+	/* Set up the stats file if the user wants to know what we cost. */
+	stats_setup(sandbox_info);
+
+	/* And where the time goes, if they want to see it. */
+	timeline_setup(sandbox_info);
+
 	/* Generate sandbox message path -- this process's stderr */
 	const char *fdpath = sb_get_fd_dir();
 	if (realpath(fdpath, sandbox_info->sandbox_message_path) == NULL) {
@@ -102,35 +196,6 @@ static int setup_sandbox(struct sandbox_info_t *sandbox_info, bool interactive)
 	return 0;
 }
 
-static void print_sandbox_log(char *sandbox_log)
-{
-	int sandbox_log_file;
-	size_t len;
-	char buffer[8192];
-
-	sandbox_log_file = sb_open(sandbox_log, O_RDONLY, 0);
-	if (-1 == sandbox_log_file) {
-		sb_pwarn("could not open log file: %s", sandbox_log);
-		return;
-	}
-
-	sb_eerror("----------------------- SANDBOX ACCESS VIOLATION SUMMARY -----------------------\n");
-	sb_eerror("LOG FILE: \"%s\"\n", sandbox_log);
-
-	while (1) {
-		len = sb_read(sandbox_log_file, buffer, sizeof(buffer));
-		if (len == -1) {
-			sb_pwarn("sb_read(logfile) failed");
-			break;
-		} else if (!len)
-			break;
-		sb_eerror("\n%s", buffer);
-	}
-	sb_close(sandbox_log_file);
-
-	sb_eerror("--------------------------------------------------------------------------------\n");
-}
-
 static int stop_count = 5;
 
 static void stop(int signum)
@@ -206,22 +271,23 @@ static int spawn_shell(char *argv_bash[], char **env, int debug)
 	return 0;
 }
 
-int main(int argc, char **argv)
+/* Run the program in |argv| (or a shell) in a new sandbox, and return what we
+ * should exit with.  When |exec_cache| is set, we're running it for a server
+ * (see server.c): the exec cache is the server's, and rather than printing the
+ * log or passing signals back up, we leave that to the client, and copy the
+ * log's path to |log| if there is one.
+ */
+int run_sandbox(int argc, char **argv, const char *exec_cache, char *log)
 {
 	int sandbox_log_presence = 0;
 
 	struct sandbox_info_t sandbox_info;
 
 	char **sandbox_environ;
-	char **argv_bash = NULL;
+	struct sb_strv argv_bash = {};
 
 	char *run_str = "-c";
 
-	/* Process the sandbox opts and leave argc/argv for the target. */
-	parseargs(argc, argv);
-	argc -= optind - 1;
-	argv[optind - 1] = argv[0];
-	argv += optind - 1;
 	/* Only print info if called with no arguments .... */
 	if (argc < 2)
 		print_debug = 1;
@@ -237,7 +303,7 @@ int main(int argc, char **argv)
 	if (opt_debug)
 		dputs("Detection of the support files.");
 
-	if (-1 == setup_sandbox(&sandbox_info, print_debug))
+	if (-1 == setup_sandbox(&sandbox_info, print_debug, exec_cache))
 		sb_err("failed to setup sandbox");
 
 	/* verify the existance of required files */
@@ -273,29 +339,30 @@ int main(int argc, char **argv)
 	}
 
 	if (opt_use_bash || argc == 1) {
-		str_list_add_item_copy(argv_bash, "/bin/bash", oom_error);
-		str_list_add_item_copy(argv_bash, "-rcfile", oom_error);
-		str_list_add_item_copy(argv_bash, sandbox_info.sandbox_rc, oom_error);
+		sb_strv_add_copy(&argv_bash, "/bin/bash");
+		sb_strv_add_copy(&argv_bash, "-rcfile");
+		sb_strv_add_copy(&argv_bash, sandbox_info.sandbox_rc);
 		if (argc >= 2) {
 			int i;
 			size_t cmdlen;
 
-			str_list_add_item_copy(argv_bash, run_str, oom_error);
-			str_list_add_item_copy(argv_bash, argv[1], oom_error);
-			cmdlen = strlen(argv_bash[4]);
+			sb_strv_add_copy(&argv_bash, run_str);
+			sb_strv_add_copy(&argv_bash, argv[1]);
+			cmdlen = strlen(argv_bash.strs[4]);
 			for (i = 2; i < argc; i++) {
 				size_t arglen = strlen(argv[i]);
-				argv_bash[4] = xrealloc(argv_bash[4], cmdlen + arglen + 2);
-				argv_bash[4][cmdlen] = ' ';
-				memcpy(argv_bash[4] + cmdlen + 1, argv[i], arglen);
+				argv_bash.strs[4] = xrealloc(argv_bash.strs[4], cmdlen + arglen + 2);
+				argv_bash.strs[4][cmdlen] = ' ';
+				memcpy(argv_bash.strs[4] + cmdlen + 1, argv[i], arglen);
 				cmdlen += arglen + 1;
-				argv_bash[4][cmdlen] = '\0';
+				argv_bash.strs[4][cmdlen] = '\0';
 			}
 		}
 	} else {
 		int i;
+		sb_strv_reserve(&argv_bash, argc - 1);
 		for (i = 1; i < argc; ++i)
-			str_list_add_item_copy(argv_bash, argv[i], oom_error);
+			sb_strv_add_copy(&argv_bash, argv[i]);
 	}
 
 #ifdef HAVE_PRCTL
@@ -352,20 +419,32 @@ int main(int argc, char **argv)
 	if (opt_debug)
 		dputs("The protected environment has been started.");
 
+	collector_start(&sandbox_info);
+
 	/* Start Bash */
-	int shell_exit = spawn_shell(argv_bash, sandbox_environ, print_debug);
+	int shell_exit = spawn_shell(argv_bash.strs, sandbox_environ, print_debug);
 
 	/* As spawn_shell() free both argv_bash and sandbox_environ, make sure
 	 * we do not run into issues in future if we need a OOM error below
 	 * this ... */
-	argv_bash = NULL;
+	argv_bash = (struct sb_strv){};
 	sandbox_environ = NULL;
 
 	dputs("The protected environment has been shut down.");
 
+	if (!exec_cache && sandbox_info.sandbox_exec_cache[0])
+		unlink(sandbox_info.sandbox_exec_cache);
+	collector_stop(&sandbox_info);
+	tracebuf_finish(&sandbox_info);
+	stats_finish(&sandbox_info);
+	timeline_finish(&sandbox_info);
+
 	if (rc_file_exists(sandbox_info.sandbox_log)) {
 		sandbox_log_presence = 1;
-		print_sandbox_log(sandbox_info.sandbox_log);
+		if (log)
+			strcpy(log, sandbox_info.sandbox_log);
+		else
+			print_sandbox_log(sandbox_info.sandbox_log);
 	} else
 		dputs(sandbox_footer);
 
@@ -374,9 +453,11 @@ int main(int argc, char **argv)
 	 */
 	if (stop_called != SIGUSR1 && WIFSIGNALED(shell_exit)) {
 		int signum = WTERMSIG(shell_exit);
-		for (si = 0; si < ARRAY_SIZE(sigs); ++si)
-			sigaction(sigs[si], &act_old[si], NULL);
-		kill(getpid(), signum);
+		if (!exec_cache) {
+			for (si = 0; si < ARRAY_SIZE(sigs); ++si)
+				sigaction(sigs[si], &act_old[si], NULL);
+			kill(getpid(), signum);
+		}
 		return 128 + signum;
 	} else if (WIFEXITED(shell_exit))
 		shell_exit = WEXITSTATUS(shell_exit);
@@ -389,8 +470,22 @@ int main(int argc, char **argv)
 	return shell_exit;
 
 oom_error:
-	if (NULL != argv_bash)
-		str_list_free(argv_bash);
+	sb_strv_free(&argv_bash);
 
 	sb_perr("out of memory (environ)");
 }
+
+int main(int argc, char **argv)
+{
+	/* Process the sandbox opts and leave argc/argv for the target. */
+	parseargs(argc, argv);
+	argc -= optind - 1;
+	argv[optind - 1] = argv[0];
+	argv += optind - 1;
+
+	if (opt_server)
+		return sandbox_server(opt_server, argc, argv);
+	if (opt_connect)
+		return sandbox_connect(opt_connect, argc, argv);
+	return run_sandbox(argc, argv, NULL, NULL);
+}
@@ -17,6 +17,11 @@ struct sandbox_info_t {
 	char sandbox_log[SB_PATH_MAX];
 	char sandbox_debug_log[SB_PATH_MAX];
 	char sandbox_message_path[SB_PATH_MAX];
+	char sandbox_exec_cache[SB_PATH_MAX];
+	char sandbox_collector[SB_PATH_MAX];
+	char sandbox_tracebuf[SB_PATH_MAX];
+	char sandbox_stats[SB_PATH_MAX];
+	char sandbox_timeline[SB_PATH_MAX];
 	char sandbox_lib[SB_PATH_MAX];
 	char sandbox_rc[SB_PATH_MAX];
 	char work_dir[SB_PATH_MAX];
@@ -24,10 +29,41 @@ struct sandbox_info_t {
 	char *home_dir;
 };
 
+extern int run_sandbox(int argc, char **argv, const char *exec_cache, char *log);
+extern void setup_exec_cache(struct sandbox_info_t *sandbox_info);
+extern bool share_with_children(const struct sandbox_info_t *sandbox_info, const char *path,
+                                bool writable);
+extern void *create_shared_file(const struct sandbox_info_t *sandbox_info, char *path,
+                                const char *prefix, size_t size, bool writable);
+
+extern int sandbox_server(const char *path, int argc, char **argv);
+extern int sandbox_connect(const char *path, int argc, char **argv);
+
 extern char **setup_environ(struct sandbox_info_t *sandbox_info, bool interactive);
+extern void setup_cfg_var(const char *env_var);
 
 extern bool sb_get_cnf_bool(const char *, bool);
 
+extern const char *sb_conf_get(const char *key);
+extern int sb_conf_append(rc_dynbuf_t *buf, const char *key, bool confd);
+
+extern void print_sandbox_log(const char *sandbox_log);
+extern bool print_log_record(FILE *out, char *line);
+
+extern void collector_setup(struct sandbox_info_t *sandbox_info);
+extern void collector_start(const struct sandbox_info_t *sandbox_info);
+extern void collector_stop(const struct sandbox_info_t *sandbox_info);
+
+extern void tracebuf_setup(struct sandbox_info_t *sandbox_info);
+extern void tracebuf_finish(const struct sandbox_info_t *sandbox_info);
+extern void dump_tracebuf(const char *path);
+
+extern void stats_setup(struct sandbox_info_t *sandbox_info);
+extern void stats_finish(const struct sandbox_info_t *sandbox_info);
+
+extern void timeline_setup(struct sandbox_info_t *sandbox_info);
+extern void timeline_finish(const struct sandbox_info_t *sandbox_info);
+
 #ifdef __linux__
 extern pid_t setup_namespaces(void);
 #else
@@ -61,6 +97,9 @@ extern int opt_use_ns_time;
 extern int opt_use_ns_user;
 extern int opt_use_ns_uts;
 extern bool opt_use_bash;
+extern bool opt_stats;
 extern int opt_debug;
+extern const char *opt_server;
+extern const char *opt_connect;
 
 #endif
@@ -0,0 +1,466 @@
+/*
+ * server.c
+ *
+ * Run sandboxes on request.  `sandbox --server <socket>` does the setup that
+ * doesn't depend on what gets run (options, config, namespaces, the exec
+ * cache) once, then waits for `sandbox --connect <socket> ...` (or anything
+ * else that talks the protocol below) to send it programs to run.  Each
+ * request gets a fork of the server which carries on like a plain `sandbox`
+ * run would, only in the cwd & env of the request, and with its stdio.
+ *
+ * A request is a uint32_t of the size of the rest, then NUL terminated
+ * strings, each tagged by its first char:
+ *   C<cwd>       where to run the program
+ *   B            run it via bash, like --bash
+ *   D<level>     debug it, like --debug (given <level> times)
+ *   S            show its stats, like --stats
+ *   A<arg>       the program & its args, in order (none for a shell)
+ *   E<var=val>   its env, SANDBOX_* policy settings and all
+ * with the stdin, stdout & stderr to give it attached (SCM_RIGHTS) to the
+ * first bytes.  While it runs, the client passes on the SIGHUP, SIGINT &
+ * SIGTERM it gets as int32_t signal numbers, which go to the whole sandbox
+ * like a terminal's would; if the client goes away, the sandbox gets a SIGHUP.
+ * Once the program is done, the reply is a struct server_reply.
+ *
+ * Copyright 2026 Gentoo Foundation
+ * Licensed under the GPL-2
+ */
+
+#include "headers.h"
+#include "sbutil.h"
+#include "sandbox.h"
+
+/* Far more than ARG_MAX usually allows, so anything that can be run fits. */
+#define SERVER_REQUEST_MAX (16 * 1024 * 1024)
+
+struct server_reply {
+	int32_t status;		/* What `sandbox` would have exited with */
+	char log[SB_PATH_MAX];	/* The violation log, or "" if there were none */
+};
+
+static const int server_sigs[] = { SIGHUP, SIGINT, SIGTERM, };
+
+static volatile sig_atomic_t server_stop;
+static volatile pid_t server_pid;
+
+static int connect_fd = -1;
+static volatile sig_atomic_t connect_signal;
+
+static void server_signal(int signum)
+{
+	server_stop = signum;
+}
+
+/* Pass signals on to the server we left in the namespaces. */
+static void server_forward(int signum)
+{
+	kill(server_pid, signum);
+}
+
+/* Pass signals on to the server running our request. */
+static void connect_forward(int signum)
+{
+	int32_t sig = signum;
+
+	save_errno();
+	connect_signal = signum;
+	/* If it doesn't go through, the server sees us go away instead. */
+	sb_write(connect_fd, &sig, sizeof(sig));
+	restore_errno();
+}
+
+static void server_sigaction(void (*handler)(int), int flags)
+{
+	struct sigaction act = { .sa_handler = handler, .sa_flags = flags, };
+	size_t i;
+
+	sigemptyset(&act.sa_mask);
+	for (i = 0; i < ARRAY_SIZE(server_sigs); ++i)
+		sigaction(server_sigs[i], &act, NULL);
+}
+
+static int server_listen(const char *path)
+{
+	struct sockaddr_un sun = { .sun_family = AF_UNIX, };
+	char *tmp;
+	mode_t mask;
+	int fd;
+
+	xasprintf(&tmp, "%s.%d", path, getpid());
+	if (strlen(tmp) >= sizeof(sun.sun_path))
+		sb_err("socket path is too long: %s", path);
+	strcpy(sun.sun_path, tmp);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd == -1)
+		sb_perr("could not create socket");
+
+	/* Nobody else gets to connect, and we check that they're us anyways. */
+	mask = umask(077);
+	unlink(tmp);
+	if (bind(fd, (void *)&sun, sizeof(sun)))
+		sb_perr("could not bind socket: %s", tmp);
+	umask(mask);
+
+	/* Only show up once we're listening, so clients can wait for the path. */
+	if (listen(fd, SOMAXCONN) || rename(tmp, path)) {
+		unlink(tmp);
+		sb_perr("could not listen on socket: %s", path);
+	}
+
+	free(tmp);
+	return fd;
+}
+
+/* Whether the other end of |fd| runs as us: we'd run anything they ask. */
+static bool server_peer_ok(int fd)
+{
+	struct ucred cred;
+	socklen_t len = sizeof(cred);
+
+	if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len)) {
+		sb_pwarn("could not get the credentials of a client");
+		return false;
+	}
+	if (cred.uid != geteuid()) {
+		sb_warn("refusing request from uid %u (pid %d)", cred.uid, cred.pid);
+		return false;
+	}
+	return true;
+}
+
+/* Read the request on |fd|, returning its strings and their |size|, and the
+ * stdio |fds| that came with it.
+ */
+static char *server_recv(int fd, uint32_t *size, int fds[3])
+{
+	union {
+		struct cmsghdr hdr;
+		char buf[CMSG_SPACE(sizeof(int) * 3)];
+	} cmsg;
+	struct iovec iov = { .iov_base = size, .iov_len = sizeof(*size), };
+	struct msghdr msg = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = &cmsg,
+		.msg_controllen = sizeof(cmsg),
+	};
+	struct cmsghdr *c;
+	char *req;
+
+	if (recvmsg(fd, &msg, MSG_CMSG_CLOEXEC | MSG_WAITALL) != sizeof(*size)) {
+		sb_warn("short request");
+		return NULL;
+	}
+
+	c = CMSG_FIRSTHDR(&msg);
+	if (!c || (msg.msg_flags & MSG_CTRUNC) ||
+	    c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS ||
+	    c->cmsg_len != CMSG_LEN(sizeof(int) * 3)) {
+		sb_warn("request without stdio");
+		return NULL;
+	}
+	memcpy(fds, CMSG_DATA(c), sizeof(int) * 3);
+
+	if (*size == 0 || *size > SERVER_REQUEST_MAX) {
+		sb_warn("bad request size %u", *size);
+		return NULL;
+	}
+	req = xmalloc(*size);
+	if (sb_read(fd, req, *size) != *size || req[*size - 1] != '\0') {
+		sb_warn("short request");
+		return NULL;
+	}
+
+	return req;
+}
+
+/* Pass the signals the client on |fd| sends on to our process group, until
+ * it goes away (we're a fork of the request, which kills us once it's done).
+ */
+static void server_watch(int fd)
+{
+	int32_t signum;
+	size_t i;
+
+	/* We're in the group too. */
+	for (i = 0; i < ARRAY_SIZE(server_sigs); ++i)
+		signal(server_sigs[i], SIG_IGN);
+
+	while (sb_read(fd, &signum, sizeof(signum)) == sizeof(signum))
+		for (i = 0; i < ARRAY_SIZE(server_sigs); ++i)
+			if (signum == server_sigs[i])
+				kill(0, signum);
+
+	kill(0, SIGHUP);
+	_exit(0);
+}
+
+/* Run the request on |fd| in a sandbox (we're a fork of the server). */
+static int server_handle(int fd, const char *exec_cache)
+{
+	struct server_reply reply = {};
+	struct sb_strv args = {}, env = {};
+	const char *cwd = NULL;
+	char *req, *s;
+	uint32_t size;
+	int fds[3], i;
+	pid_t watcher;
+
+	req = server_recv(fd, &size, fds);
+	if (!req)
+		return 1;
+
+	sb_strv_add(&args, "sandbox");
+	sb_strv_reserve(&env, 0);
+	for (s = req; s < req + size; s += strlen(s) + 1) {
+		switch (s[0]) {
+		case 'C': cwd = s + 1; break;
+		case 'B': opt_use_bash = true; break;
+		case 'D': opt_debug = atoi(s + 1); break;
+		case 'S': opt_stats = true; break;
+		case 'A': sb_strv_add(&args, s + 1); break;
+		case 'E': sb_strv_add(&env, s + 1); break;
+		default:
+			sb_warn("bad request string: %s", s);
+			return 1;
+		}
+	}
+	if (!cwd) {
+		sb_warn("request without a cwd");
+		return 1;
+	}
+
+	/* From here on, the client gets to see any complaints. */
+	for (i = 0; i < 3; ++i)
+		if (dup2(fds[i], i) == -1)
+			sb_perr("dup2(%d, %d) failed", fds[i], i);
+	for (i = 0; i < 3; ++i)
+		close(fds[i]);
+
+	if (chdir(cwd)) {
+		sb_pwarn("chdir(%s) failed", cwd);
+		reply.status = 1;
+	} else {
+		/* The client's signals go to everything in the sandbox, so it
+		 * gets a group of its own, like a job in a shell would.
+		 */
+		if (setpgid(0, 0))
+			sb_pwarn("setpgid() failed");
+		watcher = fork();
+		if (watcher == 0)
+			server_watch(fd);
+		else if (watcher == -1)
+			sb_pwarn("could not fork to watch the client");
+
+		environ = env.strs;
+		reply.status = run_sandbox(args.len, args.strs, exec_cache, reply.log);
+		fflush(stdout);
+
+		if (watcher > 0) {
+			kill(watcher, SIGKILL);
+			waitpid(watcher, NULL, 0);
+		}
+	}
+
+	if (sb_write(fd, &reply, sizeof(reply)) != sizeof(reply))
+		return 1;
+	return 0;
+}
+
+int sandbox_server(const char *path, int argc, char **argv)
+{
+	struct sandbox_info_t sandbox_info;
+	sigset_t sigs, orig;
+	int lfd, fd, status;
+	pid_t pid;
+	size_t i;
+
+	if (argc > 1)
+		sb_err("the server runs programs sent with --connect, not its own");
+
+	if (!is_env_on(ENV_SANDBOX_TESTING))
+		if (NULL != getenv(ENV_SANDBOX_ACTIVE))
+			sb_err("not starting a server as a sandbox is already running in this process hierarchy");
+
+	/* Make sure 0-2 are taken, so the fds of requests never end up there. */
+	do
+		fd = open("/dev/null", O_RDWR);
+	while (fd != -1 && fd < 3);
+	if (fd != -1)
+		close(fd);
+
+	lfd = server_listen(path);
+
+	/* Set the namespaces up once for all the sandboxes we run. */
+	if (opt_use_namespaces) {
+		server_sigaction(server_forward, SA_RESTART);
+		server_pid = setup_namespaces();
+		if (server_pid == -1)
+			sb_perr("could not set up namespaces");
+		if (server_pid) {
+			close(lfd);
+			while (waitpid(server_pid, &status, 0) == -1)
+				if (errno != EINTR)
+					sb_perr("failed to waitpid for server");
+			return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+		}
+		opt_use_namespaces = false;
+	}
+
+	memset(&sandbox_info, 0, sizeof(sandbox_info));
+	if (-1 == get_tmp_dir(sandbox_info.tmp_dir))
+		sb_perr("failed to get tmp_dir");
+	setup_exec_cache(&sandbox_info);
+
+	/* Only let the signals to stop in while we wait, so none get lost. */
+	sigemptyset(&sigs);
+	for (i = 0; i < ARRAY_SIZE(server_sigs); ++i)
+		sigaddset(&sigs, server_sigs[i]);
+	sigprocmask(SIG_BLOCK, &sigs, &orig);
+	server_sigaction(server_signal, 0);
+	/* The requests get their statuses, we don't need them. */
+	signal(SIGCHLD, SIG_IGN);
+
+	while (!server_stop) {
+		struct pollfd pfd = { .fd = lfd, .events = POLLIN, };
+
+		if (ppoll(&pfd, 1, NULL, &orig) == -1) {
+			if (errno == EINTR)
+				continue;
+			sb_pwarn("failed to wait for requests");
+			break;
+		}
+
+		fd = accept4(lfd, NULL, NULL, SOCK_CLOEXEC);
+		if (fd == -1)
+			continue;
+		if (!server_peer_ok(fd)) {
+			close(fd);
+			continue;
+		}
+
+		pid = fork();
+		if (pid == 0) {
+			close(lfd);
+			signal(SIGCHLD, SIG_DFL);
+			server_sigaction(SIG_DFL, 0);
+			sigprocmask(SIG_SETMASK, &orig, NULL);
+			exit(server_handle(fd, sandbox_info.sandbox_exec_cache));
+		} else if (pid == -1)
+			sb_pwarn("could not fork for a request");
+		close(fd);
+	}
+
+	unlink(path);
+	if (sandbox_info.sandbox_exec_cache[0])
+		unlink(sandbox_info.sandbox_exec_cache);
+
+	return 0;
+}
+
+static void request_add(char **req, size_t *len, char tag, const char *str)
+{
+	size_t n = strlen(str) + 1;
+
+	*req = xrealloc(*req, *len + 1 + n);
+	(*req)[*len] = tag;
+	memcpy(*req + *len + 1, str, n);
+	*len += 1 + n;
+}
+
+int sandbox_connect(const char *path, int argc, char **argv)
+{
+	struct sockaddr_un sun = { .sun_family = AF_UNIX, };
+	union {
+		struct cmsghdr hdr;
+		char buf[CMSG_SPACE(sizeof(int) * 3)];
+	} cmsg;
+	const int fds[3] = { 0, 1, 2, };
+	struct server_reply reply;
+	struct iovec iov;
+	struct msghdr msg = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = &cmsg,
+		.msg_controllen = sizeof(cmsg),
+	};
+	struct cmsghdr *c;
+	char cwd[SB_PATH_MAX], *req = NULL;
+	size_t len = sizeof(uint32_t);
+	uint32_t size;
+	ssize_t ret;
+	int fd, i;
+
+	if (strlen(path) >= sizeof(sun.sun_path))
+		sb_err("socket path is too long: %s", path);
+	strcpy(sun.sun_path, path);
+
+	if (!getcwd(cwd, sizeof(cwd)))
+		sb_perr("failed to get current directory");
+
+	req = xmalloc(len);
+	request_add(&req, &len, 'C', cwd);
+	if (opt_use_bash)
+		request_add(&req, &len, 'B', "");
+	if (opt_debug > 0) {
+		char level[16];
+
+		snprintf(level, sizeof(level), "%d", opt_debug);
+		request_add(&req, &len, 'D', level);
+	}
+	if (opt_stats)
+		request_add(&req, &len, 'S', "");
+	for (i = 1; i < argc; ++i)
+		request_add(&req, &len, 'A', argv[i]);
+	for (i = 0; environ && environ[i]; ++i)
+		request_add(&req, &len, 'E', environ[i]);
+	if (len - sizeof(size) > SERVER_REQUEST_MAX)
+		sb_err("request is too big");
+	size = len - sizeof(size);
+	memcpy(req, &size, sizeof(size));
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd == -1)
+		sb_perr("could not create socket");
+	if (connect(fd, (void *)&sun, sizeof(sun)))
+		sb_perr("could not connect to server: %s", path);
+
+	/* The stdio go along with the first bytes, the rest is plain data. */
+	memset(&cmsg, 0, sizeof(cmsg));
+	c = CMSG_FIRSTHDR(&msg);
+	c->cmsg_level = SOL_SOCKET;
+	c->cmsg_type = SCM_RIGHTS;
+	c->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(c), fds, sizeof(fds));
+	iov.iov_base = req;
+	iov.iov_len = len;
+	do
+		ret = sendmsg(fd, &msg, MSG_NOSIGNAL);
+	while (ret == -1 && errno == EINTR);
+	if (ret == -1)
+		sb_perr("could not send request");
+	if (sb_write(fd, req + ret, len - ret) != len - ret)
+		sb_perr("could not send request");
+	free(req);
+
+	/* Only now, so they can't end up in the middle of the request. */
+	connect_fd = fd;
+	server_sigaction(connect_forward, SA_RESTART);
+
+	if (sb_read(fd, &reply, sizeof(reply)) != sizeof(reply))
+		sb_err("lost connection to server");
+	server_sigaction(SIG_DFL, 0);
+	close(fd);
+
+	if (reply.log[0]) {
+		reply.log[sizeof(reply.log) - 1] = '\0';
+		print_sandbox_log(reply.log);
+	}
+
+	/* Pass the signal back up like `sandbox` does when it killed the run. */
+	if (connect_signal && reply.status == 128 + connect_signal)
+		kill(getpid(), connect_signal);
+
+	return reply.status;
+}
@@ -0,0 +1,295 @@
+/*
+ * stats.c
+ *
+ * Set up the stats file libsandbox in all of our children counts their checks
+ * in when SANDBOX_STATS is enabled (see libsandbox/stats.c), and add it all up
+ * once the sandbox is done.  SANDBOX_STATS can be a path to write the numbers
+ * to as JSON instead of showing them.
+ *
+ * Copyright 2026 Gentoo Foundation
+ * Licensed under the GPL-2
+ */
+
+#include "headers.h"
+#include "sbutil.h"
+#include "sandbox.h"
+#include "sb_stats.h"
+
+bool opt_stats = false;
+
+struct stats_total {
+	struct sb_stats_func func;
+	/* How many of the slots used it, and the last one that did */
+	unsigned long procs;
+	size_t slot;
+};
+
+void stats_setup(struct sandbox_info_t *sandbox_info)
+{
+	char *path = sandbox_info->sandbox_stats;
+	const char *val;
+	struct sb_stats *st;
+
+	path[0] = '\0';
+	setup_cfg_var(ENV_SANDBOX_STATS);
+	val = getenv(ENV_SANDBOX_STATS);
+	if (!opt_stats && !(val && (val[0] == '/' || is_val_on(val))))
+		return;
+
+	st = create_shared_file(sandbox_info, path, STATS_FILE_PREFIX, sizeof(*st), true);
+	if (!st) {
+		sb_pwarn("could not create stats file: %s", path);
+		path[0] = '\0';
+		return;
+	}
+	st->version = SB_STATS_VERSION;
+	st->magic = SB_STATS_MAGIC;
+	munmap(st, sizeof(*st));
+}
+
+static int stats_total_cmp(const void *a, const void *b)
+{
+	const struct stats_total *ta = a, *tb = b;
+
+	if (ta->func.calls != tb->func.calls)
+		return ta->func.calls > tb->func.calls ? -1 : 1;
+	return strcmp(ta->func.name, tb->func.name);
+}
+
+/* The upper bound of latency bucket |b| (in ns). */
+static uint64_t stats_bucket_max(size_t b)
+{
+	return (uint64_t)1 << (b + SB_STATS_BUCKET_MIN_SHIFT);
+}
+
+static const char *stats_fmt_ns(char *buf, size_t len, uint64_t ns)
+{
+	if (ns < 1000)
+		snprintf(buf, len, "%" PRIu64 "ns", ns);
+	else if (ns < 1000000)
+		snprintf(buf, len, "%.1fus", ns / 1000.0);
+	else
+		snprintf(buf, len, "%.1fms", ns / 1000000.0);
+	return buf;
+}
+
+/* Which bucket the |pct| percentile of |f|'s checks fall in, as text. */
+static const char *stats_percentile(char *buf, size_t len, const struct sb_stats_func *f, unsigned pct)
+{
+	uint64_t seen = 0, want = (f->calls * pct + 99) / 100;
+	char ns[16];
+	size_t b;
+
+	for (b = 0; b < SB_STATS_BUCKETS - 1; ++b) {
+		seen += f->latency[b];
+		if (seen >= want)
+			break;
+	}
+	if (b == SB_STATS_BUCKETS - 1)
+		snprintf(buf, len, ">%s", stats_fmt_ns(ns, sizeof(ns), stats_bucket_max(b - 1)));
+	else
+		snprintf(buf, len, "<%s", stats_fmt_ns(ns, sizeof(ns), stats_bucket_max(b)));
+	return buf;
+}
+
+static void stats_print(const struct sb_stats_slot *sum, const struct stats_total *totals,
+                        size_t ntotals, unsigned long nprocs, unsigned long ntracers)
+{
+	struct sb_stats_func all = { .name = "(total)", };
+	char avg[24], p50[24], p99[24], line[128];
+	size_t i, b;
+
+	/* sb_eraw() doesn't do field widths. */
+	sb_einfo("------------------------------ SANDBOX STATISTICS ------------------------------\n");
+	snprintf(line, sizeof(line), "%-20s %10s %10s %8s %8s %8s %9s %9s %9s",
+		"func", "calls", "allowed", "denied", "predict", "cached", "avg", "p50", "p99");
+	sb_eraw("%s\n", line);
+	for (i = 0; i <= ntotals; ++i) {
+		const struct sb_stats_func *f = i < ntotals ? &totals[i].func : &all;
+
+		if (i < ntotals) {
+			all.calls += f->calls;
+			all.allowed += f->allowed;
+			all.denied += f->denied;
+			all.predicted += f->predicted;
+			all.cache_hits += f->cache_hits;
+			all.ns += f->ns;
+			for (b = 0; b < SB_STATS_BUCKETS; ++b)
+				all.latency[b] += f->latency[b];
+		}
+		if (f->calls) {
+			stats_fmt_ns(avg, sizeof(avg), f->ns / f->calls);
+			stats_percentile(p50, sizeof(p50), f, 50);
+			stats_percentile(p99, sizeof(p99), f, 99);
+		} else
+			strcpy(avg, "-"), strcpy(p50, "-"), strcpy(p99, "-");
+		snprintf(line, sizeof(line), "%-20s %10" PRIu64 " %10" PRIu64 " %8" PRIu64
+			" %8" PRIu64 " %8" PRIu64 " %9s %9s %9s",
+			f->name, f->calls, f->allowed, f->denied, f->predicted, f->cache_hits,
+			avg, p50, p99);
+		sb_eraw("%s\n", line);
+	}
+	sb_eraw("\nprocesses: %lu\n", nprocs);
+	snprintf(line, sizeof(line), "execs: %" PRIu64 " preloaded, %" PRIu64 " traced, %" PRIu64
+		" unchecked, %" PRIu64 " other (%" PRIu64 " programs inspected)",
+		sum->exec_preload, sum->exec_trace, sum->exec_unchecked, sum->exec_other,
+		sum->exec_classify);
+	sb_eraw("%s\n", line);
+	snprintf(line, sizeof(line), "exec wrappers: avg %s (inspecting programs: avg %s)",
+		sum->exec_wrapped ? stats_fmt_ns(p50, sizeof(p50), sum->exec_wrapper_ns / sum->exec_wrapped) : "-",
+		sum->exec_classify ? stats_fmt_ns(p99, sizeof(p99), sum->classify_ns / sum->exec_classify) : "-");
+	sb_eraw("%s\n", line);
+	snprintf(line, sizeof(line), "startup: %" PRIu64 " inits, avg %s", sum->inits,
+		sum->inits ? stats_fmt_ns(avg, sizeof(avg), sum->init_ns / sum->inits) : "-");
+	sb_eraw("%s\n", line);
+	snprintf(line, sizeof(line), "tracer stops: %" PRIu64 " (in %lu tracers)",
+		sum->trace_stops, ntracers);
+	sb_eraw("%s\n", line);
+	sb_einfo("--------------------------------------------------------------------------------\n");
+}
+
+static void stats_write(const char *path, const struct sb_stats_slot *sum,
+                        const struct stats_total *totals, size_t ntotals, unsigned long nprocs,
+                        unsigned long ntracers)
+{
+	size_t i, b;
+	FILE *fp;
+
+	fp = fopen(path, "we");
+	if (!fp) {
+		sb_pwarn("unable to write stats: %s", path);
+		return;
+	}
+
+	fprintf(fp, "{\"version\":%i,\"processes\":%lu,\"tracers\":%lu,\"trace_stops\":%" PRIu64 ","
+		"\"exec\":{\"inspected\":%" PRIu64 ",\"preload\":%" PRIu64 ",\"trace\":%" PRIu64 ","
+		"\"unchecked\":%" PRIu64 ",\"other\":%" PRIu64 ",\"inspect_ns\":%" PRIu64 ","
+		"\"wrapped\":%" PRIu64 ",\"wrapper_ns\":%" PRIu64 "},"
+		"\"init\":{\"count\":%" PRIu64 ",\"ns\":%" PRIu64 "},"
+		"\"latency_buckets_ns\":[",
+		SB_STATS_VERSION, nprocs, ntracers, sum->trace_stops, sum->exec_classify,
+		sum->exec_preload, sum->exec_trace, sum->exec_unchecked, sum->exec_other,
+		sum->classify_ns, sum->exec_wrapped, sum->exec_wrapper_ns,
+		sum->inits, sum->init_ns);
+	/* The upper bound of each bucket; the last one has none. */
+	for (b = 0; b < SB_STATS_BUCKETS - 1; ++b)
+		fprintf(fp, "%s%" PRIu64, b ? "," : "", stats_bucket_max(b));
+	fprintf(fp, "],\"funcs\":[");
+
+	for (i = 0; i < ntotals; ++i) {
+		const struct sb_stats_func *f = &totals[i].func;
+
+		fprintf(fp, "%s{\"name\":\"%s\",\"processes\":%lu,\"calls\":%" PRIu64 ","
+			"\"allowed\":%" PRIu64 ",\"denied\":%" PRIu64 ",\"predicted\":%" PRIu64 ","
+			"\"cache_hits\":%" PRIu64 ",\"ns\":%" PRIu64 ",\"latency\":[",
+			i ? "," : "", f->name, totals[i].procs, f->calls, f->allowed,
+			f->denied, f->predicted, f->cache_hits, f->ns);
+		for (b = 0; b < SB_STATS_BUCKETS; ++b)
+			fprintf(fp, "%s%" PRIu64, b ? "," : "", f->latency[b]);
+		fprintf(fp, "]}");
+	}
+	fprintf(fp, "]}\n");
+
+	if (fclose(fp))
+		sb_pwarn("unable to write stats: %s", path);
+}
+
+/* Add up all the slots, show (or write out) the result, and clean up. */
+void stats_finish(const struct sandbox_info_t *sandbox_info)
+{
+	const char *path = sandbox_info->sandbox_stats;
+	const char *val = getenv(ENV_SANDBOX_STATS);
+	const struct sb_stats *st;
+	struct sb_stats_slot sum = {};
+	struct stats_total *totals = NULL;
+	size_t ntotals = 0, i, f, b;
+	unsigned long nprocs, ntracers = 0;
+	struct stat sb;
+	int fd;
+
+	if (!path[0])
+		return;
+
+	fd = open(path, O_RDONLY|O_CLOEXEC);
+	if (fd == -1) {
+		sb_pwarn("could not open stats file: %s", path);
+		goto done;
+	}
+	if (fstat(fd, &sb) || sb.st_size != sizeof(*st)) {
+		sb_warn("not a stats file: %s", path);
+		close(fd);
+		goto done;
+	}
+	st = mmap(NULL, sizeof(*st), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (st == MAP_FAILED) {
+		sb_pwarn("could not map stats file: %s", path);
+		goto done;
+	}
+
+	nprocs = st->slots_used;
+	for (i = 0; i < MIN(nprocs, SB_STATS_SLOTS); ++i) {
+		const struct sb_stats_slot *slot = &st->slots[i];
+
+		sum.trace_stops += slot->trace_stops;
+		/* Each tracer is a process (& so a slot) of its own. */
+		if (slot->trace_stops)
+			++ntracers;
+		sum.exec_classify += slot->exec_classify;
+		sum.exec_preload += slot->exec_preload;
+		sum.exec_trace += slot->exec_trace;
+		sum.exec_unchecked += slot->exec_unchecked;
+		sum.exec_other += slot->exec_other;
+		sum.inits += slot->inits;
+		sum.init_ns += slot->init_ns;
+		sum.exec_wrapped += slot->exec_wrapped;
+		sum.exec_wrapper_ns += slot->exec_wrapper_ns;
+		sum.classify_ns += slot->classify_ns;
+
+		/* Different builds of libsandbox (e.g. multilib) might lay out
+		 * the funcs differently, so go by name.
+		 */
+		for (f = 0; f < SB_STATS_FUNCS; ++f) {
+			const struct sb_stats_func *func = &slot->funcs[f];
+			struct sb_stats_func *t;
+			size_t n;
+
+			if (func->state != SB_STATS_FUNC_NAMED ||
+			    (!func->calls && !func->cache_hits))
+				continue;
+			for (n = 0; n < ntotals; ++n)
+				if (!strncmp(totals[n].func.name, func->name, sizeof(func->name)))
+					break;
+			if (n == ntotals) {
+				totals = xrealloc(totals, sizeof(*totals) * ++ntotals);
+				memset(&totals[n], 0, sizeof(*totals));
+				memcpy(totals[n].func.name, func->name, sizeof(func->name) - 1);
+			}
+			t = &totals[n].func;
+			/* Racing threads can name a func twice in a slot. */
+			if (totals[n].slot != i + 1) {
+				totals[n].slot = i + 1;
+				++totals[n].procs;
+			}
+			t->calls += func->calls;
+			t->allowed += func->allowed;
+			t->denied += func->denied;
+			t->predicted += func->predicted;
+			t->cache_hits += func->cache_hits;
+			t->ns += func->ns;
+			for (b = 0; b < SB_STATS_BUCKETS; ++b)
+				t->latency[b] += func->latency[b];
+		}
+	}
+	munmap((void *)st, sizeof(*st));
+
+	qsort(totals, ntotals, sizeof(*totals), stats_total_cmp);
+	if (val && val[0] == '/')
+		stats_write(val, &sum, totals, ntotals, nprocs, ntracers);
+	else
+		stats_print(&sum, totals, ntotals, nprocs, ntracers);
+	free(totals);
+
+ done:
+	unlink(path);
+}
@@ -0,0 +1,186 @@
+/*
+ * timeline.c
+ *
+ * Set up the timeline buffer libsandbox in all of our children records spans
+ * in when SANDBOX_TIMELINE is set (see libsandbox/timeline.c), and once the
+ * sandbox is done, turn them into a Chrome trace at the path it points to.
+ * The format is documented in the "Trace Event Format" doc; Perfetto and
+ * chrome://tracing both load it.
+ *
+ * Copyright 2026 Gentoo Foundation
+ * Licensed under the GPL-2
+ */
+
+#include "headers.h"
+#include "sbutil.h"
+#include "sandbox.h"
+#include "sb_timeline.h"
+
+/* The event names & categories for each SB_SPAN_*. */
+static const char * const span_names[SB_SPAN_MAX] = {
+	[SB_SPAN_CHECK]      = "before_syscall",
+	[SB_SPAN_RESOLVE]    = "resolve_path",
+	[SB_SPAN_LOG]        = "write_logfile",
+	[SB_SPAN_EXEC]       = "sb_check_exec",
+	[SB_SPAN_TRACE_WAIT] = "trace wait",
+};
+static const char * const span_cats[SB_SPAN_MAX] = {
+	[SB_SPAN_CHECK]      = "check",
+	[SB_SPAN_RESOLVE]    = "resolve",
+	[SB_SPAN_LOG]        = "log",
+	[SB_SPAN_EXEC]       = "exec",
+	[SB_SPAN_TRACE_WAIT] = "trace",
+};
+
+void timeline_setup(struct sandbox_info_t *sandbox_info)
+{
+	char *path = sandbox_info->sandbox_timeline;
+	const char *val;
+	struct sb_timeline *tl;
+
+	path[0] = '\0';
+	setup_cfg_var(ENV_SANDBOX_TIMELINE);
+	val = getenv(ENV_SANDBOX_TIMELINE);
+	if (!val || !val[0])
+		return;
+	if (val[0] != '/') {
+		sb_warn("%s must be an absolute path: %s", ENV_SANDBOX_TIMELINE, val);
+		return;
+	}
+
+	tl = create_shared_file(sandbox_info, path, TIMELINE_FILE_PREFIX, sizeof(*tl), true);
+	if (!tl) {
+		sb_pwarn("could not create timeline buffer: %s", path);
+		path[0] = '\0';
+		return;
+	}
+	tl->version = SB_TIMELINE_VERSION;
+	tl->magic = SB_TIMELINE_MAGIC;
+	munmap(tl, sizeof(*tl));
+}
+
+/* Write |len| bytes of |str| (it might not be NUL terminated) as a JSON string. */
+static void timeline_json_str(FILE *fp, const char *str, size_t len)
+{
+	size_t i;
+
+	fputc('"', fp);
+	for (i = 0; i < len && str[i]; ++i) {
+		unsigned char c = str[i];
+
+		if (c == '"' || c == '\\')
+			fprintf(fp, "\\%c", c);
+		else if (c < 0x20)
+			fprintf(fp, "\\u%04x", c);
+		else
+			fputc(c, fp);
+	}
+	fputc('"', fp);
+}
+
+static void timeline_write(const char *path, const struct sb_timeline *tl)
+{
+	size_t nchunks = MIN(tl->chunks_used, SB_TIMELINE_CHUNKS);
+	uint64_t first = UINT64_MAX;
+	size_t c, s, nspans;
+	bool comma = false;
+	FILE *fp;
+
+	/* Chrome traces want times in us, so start them from the first span. */
+	for (c = 0; c < nchunks; ++c) {
+		const struct sb_timeline_chunk *chunk = &tl->chunks[c];
+
+		nspans = MIN(chunk->used, SB_TIMELINE_CHUNK_SPANS);
+		for (s = 0; s < nspans; ++s)
+			if (chunk->spans[s].start && chunk->spans[s].start < first)
+				first = chunk->spans[s].start;
+	}
+
+	fp = fopen(path, "we");
+	if (!fp) {
+		sb_pwarn("unable to write timeline: %s", path);
+		return;
+	}
+
+	fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+	for (c = 0; c < nchunks; ++c) {
+		const struct sb_timeline_chunk *chunk = &tl->chunks[c];
+		const struct sb_timeline_chunk *prev = c ? &tl->chunks[c - 1] : NULL;
+
+		/* Name the process after the program; it changes on exec, and
+		 * the last name wins.
+		 */
+		if (!prev || prev->pid != chunk->pid ||
+		    strncmp(prev->comm, chunk->comm, sizeof(chunk->comm))) {
+			fprintf(fp, "%s{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%" PRIi32
+				",\"args\":{\"name\":", comma ? "," : "", chunk->pid);
+			timeline_json_str(fp, chunk->comm, sizeof(chunk->comm));
+			fprintf(fp, "}}");
+			comma = true;
+		}
+
+		nspans = MIN(chunk->used, SB_TIMELINE_CHUNK_SPANS);
+		for (s = 0; s < nspans; ++s) {
+			const struct sb_timeline_span *span = &chunk->spans[s];
+
+			/* Never filled in (e.g. the process died halfway). */
+			if (!span->start || span->kind >= SB_SPAN_MAX)
+				continue;
+
+			fprintf(fp, "%s{\"name\":", comma ? "," : "");
+			if (span->kind == SB_SPAN_CHECK)
+				timeline_json_str(fp, span->name, sizeof(span->name));
+			else
+				fprintf(fp, "\"%s\"", span_names[span->kind]);
+			fprintf(fp, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f"
+				",\"pid\":%" PRIi32 ",\"tid\":%" PRIi32 ",\"args\":{\"func\":",
+				span_cats[span->kind], (span->start - first) / 1000.0,
+				span->dur / 1000.0, chunk->pid, span->tid);
+			timeline_json_str(fp, span->name, sizeof(span->name));
+			fprintf(fp, "}}");
+			comma = true;
+		}
+	}
+	fprintf(fp, "]}\n");
+
+	if (fclose(fp))
+		sb_pwarn("unable to write timeline: %s", path);
+}
+
+/* Write out the timeline, and clean up. */
+void timeline_finish(const struct sandbox_info_t *sandbox_info)
+{
+	const char *path = sandbox_info->sandbox_timeline;
+	const struct sb_timeline *tl;
+	struct stat sb;
+	int fd;
+
+	if (!path[0])
+		return;
+
+	fd = open(path, O_RDONLY|O_CLOEXEC);
+	if (fd == -1) {
+		sb_pwarn("could not open timeline buffer: %s", path);
+		goto done;
+	}
+	if (fstat(fd, &sb) || sb.st_size != sizeof(*tl)) {
+		sb_warn("not a timeline buffer: %s", path);
+		close(fd);
+		goto done;
+	}
+	tl = mmap(NULL, sizeof(*tl), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (tl == MAP_FAILED) {
+		sb_pwarn("could not map timeline buffer: %s", path);
+		goto done;
+	}
+
+	timeline_write(getenv(ENV_SANDBOX_TIMELINE), tl);
+	if (tl->dropped)
+		sb_warn("%" PRIu64 " spans could not be recorded in the timeline",
+			tl->dropped);
+	munmap((void *)tl, sizeof(*tl));
+
+ done:
+	unlink(path);
+}
@@ -0,0 +1,234 @@
+/*
+ * tracebuf.c
+ *
+ * Set up the trace buffer libsandbox records every access it checks in when
+ * SANDBOX_TRACE is enabled (see libsandbox/tracebuf.c), and decode it into
+ * the debug log once the sandbox is done.  `sandbox --dump-trace` decodes one
+ * on demand, e.g. to look at a sandbox that's still running.
+ *
+ * Copyright 2026 Gentoo Foundation
+ * Licensed under the GPL-2
+ */
+
+#include "headers.h"
+#include "sbutil.h"
+#include "sandbox.h"
+#include "sb_tracebuf.h"
+
+void tracebuf_setup(struct sandbox_info_t *sandbox_info)
+{
+	char *path = sandbox_info->sandbox_tracebuf;
+	struct sb_tracebuf *tb;
+
+	path[0] = '\0';
+	setup_cfg_var(ENV_SANDBOX_TRACE);
+	if (!is_env_on(ENV_SANDBOX_TRACE))
+		return;
+
+	tb = create_shared_file(sandbox_info, path, TRACEBUF_FILE_PREFIX, sizeof(*tb), true);
+	if (!tb) {
+		sb_pwarn("could not create trace buffer: %s", path);
+		path[0] = '\0';
+		return;
+	}
+	tb->version = SB_TRACEBUF_VERSION;
+	tb->strings_used = SB_TRACEBUF_STR_SIZE(0);
+	tb->magic = SB_TRACEBUF_MAGIC;
+	munmap(tb, sizeof(*tb));
+}
+
+static const struct sb_tracebuf *tracebuf_map(const char *path)
+{
+	const struct sb_tracebuf *tb;
+	struct stat st;
+	int fd;
+
+	fd = open(path, O_RDONLY|O_CLOEXEC);
+	if (fd == -1) {
+		sb_pwarn("could not open trace buffer: %s", path);
+		return NULL;
+	}
+	if (fstat(fd, &st) || st.st_size != sizeof(*tb)) {
+		sb_warn("not a trace buffer: %s", path);
+		close(fd);
+		return NULL;
+	}
+	tb = mmap(NULL, sizeof(*tb), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (tb == MAP_FAILED) {
+		sb_pwarn("could not map trace buffer: %s", path);
+		return NULL;
+	}
+	if (tb->magic != SB_TRACEBUF_MAGIC || tb->version != SB_TRACEBUF_VERSION) {
+		sb_warn("not a trace buffer: %s", path);
+		munmap((void *)tb, sizeof(*tb));
+		return NULL;
+	}
+	return tb;
+}
+
+/* Look up the string at |pos|, given |used| bytes of strings handed out. */
+static const char *tracebuf_str(const struct sb_tracebuf *tb, uint64_t pos, uint64_t used, size_t *len)
+{
+	size_t off = pos % SB_TRACEBUF_STRINGS;
+	uint32_t slen;
+
+	*len = 0;
+	if (!SB_TRACEBUF_STR_LIVE(pos, used) || off > SB_TRACEBUF_STRINGS - SB_TRACEBUF_STR_SIZE(0))
+		return "";
+	memcpy(&slen, tb->strings + off, sizeof(slen));
+	if (slen > SB_TRACEBUF_STRINGS - off - SB_TRACEBUF_STR_SIZE(0))
+		return "";
+	*len = slen;
+	return tb->strings + off + sizeof(slen);
+}
+
+/* How many of the strings |r| refers to have been overwritten. */
+static unsigned tracebuf_strs_gone(const struct sb_tracebuf_record *r, uint64_t used)
+{
+	const uint64_t pos[] = { r->func, r->path, r->apath, r->rpath, r->cmdline, };
+	unsigned i, ret = 0;
+
+	for (i = 0; i < ARRAY_SIZE(pos); ++i)
+		if (pos[i] && !SB_TRACEBUF_STR_LIVE(pos[i], used))
+			++ret;
+	return ret;
+}
+
+/* Write out all the records still in the buffer as log records, or in the
+ * readable layout if |text| is set.  Returns how many were lost, and sets
+ * |stripped| to how many lost (some of) their strings.
+ */
+static uint64_t tracebuf_decode(const struct sb_tracebuf *tb, FILE *out, bool text, uint64_t *stripped)
+{
+	uint64_t head, idx, lost, used;
+	size_t len, size = 0;
+	char *record = NULL;
+	unsigned gone;
+
+	head = __atomic_load_n(&tb->head, __ATOMIC_ACQUIRE);
+	idx = head > SB_TRACEBUF_RECORDS ? head - SB_TRACEBUF_RECORDS : 0;
+	lost = idx;
+	*stripped = 0;
+
+	for (; idx < head; ++idx) {
+		const struct sb_tracebuf_record *r = &tb->records[idx % SB_TRACEBUF_RECORDS];
+		struct sb_tracebuf_record copy;
+		struct sb_log_record rec;
+		uint32_t seq = idx + 1;
+
+		/* Skip records that are still being written or were recycled. */
+		if (__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) != seq)
+			goto skip;
+		copy = *r;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&r->seq, __ATOMIC_RELAXED) != seq)
+			goto skip;
+
+		/* Strings might get overwritten while we format them, in which
+		 * case go again without them.
+		 */
+		used = __atomic_load_n(&tb->strings_used, __ATOMIC_ACQUIRE);
+		do {
+			gone = tracebuf_strs_gone(&copy, used);
+			rec = (struct sb_log_record){
+				.func = tracebuf_str(tb, copy.func, used, &len),
+				.path = tracebuf_str(tb, copy.path, used, &len),
+				.apath = tracebuf_str(tb, copy.apath, used, &len),
+				.rpath = tracebuf_str(tb, copy.rpath, used, &len),
+				.access = copy.access,
+				.pid = copy.pid,
+				.time = copy.time,
+			};
+			rec.cmdline = tracebuf_str(tb, copy.cmdline, used, &rec.cmdline_len);
+			if (!rec.cmdline_len)
+				rec.cmdline = NULL;
+
+			len = sb_log_format_record(NULL, &rec);
+			if (len + 1 > size) {
+				size = len + 1;
+				record = xrealloc(record, size);
+			}
+			sb_log_format_record(record, &rec);
+
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			used = __atomic_load_n(&tb->strings_used, __ATOMIC_RELAXED);
+		} while (tracebuf_strs_gone(&copy, used) != gone);
+		if (gone)
+			++*stripped;
+
+		if (text) {
+			record[len - 1] = '\0';
+			print_log_record(out, record);
+		} else
+			fwrite(record, 1, len, out);
+		continue;
+
+ skip:
+		++lost;
+	}
+
+	free(record);
+	return lost;
+}
+
+/* Decode the trace buffer into the debug log, and clean it up. */
+void tracebuf_finish(const struct sandbox_info_t *sandbox_info)
+{
+	const char *path = sandbox_info->sandbox_tracebuf;
+	const char *log = sandbox_info->sandbox_debug_log;
+	const struct sb_tracebuf *tb;
+	struct stat st;
+	uint64_t lost, stripped;
+	FILE *fp;
+	int fd;
+
+	if (!path[0])
+		return;
+
+	tb = tracebuf_map(path);
+	if (!tb)
+		goto done;
+
+	fd = open(log, O_WRONLY|O_APPEND|O_CREAT|O_NOFOLLOW|O_CLOEXEC,
+		S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if (fd == -1 || !(fp = fdopen(fd, "a"))) {
+		sb_pwarn("unable to append debug log: %s", log);
+		if (fd != -1)
+			close(fd);
+		goto done_map;
+	}
+	if (fstat(fd, &st) || !S_ISREG(st.st_mode)) {
+		sb_warn("SECURITY BREACH: '%s' already exists and is not a regular file!", log);
+		fclose(fp);
+		goto done_map;
+	}
+	lost = tracebuf_decode(tb, fp, false, &stripped);
+	if (fclose(fp))
+		sb_pwarn("unable to write debug log: %s", log);
+	if (lost)
+		sb_ewarn("trace buffer overflowed: lost %" PRIu64 " records\n", lost);
+	if (stripped)
+		sb_ewarn("trace buffer overflowed: lost the paths of %" PRIu64 " records\n", stripped);
+
+ done_map:
+	munmap((void *)tb, sizeof(*tb));
+ done:
+	unlink(path);
+}
+
+void dump_tracebuf(const char *path)
+{
+	const struct sb_tracebuf *tb;
+	uint64_t lost, stripped;
+
+	tb = tracebuf_map(path);
+	if (!tb)
+		exit(EXIT_FAILURE);
+	lost = tracebuf_decode(tb, stdout, true, &stripped);
+	if (lost)
+		printf("\n(%" PRIu64 " records were lost)\n", lost);
+	if (stripped)
+		printf("\n(%" PRIu64 " records lost their paths)\n", stripped);
+	munmap((void *)tb, sizeof(*tb));
+}
@@ -0,0 +1,16 @@
+#define CONFIG HAVE_FUTIMENS
+#define FUNC futimens
+#define SFUNC "futimens"
+#define FUNC_STR "%i, %p"
+#define FUNC_IMP fd, times
+#define ARG_CNT 2
+#define ARG_USE "<fd> <times>"
+
+#define process_args() \
+	s = argv[i++]; \
+	int fd = at_get_fd(s); \
+	\
+	s = argv[i++]; \
+	const struct timespec *times = parse_timespec(s);
+
+#include "test-skel-0.c"
@@ -0,0 +1,9 @@
+#!/bin/sh
+# make sure the NULL path futimens passes down is let through
+[ "${at_xfail}" = "yes" ] && exit 77 # see trace-0
+
+addwrite $PWD
+
+touch -r / file || exit 1
+futimens64_static-0 0 file:O_WRONLY NULL || exit 1
+[ file -nt / ]
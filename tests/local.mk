@@ -18,6 +18,7 @@ EXTRA_DIST += \
 check_PROGRAMS += \
 	%D%/get-group \
 	%D%/get-user \
+	%D%/sb_collect \
 	%D%/sb_true \
 	%D%/sb_true_static \
 	\
@@ -35,6 +36,8 @@ check_PROGRAMS += \
 	%D%/fchownat-0 \
 	%D%/fopen-0 \
 	%D%/fopen64-0 \
+	%D%/futimens-0 \
+	%D%/futimens64_static-0 \
 	%D%/futimesat-0 \
 	%D%/lchown-0 \
 	%D%/link-0 \
@@ -66,6 +69,7 @@ check_PROGRAMS += \
 	%D%/openat_static-0 \
 	%D%/openat64-0 \
 	%D%/opendir-0 \
+	%D%/posix_spawn-0 \
 	%D%/remove-0 \
 	%D%/removexattr-0 \
 	%D%/rename-0 \
@@ -94,13 +98,16 @@ check_PROGRAMS += \
 	%D%/getcwd-gnulib_tst \
 	%D%/libsigsegv_tst \
 	%D%/malloc_hooked_tst \
+	%D%/malloc_interpose_tst \
 	%D%/malloc_mmap_tst \
 	%D%/pipe-fork_tst \
 	%D%/pipe-fork_static_tst \
+	%D%/sb_efuncs_tst \
 	%D%/sb_printf_tst \
 	%D%/sigsuspend-zsh_tst \
 	%D%/sigsuspend-zsh_static_tst \
-	%D%/trace-memory_static_tst
+	%D%/trace-memory_static_tst \
+	%D%/trace-state_static_tst
 
 dist_check_SCRIPTS += \
 	$(wildcard $(top_srcdir)/%D%/*-[0-9]*.sh) \
@@ -111,10 +118,15 @@ dist_check_SCRIPTS += \
 # This will be used by all programs, not just tests/ ...
 AM_LDFLAGS = `expr $@ : .*_static >/dev/null && echo -all-static`
 
+%C%_sb_efuncs_tst_CFLAGS = -I$(top_srcdir)/libsbutil -I$(top_srcdir)/libsbutil/include
+%C%_sb_efuncs_tst_LDADD = libsbutil/libsbutil.la
+%C%_sb_efuncs_tst_LDFLAGS = $(AM_LDFLAGS) -pthread
+
 %C%_sb_printf_tst_CFLAGS = -I$(top_srcdir)/libsbutil -I$(top_srcdir)/libsbutil/include
 %C%_sb_printf_tst_LDADD = libsbutil/libsbutil.la
 
 %C%_malloc_hooked_tst_LDFLAGS = $(AM_LDFLAGS) -pthread
+%C%_malloc_interpose_tst_LDFLAGS = $(AM_LDFLAGS) -rdynamic
 
 %C%_libsigsegv_tst_CPPFLAGS = ${AM_CPPFLAGS}
 if HAVE_LIBSIGSEGV
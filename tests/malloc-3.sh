@@ -0,0 +1,13 @@
+#!/bin/sh
+# Programs that interpose the C library allocator run with libsandbox loaded
+# into them, and we still catch what they do.
+mkdir ok deny
+SANDBOX_WRITE="${PWD}/ok" timeout -s KILL 10 execvp-0 malloc_interpose_tst \
+	malloc_interpose_tst "${PWD}/ok/x" "${PWD}/deny/x" > ok/out || exit 1
+cat ok/out
+[ "$(sed -n 1p ok/out)" = "in-process" ] || exit 1
+[ -d ok/x ] || exit 1
+[ ! -e deny/x ] || exit 1
+grep -q "deny/x: Permission denied" ok/out || exit 1
+
+exit 0
@@ -0,0 +1,14 @@
+#!/bin/sh
+# Same as malloc-3, but exec the program from a vfork child, and make sure the
+# allocator tests still pass when exec'ed that way.
+mkdir ok deny
+SANDBOX_WRITE="${PWD}/ok" timeout -s KILL 10 vfork-0 \
+	malloc_hooked_tst \
+	malloc_mmap_tst \
+	"malloc_interpose_tst ${PWD}/ok/x ${PWD}/deny/x" > ok/out || exit 1
+cat ok/out
+[ "$(sed -n 1p ok/out)" = "in-process" ] || exit 1
+[ -d ok/x ] || exit 1
+[ ! -e deny/x ] || exit 1
+
+exit 0
@@ -0,0 +1,88 @@
+/* Make sure programs that interpose the C library allocator get sandboxed with
+ * libsandbox loaded into them (rather than being traced), and that we don't
+ * trip over them when we do.  Like tcmalloc & co, our allocator makes its own
+ * syscalls the first time it's used, which land in libsandbox's wrappers while
+ * the dynamic linker (or libsandbox itself) may still be setting up.
+ * https://crbug.com/586444
+ *
+ * Usage: malloc_interpose_tst <dir to create> [more dirs...]
+ * We print "in-process" or "traced", then one line per dir with the result.
+ */
+
+#include "tests.h"
+
+/* A simple bump allocator: enough for what libc & libdl need to run us. */
+static char arena[1024 * 1024] __attribute__((aligned(16)));
+static size_t arena_used;
+
+#define ALIGN 16
+
+void *malloc(size_t size)
+{
+	static bool initialized;
+	size_t *ret;
+
+	if (!initialized) {
+		initialized = true;
+		close(open("/dev/urandom", O_RDONLY));
+	}
+
+	size = (size + ALIGN - 1) & ~(ALIGN - 1);
+	if (size > sizeof(arena) - ALIGN - arena_used) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	ret = (void *)(arena + arena_used);
+	arena_used += ALIGN + size;
+	*ret = size;
+	return (char *)ret + ALIGN;
+}
+
+void free(void *ptr)
+{
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	/* The arena starts out zeroed & we never reuse it. */
+	return malloc(nmemb * size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	void *ret = malloc(size);
+	if (ret && ptr) {
+		size_t old_size = *(size_t *)((char *)ptr - ALIGN);
+		memcpy(ret, ptr, old_size < size ? old_size : size);
+	}
+	return ret;
+}
+
+/* These are what used to get programs traced. */
+void *__libc_malloc(size_t size) { return malloc(size); }
+void __libc_free(void *ptr) { free(ptr); }
+void *__libc_calloc(size_t nmemb, size_t size) { return calloc(nmemb, size); }
+void *__libc_realloc(void *ptr, size_t size) { return realloc(ptr, size); }
+
+int main(int argc, char *argv[])
+{
+	Dl_info info;
+	void *sym;
+	int i;
+
+	sym = dlsym(RTLD_DEFAULT, "mkdir");
+	if (sym && dladdr(sym, &info) && info.dli_fname &&
+	    strstr(info.dli_fname, "libsandbox"))
+		puts("in-process");
+	else
+		puts("traced");
+
+	for (i = 1; i < argc; ++i) {
+		if (mkdir(argv[i], 0777) == 0)
+			printf("%s: ok\n", argv[i]);
+		else
+			printf("%s: %s\n", argv[i], strerror(errno));
+	}
+
+	return 0;
+}
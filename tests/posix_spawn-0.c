@@ -0,0 +1,52 @@
+/*
+ * Run programs via posix_spawn() in an empty environment, and make sure they
+ * all exit successfully.  Programs with a / in their name are run with
+ * posix_spawn(), and all others with posix_spawnp().
+ */
+
+#include "tests.h"
+
+int main(int argc, char *argv[])
+{
+	size_t i;
+
+	if (argc == 1) {
+		printf("Usage: %s <prog> [prog...]\n", argv[0]);
+		return 1;
+	}
+
+	for (i = 1; i < argc; ++i) {
+		size_t new_cnt = 0;
+		char **new_argv = NULL;
+		char *new_envp[] = { NULL, };
+		char *tok = strtok(argv[i], " ");
+		int ret, status;
+		pid_t pid;
+
+		while (tok) {
+			++new_cnt;
+			new_argv = realloc(new_argv, sizeof(*new_argv) * (new_cnt + 1));
+			new_argv[new_cnt - 1] = tok;
+			tok = strtok(NULL, " ");
+		}
+		new_argv[new_cnt] = NULL;
+
+		if (strchr(new_argv[0], '/'))
+			ret = posix_spawn(&pid, new_argv[0], NULL, NULL, new_argv, new_envp);
+		else
+			ret = posix_spawnp(&pid, new_argv[0], NULL, NULL, new_argv, new_envp);
+		if (ret) {
+			errno = ret;
+			errp("posix_spawn(%s) failed", new_argv[0]);
+		}
+
+		if (waitpid(pid, &status, 0) == -1)
+			errp("waitpid() failed");
+		else if (!WIFEXITED(status))
+			err("child did not exit properly");
+		else if (WEXITSTATUS(status))
+			err("child exited with %i", WEXITSTATUS(status));
+	}
+
+	return 0;
+}
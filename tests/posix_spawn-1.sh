@@ -0,0 +1,12 @@
+#!/bin/sh
+# Make sure dynamic programs launched via posix_spawn get sandboxed, even when
+# they're given an empty environment.
+
+mkdir ok deny
+SANDBOX_WRITE="${PWD}/ok" posix_spawn-0 \
+	"mkdir-0 0 ${PWD}/ok/x 0777" \
+	"$(command -v mkdir-0) -1,EACCES ${PWD}/deny/x 0777" || exit 1
+[ -d ok/x ] || exit 1
+[ ! -e deny/x ] || exit 1
+
+exit 0
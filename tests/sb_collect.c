@@ -0,0 +1,21 @@
+#include "tests.h"
+
+/* Send a datagram to the sandbox program's collector, like libsandbox does. */
+int main(int argc, char *argv[])
+{
+	struct sockaddr_un sun = { .sun_family = AF_UNIX, };
+	int fd;
+
+	if (argc != 3 || strlen(argv[1]) >= sizeof(sun.sun_path)) {
+		fputs("Usage: sb_collect <socket> <datagram>\n", stderr);
+		return 1;
+	}
+	strcpy(sun.sun_path, argv[1]);
+
+	fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+	if (fd == -1)
+		errp("socket() failed");
+	if (sendto(fd, argv[2], strlen(argv[2]), 0, (void *)&sun, sizeof(sun)) == -1)
+		errp("sendto(%s) failed", argv[1]);
+	return 0;
+}
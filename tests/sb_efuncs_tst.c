@@ -0,0 +1,118 @@
+/* Make sure threads logging at the same time all get their messages out, and
+ * don't leave extra fds open on the message path behind.  Between rounds, we
+ * swap out the fd kept open on it so they all find it stale at once.
+ */
+
+#include "headers.h"
+#include "sbutil.h"
+
+#include <err.h>
+
+#define THREADS 16
+#define ROUNDS  100
+
+/* Give the other threads a chance to get in the way while we open it. */
+static int slow_open(const char *path, int flags, mode_t mode)
+{
+	usleep(1000);
+	return open(path, flags, mode);
+}
+
+int (*sbio_open)(const char *, int, mode_t) = slow_open;
+FILE *(*sbio_popen)(const char *, const char *) = popen;
+bool (*sbio_collect)(const struct iovec *, int);
+const char sbio_fallback_path[] = "/dev/stderr";
+const char *sbio_message_path;
+
+static pthread_barrier_t barrier;
+
+static void *thread_start(void *arg)
+{
+	long t = (long)arg;
+	int r;
+
+	for (r = 0; r < ROUNDS; ++r) {
+		pthread_barrier_wait(&barrier);
+		sb_eraw("thread %li round %i\n", t, r);
+		pthread_barrier_wait(&barrier);
+	}
+	return NULL;
+}
+
+/* How many fds we have open on |path|, and the last one in |fd|. */
+static int find_fds(const char *path, int *fd)
+{
+	char target[SB_PATH_MAX];
+	struct dirent *de;
+	ssize_t len;
+	int ret = 0;
+	DIR *dir;
+
+	dir = opendir("/proc/self/fd");
+	if (!dir)
+		err(1, "opendir(/proc/self/fd)");
+	while ((de = readdir(dir)) != NULL) {
+		len = readlinkat(dirfd(dir), de->d_name, target, sizeof(target) - 1);
+		if (len == -1)
+			continue;
+		target[len] = '\0';
+		if (!strcmp(target, path)) {
+			*fd = atoi(de->d_name);
+			++ret;
+		}
+	}
+	closedir(dir);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	pthread_t tids[THREADS];
+	char *line = NULL;
+	size_t size = 0;
+	int devnull, fd, fds, r;
+	long t, lines;
+	FILE *fp;
+
+	if (argc != 2 || argv[1][0] != '/')
+		errx(1, "usage: sb_efuncs_tst <absolute path of message log>");
+	sbio_message_path = argv[1];
+	fp = fopen(sbio_message_path, "w");
+	if (!fp)
+		err(1, "fopen(%s)", sbio_message_path);
+	fclose(fp);
+	devnull = open("/dev/null", O_WRONLY|O_CLOEXEC);
+	if (devnull == -1)
+		err(1, "open(/dev/null)");
+
+	pthread_barrier_init(&barrier, NULL, THREADS + 1);
+	for (t = 0; t < THREADS; ++t)
+		if (pthread_create(&tids[t], NULL, thread_start, (void *)t))
+			errx(1, "pthread_create failed");
+	for (r = 0; r < ROUNDS; ++r) {
+		pthread_barrier_wait(&barrier);
+		pthread_barrier_wait(&barrier);
+		/* The program is free to reuse the fd we keep open. */
+		if (find_fds(sbio_message_path, &fd))
+			dup2(devnull, fd);
+	}
+	for (t = 0; t < THREADS; ++t)
+		pthread_join(tids[t], NULL);
+
+	/* Every fd left open on it now has been leaked. */
+	fds = find_fds(sbio_message_path, &fd);
+	printf("fds left open on the message log: %i\n", fds);
+
+	fp = fopen(sbio_message_path, "r");
+	if (!fp)
+		err(1, "fopen(%s)", sbio_message_path);
+	lines = 0;
+	while (getline(&line, &size, fp) != -1)
+		if (!strncmp(line, "thread ", 7))
+			++lines;
+	fclose(fp);
+	free(line);
+	printf("messages written: %li of %i\n", lines, THREADS * ROUNDS);
+
+	return fds == 0 && lines == THREADS * ROUNDS ? 0 : 1;
+}
@@ -10,6 +10,7 @@
 
 int (*sbio_open)(const char *, int, mode_t) = (void *)open;
 FILE *(*sbio_popen)(const char *, const char *) = popen;
+bool (*sbio_collect)(const struct iovec *, int);
 const char sbio_fallback_path[] = "/dev/stderr";
 const char *sbio_message_path = sbio_fallback_path;
 
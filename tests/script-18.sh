@@ -0,0 +1,32 @@
+#!/bin/sh
+# Make sure the tracer follows cwd & fd changes in static programs.
+[ "${at_xfail}" = "yes" ] && exit 77 # see script-0
+
+# The denied dir still has to be readable, so only allow writes to the other.
+mkdir ok deny
+SANDBOX_WRITE="${PWD}/ok" trace-state_static_tst "${PWD}/ok" "${PWD}/deny" || exit $?
+for d in chdir fchdir dup dup2 shared ; do
+	[ -d "ok/${d}" ] || exit 1
+	[ ! -e "deny/${d}" ] || exit 1
+done
+
+# Renaming the cwd away (by someone the rules don't hold to) has to be noticed
+# too.
+mkfifo go
+env SANDBOX_WRITE="${PWD}/ok" trace-state_static_tst "${PWD}/ok" "${PWD}/deny" rename \
+	<go >rename.out &
+pid=$!
+exec 3>go
+until grep -q "^waiting" rename.out ; do
+	kill -0 ${pid} || exit 1
+	sleep 0.1
+done
+mv ok/mv deny/mv
+echo >&3
+exec 3>&-
+wait ${pid} || exit 1
+cat rename.out
+[ -d deny/mv/rename ] || exit 1
+[ ! -e deny/mv/renamed ] || exit 1
+
+exit 0
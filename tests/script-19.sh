@@ -0,0 +1,34 @@
+#!/bin/sh
+# Make sure the exec cache notices when a program gets replaced, and that it
+# gets used.
+[ "${at_xfail}" = "yes" ] && exit 77 # see script-0
+
+[ -f "${SANDBOX_EXEC_CACHE}" ] || exit 1
+
+# Get a dynamic program into the cache, then rewrite it in place (so the
+# inode stays the same) with a static one that has to be traced.
+cp "$(command -v get-user)" ./prog || exit 1
+./prog >/dev/null || exit 1
+cat "$(command -v trace-state_static_tst)" > ./prog || exit 1
+
+mkdir ok deny
+for n in 1 2 ; do
+	SANDBOX_WRITE="${PWD}/ok" ./prog "${PWD}/ok" "${PWD}/deny" || exit $?
+	[ -d ok/chdir ] || exit 1
+	[ ! -e deny/chdir ] || exit 1
+	rm -rf ok/*
+done
+
+# Programs that get run over & over should come out of the cache.  Only the
+# collector adds them, so give it a few goes to get there.
+cp "$(command -v get-user)" ./hit || exit 1
+SANDBOX_STATS="${PWD}/stats.json" \
+sandbox sh -c 'for n in 1 2 3 4 5 6 7 8 ; do ./hit >/dev/null ; done' \
+	>/dev/null 2>&1
+cat stats.json || exit 1
+grep -q '"cache_hits":[1-9]' stats.json || exit 1
+
+# And nobody in the sandbox gets to write to it.
+( : >> "${SANDBOX_EXEC_CACHE}" ) 2>/dev/null && exit 1
+
+exit 0
@@ -0,0 +1,39 @@
+#!/bin/sh
+# make sure violations are logged as one record per line, and that the sandbox
+# program can print those as well as old style (VERSION 1.0) records
+[ "${at_xfail}" = "yes" ] && exit 77 # see script-0
+
+(
+# This clobbers all existing writable paths for this one write.
+SANDBOX_PREDICT=/dev/null
+SANDBOX_WRITE="${PWD}/ok"
+mkdir-0 -1,EACCES "${PWD}/deny" 0777
+) || exit 1
+
+log=${SANDBOX_LOG}
+cat "${log}"
+[ "$(wc -l < "${log}")" -eq 1 ] || exit 1
+grep -q '^{"version":2,"func":"mkdir","status":"deny",.*"cmdline":\["mkdir-0","-1,EACCES",' "${log}" || exit 1
+
+cat >>"${log}" <<EOL
+VERSION 1.0
+FORMAT: F - Function called
+
+F: open_wr
+S: deny
+P: old
+A: ${PWD}/old
+R: ${PWD}/old
+C: touch old
+EOL
+
+# Pipe it: the sandbox program reopens stderr for each message.
+sandbox --print-log "${log}" 2>&1 | cat >out
+cat out
+grep -q "^F: mkdir$" out || exit 1
+grep -q "^R: ${PWD}/deny$" out || exit 1
+grep -q "^C: mkdir-0 -1,EACCES ${PWD}/deny 0777$" out || exit 1
+grep -q "^VERSION 1.0$" out || exit 1
+grep -q "^C: touch old$" out || exit 1
+
+exit 0
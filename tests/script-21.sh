@@ -0,0 +1,60 @@
+#!/bin/sh
+# make sure the sandbox program collects repeated violations into one record
+[ "${at_xfail}" = "yes" ] && exit 77 # see script-0
+
+mkdir -p deny
+log="${PWD}/nested.log"
+rm -f "${log}"
+
+{
+SANDBOX_LOG="${log}" SANDBOX_DENY="${PWD}/deny" SANDBOX_PREDICT=/dev/null \
+sandbox sh -c '
+	env | grep ^SANDBOX_COLLECTOR= || exit 1
+	# Only we (or with userpriv, the build user) can send it things.
+	stat -c %A "${SANDBOX_COLLECTOR}" | grep -q -- "---$" || exit 1
+	for i in 1 2 3 ; do
+		mkdir-0 -1,EACCES "${PWD}/deny/x" 0777 || exit 1
+	done
+	# It should be in the log as soon as the call returns.
+	test -s "'"${log}"'"
+'
+echo "status: $?"
+} 2>&1 | cat >out
+cat out
+cat "${log}"
+
+grep -q "^status: 0$" out || exit 1
+[ "$(wc -l < "${log}")" -eq 1 ] || exit 1
+grep -q '^{"version":2,"func":"mkdir",.*,"count":3}$' "${log}" || exit 1
+grep -q "^N: 3$" out || exit 1
+# The socket is gone once the sandbox exits.
+! grep "^SANDBOX_COLLECTOR=" out | cut -d= -f2- | xargs -r ls 2>/dev/null || exit 1
+
+# Nothing in the sandbox gets to stop it.
+rm -f "${log}"
+{
+SANDBOX_LOG="${log}" SANDBOX_DENY="${PWD}/deny" SANDBOX_PREDICT=/dev/null \
+sandbox sh -c '
+	sb_collect "${SANDBOX_COLLECTOR}" Q || exit 1
+	for i in 1 2 ; do
+		mkdir-0 -1,EACCES "${PWD}/deny/y" 0777 || exit 1
+	done
+'
+echo "status: $?"
+} 2>&1 | cat >out
+cat out
+cat "${log}"
+grep -q "^status: 0$" out || exit 1
+[ "$(wc -l < "${log}")" -eq 1 ] || exit 1
+grep -q '^{"version":2,"func":"mkdir",.*/deny/y".*,"count":2}$' "${log}" || exit 1
+
+# The debug log goes through it as well, and comes out as written.
+dlog="${PWD}/nested-debug.log"
+rm -f "${dlog}"
+SANDBOX_DEBUG=1 SANDBOX_DEBUG_LOG="${dlog}" \
+sandbox sh -c 'env | grep -q ^SANDBOX_COLLECTOR= && : > "${PWD}/debugged"' >out 2>&1 || exit 1
+grep -q '"func":"open_wr",.*/debugged"' "${dlog}" || exit 1
+[ "$(grep -cv '^{"version":2,"func":"[a-z_0-9]*","status":' "${dlog}")" -eq 0 ] || exit 1
+[ "$(tr -d '\000' < "${dlog}" | wc -c)" -eq "$(wc -c < "${dlog}")" ] || exit 1
+
+exit 0
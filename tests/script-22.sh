@@ -0,0 +1,60 @@
+#!/bin/sh
+# make sure SANDBOX_TRACE records accesses in the trace buffer, and that they
+# end up in the debug log
+[ "${at_xfail}" = "yes" ] && exit 77 # see script-0
+
+log="${PWD}/debug.log"
+rm -f "${log}"
+
+{
+SANDBOX_TRACE=yes SANDBOX_DEBUG_LOG="${log}" \
+sandbox sh -c '
+	echo "buf: ${SANDBOX_TRACEBUF}"
+	echo "mode: $(stat -c %A "${SANDBOX_TRACEBUF}")"
+	touch "${PWD}/traced"
+	sandbox --dump-trace "${SANDBOX_TRACEBUF}"
+'
+echo "status: $?"
+} 2>&1 | cat >out
+cat out
+cat "${log}"
+
+grep -q "^status: 0$" out || exit 1
+buf=$(sed -n "/^buf: /s:::p" out)
+[ -n "${buf}" ] || exit 1
+# Only we (or with userpriv, the build user) can get at it.
+grep -q "^mode: -rw-rw----$\|^mode: -rw-------$" out || exit 1
+# The running sandbox can be looked at with --dump-trace ...
+grep -q "^F: open_wr$" out || exit 1
+grep -q "^R: ${PWD}/traced$" out || exit 1
+grep -q "^C: touch ${PWD}/traced$" out || exit 1
+grep -q "^T: [0-9]*\.[0-9]*$" out || exit 1
+# ... and it all goes into the debug log at the end.
+grep -q '^{"version":2,"func":"open_wr","status":"allow",.*"canonical_path":"'"${PWD}"'/traced",.*"time":[0-9]*,"cmdline":\["touch",' "${log}" || exit 1
+# The buffer itself is cleaned up.
+[ ! -e "${buf}" ] || exit 1
+
+# Once the strings wrap, new records still get theirs, and the ones that lost
+# them are reported.
+rm -f "${log}"
+{
+SANDBOX_TRACE=yes SANDBOX_DEBUG_LOG="${log}" \
+sandbox sh -c '
+	long=$(printf "%0250d" 0)
+	long="/${long}/${long}/${long}/${long}/${long}/${long}/${long}"
+	long="${PWD}${long}${long}"
+	i=0
+	while [ ${i} -lt 12000 ] ; do
+		true >"${long}/${i}"
+		i=$((i + 1))
+	done 2>/dev/null
+	touch "${PWD}/traced2"
+'
+echo "status: $?"
+} 2>&1 | cat >out
+cat out
+grep -q "^status: 0$" out || exit 1
+grep -q "lost the paths of [0-9]* records" out || exit 1
+grep -q '"canonical_path":"'"${PWD}"'/traced2"' "${log}" || exit 1
+
+exit 0
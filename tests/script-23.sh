@@ -0,0 +1,31 @@
+#!/bin/sh
+# make sure repeated violations are only counted once the log gets big, and
+# that the summary groups them
+[ "${at_xfail}" = "yes" ] && exit 77 # see script-0
+
+mkdir -p ok deny
+(
+# This clobbers all existing writable paths for this one write.
+SANDBOX_PREDICT=/dev/null
+SANDBOX_WRITE="${PWD}/ok"
+# Write the log ourselves rather than via the sandbox program.
+SANDBOX_COLLECTOR= SANDBOX_LOG="${PWD}/sb.log" SANDBOX_LOG_MAX=1 \
+sh -c 'for i in 1 2 3 4 5 6 7 8 ; do true > "${PWD}/deny/x" ; done'
+) 2>/dev/null
+
+log=sb.log
+cat "${log}"
+# One for the first, then each time the count doubles.
+[ "$(wc -l < "${log}")" -eq 4 ] || exit 1
+
+# A different path to the same file is the same violation.
+sed 's:"path"\:"[^"]*":"path"\:"deny/./x":' "${log}" | head -n 1 >>"${log}"
+
+sandbox --print-log "${log}" 2>&1 | cat >out
+cat out
+[ "$(grep -c "^N: " out)" -eq 1 ] || exit 1
+grep -q "^N: 9$" out || exit 1
+grep -q "^Last seen as:$" out || exit 1
+grep -q "^P: deny/./x$" out || exit 1
+
+exit 0
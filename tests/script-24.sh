@@ -0,0 +1,21 @@
+#!/bin/sh
+# make sure the stats add up the checks from all the processes
+[ "${at_xfail}" = "yes" ] && exit 77 # see script-0
+
+mkdir -p ok
+SANDBOX_STATS="${PWD}/stats.json" \
+sandbox sh -c 'mkdir-0 0 ok/a 0777; mkdir-0 0 ok/b 0777; mkdir-0 -1 /deny 0777' \
+	>/dev/null 2>&1
+cat stats.json || exit 1
+
+# Each mkdir-0 run counts in a slot of its own.  The last one is denied, but
+# whether it's predicted depends on the outer sandbox.
+grep -q '{"name":"mkdir","processes":3,"calls":3,"allowed":2,' stats.json || exit 1
+
+# And that it shows them without a path.
+sandbox --stats mkdir-0 0 ok/c 0777 2>&1 | cat >out
+cat out
+grep -q "^mkdir  *1  *1  *0  *0  *0 " out || exit 1
+grep -q "^processes: 1$" out || exit 1
+
+exit 0
@@ -0,0 +1,16 @@
+#!/bin/sh
+# make sure the timeline has the checks of every process in it
+[ "${at_xfail}" = "yes" ] && exit 77 # see script-0
+
+mkdir -p ok
+SANDBOX_TIMELINE="${PWD}/timeline.json" \
+sandbox sh -c 'mkdir-0 0 ok/a 0777; mkdir-0 0 ok/b 0777' >/dev/null 2>&1
+cat timeline.json || exit 1
+
+grep -q '^{"displayTimeUnit":"ns","traceEvents":\[' timeline.json || exit 1
+# One check (and the path it resolved) for each mkdir-0 run.
+[ "$(grep -o '{"name":"mkdir","cat":"check","ph":"X",' timeline.json | wc -l)" -eq 2 ] || exit 1
+grep -q '{"name":"resolve_path","cat":"resolve","ph":"X",.*"args":{"func":"mkdir"}}' timeline.json || exit 1
+grep -q '{"name":"process_name","ph":"M","pid":[0-9]*,"args":{"name":"mkdir-0"}}' timeline.json || exit 1
+
+exit 0
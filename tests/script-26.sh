@@ -0,0 +1,64 @@
+#!/bin/sh
+# make sure the config cache is used, and notices sandbox.conf & sandbox.d/
+# changing
+[ "${at_xfail}" = "yes" ] && exit 77 # see script-0
+
+# A config of our own, with files old enough to be cached.
+mkdir -p top/etc/sandbox.d
+ln -s "${abs_top_srcdir}/data" top/data
+echo 'SANDBOX_WRITE="/conf/one"' > top/etc/sandbox.conf
+echo 'SANDBOX_WRITE="/confd/one"' > top/etc/sandbox.d/10one
+age() { touch -d "$1" top/etc/sandbox.conf top/etc/sandbox.d/* top/etc/sandbox.d ; }
+age 2000-01-01
+
+export SANDBOX_CONF_CACHE="${PWD}/cache"
+# The sandbox.conf values always make it into the env, but as we're in another
+# sandbox, the sandbox.d/ ones don't, so look for those in the cache.
+check() {
+	abs_top_srcdir="${PWD}/top" sandbox sh -c 'echo "${SANDBOX_WRITE}"' > out || exit 1
+	cat out
+	grep -q "$1" out || exit 1
+	grep -aq "$2" cache || exit 1
+}
+
+check /conf/one /confd/one
+
+# The same size & mtime means the cache is used as is.
+echo 'SANDBOX_WRITE="/conf/two"' > top/etc/sandbox.conf
+age 2000-01-01
+check /conf/one /confd/one
+
+# Until the mtime changes.
+age 2001-01-01
+check /conf/two /confd/one
+
+# Files coming & going are noticed via the dir.
+echo 'SANDBOX_WRITE="/confd/two"' > top/etc/sandbox.d/20two
+age 2002-01-01
+check /conf/two /confd/two
+
+# And a bad cache is just replaced.
+echo junk > cache
+check /conf/two /confd/two
+
+# Caches anyone else can swap out are neither used nor made.
+mkdir shared
+chmod 1777 shared
+cp cache shared/cache
+echo 'SANDBOX_WRITE="/conf/new"' > top/etc/sandbox.conf
+age 2002-01-01
+SANDBOX_CONF_CACHE="${PWD}/shared/cache" check /conf/new /confd/two
+check /conf/two /confd/two
+rm shared/cache
+SANDBOX_CONF_CACHE="${PWD}/shared/cache" check /conf/new /confd/two
+[ -e shared/cache ] && exit 1
+
+# Nothing in the sandbox gets to write the default one.
+(
+SANDBOX_PREDICT=/dev/null
+SANDBOX_WRITE=/var/cache
+mkdir-0 -1,EACCES /var/cache/sandbox/script-26 0755
+creat-0 -1,EACCES /var/cache/sandbox/conf-cache 0644
+) || exit 1
+
+exit 0
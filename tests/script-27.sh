@@ -0,0 +1,96 @@
+#!/bin/sh
+# make sure the server runs programs in the cwd, with the env & stdio of the
+# client, and hands back their exit status & violations
+[ "${at_xfail}" = "yes" ] && exit 77 # see script-0
+
+sock="${PWD}/sock"
+sandbox --server "${sock}" 2>server.err &
+server=$!
+trap 'kill ${server} 2>/dev/null' EXIT
+
+# It only shows up once it's listening.
+i=0
+while [ ! -S "${sock}" ] ; do
+	[ $(( i += 1 )) -gt 100 ] && exit 1
+	sleep 0.1
+done
+
+mkdir -p sub deny
+(
+cd sub
+FOO=bar sandbox --connect "${sock}" sh -c 'echo "${PWD} ${FOO} ${SANDBOX_ACTIVE}"; echo err >&2'
+) >out 2>err || exit 1
+cat out err
+[ "$(cat out)" = "${PWD}/sub bar armedandready" ] || exit 1
+grep -qx err err || exit 1
+
+[ "$(echo in | sandbox --connect "${sock}" cat)" = "in" ] || exit 1
+
+sandbox --connect "${sock}" sh -c 'exit 3'
+[ $? -eq 3 ] || exit 1
+
+# The policy comes from the env of the request, and the log back with the
+# status.  Pipe it: the sandbox program reopens stderr for each message.
+log="${PWD}/request.log"
+{
+SANDBOX_LOG="${log}" SANDBOX_DENY="${PWD}/deny" SANDBOX_PREDICT=/dev/null \
+sandbox --connect "${sock}" mkdir-0 -1,EACCES "${PWD}/deny/x" 0777
+echo "status: $?"
+} 2>&1 | cat >out
+cat out
+grep -q "^status: 0$" out || exit 1
+grep -q '^{"version":2,"func":"mkdir","status":"deny",' "${log}" || exit 1
+grep -q "LOG FILE: \"${log}\"" out || exit 1
+
+# The options for the run go along with the request.
+sandbox --stats --connect "${sock}" true 2>&1 | cat >out
+cat out
+grep -q "SANDBOX STATISTICS" out || exit 1
+[ "$(env -u SANDBOX_DEBUG sandbox -d --connect "${sock}" sh -c 'echo "${SANDBOX_DEBUG}"')" = "1" ] || exit 1
+
+# While the ones for the server can't be.
+{
+sandbox --ns-off --connect "${sock}" true
+echo "status: $?"
+} 2>&1 | cat >out
+cat out
+grep -q "^status: 1$" out || exit 1
+grep -q -- "--ns-off has to be given to the --server" out || exit 1
+
+# Signals to the client go to the program, and the status comes back as if
+# it was sent to the client itself.  If the client goes away (and can't pass
+# the signal on), the program gets hung up on.
+running() {
+	sandbox --connect "${sock}" sh -c 'echo $$ > pid; exec sleep 100' &
+	client=$!
+	i=0
+	while [ ! -s pid ] ; do
+		[ $(( i += 1 )) -gt 100 ] && exit 1
+		sleep 0.1
+	done
+}
+gone() {
+	i=0
+	while kill -0 "$(cat pid)" 2>/dev/null ; do
+		[ $(( i += 1 )) -gt 100 ] && exit 1
+		sleep 0.1
+	done
+	rm pid
+}
+running
+kill -TERM ${client}
+wait ${client}
+[ $? -eq $(( 128 + 15 )) ] || exit 1
+gone
+running
+kill -KILL ${client}
+wait ${client}
+gone
+
+# And it cleans up after itself.
+kill ${server}
+wait ${server} || exit 1
+cat server.err
+[ ! -e "${sock}" ] || exit 1
+
+exit 0
@@ -0,0 +1,61 @@
+#!/bin/sh
+# make sure SANDBOX_METHOD=landlock has the kernel hold programs (static ones
+# too) to SANDBOX_WRITE, and falls back when it can't
+[ "${at_xfail}" = "yes" ] && exit 77 # see script-0
+
+mkdir -p ok deny
+run() {
+	SANDBOX_METHOD=landlock SANDBOX_PREDICT=/dev/null SANDBOX_WRITE="${write:-${PWD}/ok}" \
+	sh -c "$1"
+}
+
+# Dynamic programs are checked (& logged) by libsandbox either way.
+run 'mkdir-0 -1,EACCES "${PWD}/deny/dyn" 0777' || exit 1
+grep -q '"func":"mkdir","status":"deny",.*/deny/dyn"' "${SANDBOX_LOG}" || exit 1
+run 'mkdir-0 0 "${PWD}/ok/dyn" 0777' || exit 1
+
+if ! run env | grep -q "^__SANDBOX_LANDLOCKED=1$" ; then
+	echo "no Landlock here; fell back"
+	exit 0
+fi
+
+# The kernel denies static programs itself, so nothing needs tracing, and
+# nothing makes it to the log.
+run 'mkdir_static-0 -1,EACCES "${PWD}/deny/static" 0777' || exit 1
+run 'mkdir_static-0 0 "${PWD}/ok/static" 0777' || exit 1
+! grep -q "/deny/static" "${SANDBOX_LOG}" || exit 1
+
+# Without the collector, libsandbox writes the log itself, so it has to be let
+# create it wherever it is.
+mkdir logs
+log="${PWD}/logs/landlock.log"
+SANDBOX_COLLECTOR= SANDBOX_LOG="${log}" \
+run 'mkdir-0 -1,EACCES "${PWD}/deny/nolog" 0777' || exit 1
+grep -q '"func":"mkdir","status":"deny",.*/deny/nolog"' "${log}" || exit 1
+
+# Write prefixes that don't exist yet have nothing to hang rules on, so they
+# can't be created.
+write="${PWD}/ok:${PWD}/later" \
+run 'mkdir_static-0 -1,EACCES "${PWD}/later" 0777' || exit 1
+[ ! -e later ] || exit 1
+
+# Reads stay open.
+run 'cat "${abs_top_srcdir}/README.md"' >/dev/null || exit 1
+
+# And asking for more further down doesn't get past the kernel.
+run 'sh -c "SANDBOX_WRITE=\"\${PWD}\" mkdir_static-0 -1,EACCES \"\${PWD}/deny/nested\" 0777"' || exit 1
+[ ! -e deny/nested ] || exit 1
+
+# If the kernel won't take the rules, the program doesn't get run at all.  With
+# no fds to spare, the ruleset can't even be made.
+(
+	ulimit -n 3
+	SANDBOX_METHOD=landlock SANDBOX_WRITE="${PWD}/ok" \
+	mkdir-0 0 "${PWD}/ok/nofds" 0777
+) 2>nofds.err
+[ $? -eq 126 ] || exit 1
+cat nofds.err
+grep -q "Operation not permitted" nofds.err || exit 1
+[ ! -e ok/nofds ] || exit 1
+
+exit 0
@@ -0,0 +1,101 @@
+/*
+ * Make sure the tracer keeps up when the cwd & fds of a static program change
+ * underneath the paths it is checking.
+ *
+ * usage: <allowed dir> <denied dir> [rename]
+ *
+ * With "rename", wait on stdin in <allowed dir>/mv instead, for someone to
+ * rename it away into the denied dir.
+ */
+
+#include "tests.h"
+
+#define check(expect_ok, call) \
+({ \
+	int ret = (call); \
+	printf("  %s = %i\n", #call, ret); \
+	if ((ret != -1) != (expect_ok)) \
+		err("%s: expected %s", #call, (expect_ok) ? "success" : "failure"); \
+})
+
+static int denyfd, fd;
+
+/* Swap the fd out from under the parent, which shares the fd table. */
+static int shared_child(void *arg)
+{
+	return dup2(denyfd, fd) == -1;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 3 && !(argc == 4 && !strcmp(argv[3], "rename"))) {
+		printf("usage: %s <allowed dir> <denied dir> [rename]\n", argv[0]);
+		exit(1);
+	}
+
+	const char *ok = argv[1], *deny = argv[2];
+	static char stack[64 * 1024];
+	int okfd, status;
+	pid_t pid;
+
+	setbuf(stdout, NULL);
+
+	okfd = open(ok, O_RDONLY | O_DIRECTORY);
+	denyfd = open(deny, O_RDONLY | O_DIRECTORY);
+	if (okfd == -1 || denyfd == -1)
+		errp("unable to open dirs");
+
+	if (argc == 4) {
+		char ch;
+
+		printf("rename\n");
+		check(true, fchdir(okfd));
+		check(true, mkdir("mv", 0777));
+		check(true, chdir("mv"));
+		check(true, mkdir("rename", 0777));
+		printf("waiting\n");
+		if (read(0, &ch, 1) != 1)
+			errp("read() failed");
+		check(false, mkdir("renamed", 0777));
+		return 0;
+	}
+
+	printf("chdir\n");
+	check(true, chdir(ok));
+	check(true, mkdir("chdir", 0777));
+	check(true, chdir(deny));
+	check(false, mkdir("chdir", 0777));
+
+	printf("fchdir\n");
+	check(true, fchdir(okfd));
+	check(true, mkdir("fchdir", 0777));
+	check(true, fchdir(denyfd));
+	check(false, mkdir("fchdir", 0777));
+
+	printf("fd reuse\n");
+	fd = dup(okfd);
+	check(true, mkdirat(fd, "dup", 0777));
+	check(true, close(fd));
+	fd = fcntl(denyfd, F_DUPFD, fd);
+	check(false, mkdirat(fd, "dup", 0777));
+	check(true, close(fd));
+
+	printf("dup2\n");
+	fd = dup(okfd);
+	check(true, mkdirat(fd, "dup2", 0777));
+	check(true, dup2(denyfd, fd));
+	check(false, mkdirat(fd, "dup2", 0777));
+
+	/* The kernel reports this as a fork, not a clone. */
+	printf("shared fds\n");
+	fd = dup(okfd);
+	check(true, mkdirat(fd, "shared", 0777));
+	pid = clone(shared_child, stack + sizeof(stack), CLONE_FILES | SIGCHLD, NULL);
+	if (pid == -1)
+		errp("clone() failed");
+	if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status))
+		err("clone child failed");
+	check(false, mkdirat(fd, "shared", 0777));
+
+	return 0;
+}
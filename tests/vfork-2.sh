@@ -0,0 +1,11 @@
+#!/bin/sh
+# Make sure static programs exec'ed from vfork children get traced.
+trace-0 ; test $? -eq 77 && exit 77
+
+mkdir ok deny
+SANDBOX_WRITE="${PWD}/ok" vfork-0 \
+	"trace-state_static_tst ${PWD}/ok ${PWD}/deny" || exit 1
+[ -d ok/chdir ] || exit 1
+[ ! -e deny/chdir ] || exit 1
+
+exit 0
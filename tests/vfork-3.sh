@@ -0,0 +1,17 @@
+#!/bin/sh
+# Make sure vfork() children don't leave what their exec needed behind in the
+# parent's memory.
+
+# Have the last child report how big the parent (which execs as vfork-0) got.
+vmsize() {
+	sh -c '
+		for i in $(seq $0) ; do set -- "$@" sb_true ; done
+		exec vfork-0 "$@" "grep ^VmSize: /proc/$$/status"
+	' "$1" | awk '{print $2}'
+}
+
+small=$(vmsize 10)
+big=$(vmsize 1000)
+echo "VmSize after 10 children: ${small} kB; after 1000: ${big} kB"
+[ -n "${small}" ] && [ -n "${big}" ] || exit 1
+[ $(( big - small )) -lt 1024 ]